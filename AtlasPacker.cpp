@@ -0,0 +1,255 @@
+#include "AtlasPacker.h"
+#include "OBJParser.h"
+#include <algorithm>
+#include <fstream>
+
+using namespace cocos3d;
+
+#define TEXEL_EPSILON 0.001f
+
+void cocos3d::blitWithGutter(CCImage* image, unsigned char* pixels, unsigned int pageWidth, unsigned int x0, unsigned int y0, unsigned int gutter)
+{
+	int width = image->getWidth();
+	int height = image->getHeight();
+	int bpp = image->hasAlpha() ? 4 : 3;
+	const unsigned char* data = image->getData();
+
+	for (int y = -(int)gutter; y < height + (int)gutter; y++)
+	{
+		int sy = MIN(MAX(y, 0), height - 1);
+
+		for (int x = -(int)gutter; x < width + (int)gutter; x++)
+		{
+			int sx = MIN(MAX(x, 0), width - 1);
+
+			const unsigned char* src = data + (sy * width + sx) * bpp;
+			unsigned char* dst = pixels + ((y0 + y) * pageWidth + (x0 + x)) * 4;
+
+			dst[0] = src[0];
+			dst[1] = src[1];
+			dst[2] = src[2];
+			dst[3] = (bpp == 4) ? src[3] : 255;
+		}
+	}
+}
+
+static unsigned int roundUp(unsigned int value, unsigned int multiple)
+{
+	return (value + multiple - 1) / multiple * multiple;
+}
+
+class tallerPlacement
+{
+public:
+	template <class T>
+	bool operator()(const T& a, const T& b) const
+	{
+		return a.height > b.height;
+	}
+};
+
+AtlasPacker::AtlasPacker(unsigned int pageSize, unsigned int gutter)
+: m_pageSize(ccNextPOT(pageSize))
+, m_gutter(gutter)
+, m_packed(false)
+{
+	m_grid = ccNextPOT(MAX(gutter * 2, 1u));
+}
+
+AtlasPacker::~AtlasPacker()
+{
+	for (auto iter = m_placements.begin(); iter != m_placements.end(); iter++)
+		iter->image->release();
+}
+
+bool AtlasPacker::addTexture(const std::string& name, const std::string& file)
+{
+	for (auto iter = m_placements.begin(); iter != m_placements.end(); iter++)
+	{
+		if (iter->name == name)
+			return true;
+	}
+
+	CCImage* image = new CCImage();
+
+	if (!image->initWithImageFile(file.c_str()))
+	{
+		CCLOG("cocos3d: AtlasPacker can't load %s", file.c_str());
+
+		image->release();
+		return false;
+	}
+
+	Placement placement;
+	placement.name = name;
+	placement.image = image;
+	placement.page = 0;
+	placement.x = placement.y = 0;
+	placement.width = image->getWidth();
+	placement.height = image->getHeight();
+
+	m_placements.push_back(placement);
+	m_packed = false;
+
+	return true;
+}
+
+bool AtlasPacker::addModel(const std::string& objFile, const std::string& mtlFile, const std::string& texture)
+{
+	std::string fullPathObj = CCFileUtils::sharedFileUtils()->fullPathForFilename(objFile.c_str());
+	std::string fullPathMtl = CCFileUtils::sharedFileUtils()->fullPathForFilename(mtlFile.c_str());
+
+	OBJParser parser;
+
+	if (!parser.readFile(fullPathObj, fullPathMtl))
+		return false;
+
+	const std::vector<Vec2>& texels = parser.texels();
+
+	for (unsigned int i = 0; i < texels.size(); i++)
+	{
+		if (texels[i].x < -TEXEL_EPSILON || texels[i].x > 1 + TEXEL_EPSILON ||
+			texels[i].y < -TEXEL_EPSILON || texels[i].y > 1 + TEXEL_EPSILON)
+		{
+			CCLOG("cocos3d: AtlasPacker leaves %s out, %s repeats it", texture.c_str(), objFile.c_str());
+			return false;
+		}
+	}
+
+	return addTexture(texture, texture);
+}
+
+unsigned int AtlasPacker::getPageCount()
+{
+	pack();
+
+	return (unsigned int)m_pages.size();
+}
+
+// Shelves, tallest textures first: each page is filled with rows as tall as the
+// first texture put in them, a texture goes in the first row it fits in.
+void AtlasPacker::pack()
+{
+	if (m_packed)
+		return;
+
+	m_pages.clear();
+
+	std::stable_sort(m_placements.begin(), m_placements.end(), tallerPlacement());
+
+	for (auto iter = m_placements.begin(); iter != m_placements.end(); iter++)
+	{
+		unsigned int cellWidth = roundUp(iter->width + m_gutter * 2, m_grid);
+		unsigned int cellHeight = roundUp(iter->height + m_gutter * 2, m_grid);
+
+		if (cellWidth > m_pageSize || cellHeight > m_pageSize)
+		{
+			CCLOG("cocos3d: AtlasPacker leaves %s out, it's bigger than a page", iter->name.c_str());
+
+			iter->page = (unsigned int)-1;
+			continue;
+		}
+
+		bool placed = false;
+
+		for (unsigned int page = 0; page <= m_pages.size() && !placed; page++)
+		{
+			if (page == m_pages.size())
+				m_pages.push_back(std::vector<Shelf>());
+
+			std::vector<Shelf>& shelves = m_pages[page];
+
+			for (auto shelf = shelves.begin(); shelf != shelves.end() && !placed; shelf++)
+			{
+				if (cellHeight <= shelf->height && shelf->used + cellWidth <= m_pageSize)
+				{
+					iter->x = shelf->used;
+					iter->y = shelf->y;
+					shelf->used += cellWidth;
+					placed = true;
+				}
+			}
+
+			unsigned int top = shelves.empty() ? 0 : shelves.back().y + shelves.back().height;
+
+			if (!placed && top + cellHeight <= m_pageSize)
+			{
+				Shelf shelf = { top, cellHeight, cellWidth };
+				shelves.push_back(shelf);
+
+				iter->x = 0;
+				iter->y = top;
+				placed = true;
+			}
+
+			if (placed)
+			{
+				iter->page = page;
+				iter->x += m_gutter;
+				iter->y += m_gutter;
+			}
+		}
+	}
+
+	m_packed = true;
+}
+
+bool AtlasPacker::save(const std::string& directory, const std::string& name)
+{
+	pack();
+
+	std::string descriptorPath = directory + "/" + name + ".atlas";
+	std::ofstream descriptor(descriptorPath.c_str());
+
+	if (!descriptor.good())
+	{
+		CCLOG("cocos3d: AtlasPacker can't write %s", descriptorPath.c_str());
+		return false;
+	}
+
+	std::vector<unsigned char> pixels(m_pageSize * m_pageSize * 4);
+
+	for (unsigned int page = 0; page < m_pages.size(); page++)
+	{
+		std::fill(pixels.begin(), pixels.end(), 0);
+
+		for (auto iter = m_placements.begin(); iter != m_placements.end(); iter++)
+		{
+			if (iter->page == page)
+				blitWithGutter(iter->image, &pixels[0], m_pageSize, iter->x, iter->y, m_gutter);
+		}
+
+		char pageName[32];
+		snprintf(pageName, sizeof(pageName), "_%u.png", page);
+
+		std::string pageFile = name + pageName;
+
+		CCImage* image = new CCImage();
+
+		bool saved = image->initWithImageData(&pixels[0], (int)pixels.size(), CCImage::kFmtRawData, m_pageSize, m_pageSize, 8) &&
+					 image->saveToFile((directory + "/" + pageFile).c_str(), false);
+
+		image->release();
+
+		if (!saved)
+		{
+			CCLOG("cocos3d: AtlasPacker can't write %s", pageFile.c_str());
+			return false;
+		}
+
+		descriptor << "page " << pageFile << " " << m_pageSize << " " << m_pageSize << "\n";
+	}
+
+	for (auto iter = m_placements.begin(); iter != m_placements.end(); iter++)
+	{
+		if (iter->page >= m_pages.size())
+			continue;
+
+		descriptor << "entry " << iter->page << " "
+				   << iter->x << " " << iter->y << " "
+				   << iter->width << " " << iter->height << " "
+				   << iter->name << "\n";
+	}
+
+	return true;
+}
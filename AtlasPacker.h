@@ -0,0 +1,68 @@
+#ifndef __ATLAS_PACKER_H__
+#define __ATLAS_PACKER_H__
+#include "cocos2d.h"
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace cocos2d;
+
+namespace cocos3d
+{
+	#define ATLAS_PAGE_SIZE 1024
+	#define ATLAS_GUTTER 4
+
+	// copies an image into an rgba8888 page at (x, y) and repeats its edge pixels
+	// gutter times around it, as GL_CLAMP_TO_EDGE would
+	void blitWithGutter(CCImage* image, unsigned char* pixels, unsigned int pageWidth, unsigned int x, unsigned int y, unsigned int gutter);
+
+	// Packs the textures of a set of models into atlas pages, meant to run offline (a
+	// desktop build of the game) and ship the pages with a descriptor for MaterialAtlas.
+	//
+	// Every texture is placed on a grid of the smallest power of two holding both its
+	// gutters, so the first log2(grid) mip levels never mix two textures.
+	class AtlasPacker
+	{
+	public:
+		AtlasPacker(unsigned int pageSize = ATLAS_PAGE_SIZE, unsigned int gutter = ATLAS_GUTTER);
+		~AtlasPacker();
+
+		// the name is what models are created with, the file where the pixels are
+		bool addTexture(const std::string& name, const std::string& file);
+
+		// textures of meshes with texcoords out of [0, 1] are left out, they
+		// repeat and that can't be done inside a page
+		bool addModel(const std::string& objFile, const std::string& mtlFile, const std::string& texture);
+
+		// pages as <name>_<page>.png and the descriptor as <name>.atlas, in the directory
+		bool save(const std::string& directory, const std::string& name);
+
+		unsigned int getPageCount();
+
+	private:
+		struct Placement
+		{
+			std::string name;
+			CCImage* image;
+			unsigned int page;
+			unsigned int x, y;
+			unsigned int width, height;
+		};
+
+		struct Shelf
+		{
+			unsigned int y, height, used;
+		};
+
+		void pack();
+
+		std::vector<Placement> m_placements;
+		std::vector<std::vector<Shelf> > m_pages;
+
+		unsigned int m_pageSize;
+		unsigned int m_gutter;
+		unsigned int m_grid;
+		bool m_packed;
+	};
+}
+#endif
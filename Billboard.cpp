@@ -5,35 +5,40 @@
 #include "shaders.h"
 #include "Scene3D.h"
 #include "VBOCache.h"
+#include "RestoreManager.h"
 #include <limits>
 #include <map>
 
 #include "poly2tri/poly2tri.h"
-#include "tristripper/tri_stripper.h"
+#include "MeshOptimizer.h"
 
 using namespace cocos3d;
 
-#define LINKS_VERTEX_ATTRIB 6
+#define LINKS_VERTEX_ATTRIB kCCVertexAttrib_Links
 
-static const std::string randomString(int length) 
+// only names the node, the geometry is shared by shape (see createQuad)
+static const std::string nextBillboardId()
 {
-	static std::string charset = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ1234567890";
-	std::string result;
-	result.resize(length);
+	static unsigned int count = 0;
 
-	for (int i = 0; i < length; i++)
-		result[i] = charset[rand() % charset.length()];
+	char id[32];
+	snprintf(id, sizeof(id), "billboard_%u", count++);
 
-	return result;
+	return id;
 }
 
 Billboard::Billboard()
 : Model()
+, m_indicesMode(GL_TRIANGLES)
+, m_hullIBO(0)
+, m_vertexCount(0)
+, m_linksVBO(0)
+, m_framesVBO(0)
 , m_hulled(false)
 , m_animatedHull(false)
-, m_at(0)
+, m_hullTextured(true)
 , m_delay(0)
-, m_linksVBO(0)
+, m_at(0)
 {
 	m_color.x = m_color.y = m_color.z = 1;
 }
@@ -88,24 +93,13 @@ Billboard* Billboard::createWithTextureGrid(CCTexture2D* texture, const int fram
 
 bool Billboard::initWithSize(const CCSize& size, float thickness)
 {
-	srand((unsigned)time(NULL));
-
-	m_id = "billboard_" + randomString(10);
+	m_id = nextBillboardId();
 	m_textured = false;
 	m_culling = false;
 
 	m_dTexture = NULL;
 
-	m_program = CCShaderCache::sharedShaderCache()->programForKey(PHONG_SHADER_KEY);
-
-	if (m_program == NULL)
-	{
-		m_program = new CCGLProgram();
-		MESH_INIT_PHONG(m_program);
-		CCShaderCache::sharedShaderCache()->addProgram(m_program, PHONG_SHADER_KEY);
-	}
-
-	setShaderProgram(m_program);
+	updateShaderProgram();
 
 	if (thickness == 0)
 		createQuad(size.width, size.height);
@@ -113,13 +107,9 @@ bool Billboard::initWithSize(const CCSize& size, float thickness)
 		createCube(size.width, size.height, thickness);
 
 	generateVBOs();
-	initShaderLocations();
 
 #if CC_ENABLE_CACHE_TEXTURE_DATA
-	CCNotificationCenter::sharedNotificationCenter()->addObserver(this,
-		callfuncO_selector(Billboard::listenBackToForeground),
-		EVENT_COME_TO_FOREGROUND,
-		NULL);
+	RestoreManager::sharedRestoreManager()->addNode(this);
 #endif
 
 	return Node3D::init();
@@ -131,34 +121,21 @@ bool Billboard::initWithTexture(CCTexture2D* texture, float thickness)
 	
 	if (pRet)
 	{
-		m_id = "billboard_" + randomString(10);
+		m_id = nextBillboardId();
 		m_textured = true;
 		m_culling = false;
 
 		m_dTexture = texture;
 		m_dTexture->retain();
 
-		m_program = CCShaderCache::sharedShaderCache()->programForKey(PHONG_SHADER_TEXTURE_KEY);
-			
-		if (m_program == NULL)
-		{
-			m_program = new CCGLProgram();
-			MESH_INIT_PHONG_TEXTURE(m_program);
-			CCShaderCache::sharedShaderCache()->addProgram(m_program, PHONG_SHADER_TEXTURE_KEY);
-		}
-
-		setShaderProgram(m_program);
+		updateShaderProgram();
 
 		createQuad(texture->getContentSize().width, texture->getContentSize().height);
 		generateVBOs();
-		initShaderLocations();
 	}
 
 #if CC_ENABLE_CACHE_TEXTURE_DATA
-	CCNotificationCenter::sharedNotificationCenter()->addObserver(this,
-		callfuncO_selector(Billboard::listenBackToForeground),
-		EVENT_COME_TO_FOREGROUND,
-		NULL);
+	RestoreManager::sharedRestoreManager()->addNode(this);
 #endif
 
 	return Node3D::init() && pRet;
@@ -170,7 +147,7 @@ bool Billboard::initWithTextureGrid(CCTexture2D* texture, const int framesPerRow
 
 	if (pRet)
 	{
-		m_id = "billboard_" + randomString(10);
+		m_id = nextBillboardId();
 		m_textured = true;
 		m_culling = false;
 
@@ -188,16 +165,7 @@ bool Billboard::initWithTextureGrid(CCTexture2D* texture, const int framesPerRow
 			m_frameSize = frameSize;
 		}
 
-		m_program = CCShaderCache::sharedShaderCache()->programForKey(PHONG_SHADER_TEXTURE_KEY);
-
-		if (m_program == NULL)
-		{
-			m_program = new CCGLProgram();
-			MESH_INIT_PHONG_TEXTURE(m_program);
-			CCShaderCache::sharedShaderCache()->addProgram(m_program, PHONG_SHADER_TEXTURE_KEY);
-		}
-
-		setShaderProgram(m_program);
+		updateShaderProgram();
 
 		if (thickness == 0)
 		{
@@ -215,20 +183,37 @@ bool Billboard::initWithTextureGrid(CCTexture2D* texture, const int framesPerRow
 		}
 
 		generateVBOs();
-		initShaderLocations();
 	}
 
 #if CC_ENABLE_CACHE_TEXTURE_DATA
-	CCNotificationCenter::sharedNotificationCenter()->addObserver(this,
-		callfuncO_selector(Billboard::listenBackToForeground),
-		EVENT_COME_TO_FOREGROUND,
-		NULL);
+	RestoreManager::sharedRestoreManager()->addNode(this);
 #endif
 
 	return Node3D::init() && pRet;
 }
 
 void Billboard::createQuad(int width, int height)
+{
+	//every quad is the same unit quad, the size goes in the model matrix
+	createQuadMesh(1.0f, 1.0f);
+
+	m_size = CCSize(width, height);
+	m_meshScale = Vec3(width, height, 1);
+	m_meshId = "billboard_quad";
+}
+
+void Billboard::createQuadMesh(float width, float height)
+{
+	quadMesh(width, height, m_vertices, m_normals, m_texels);
+
+	m_aabb.max.x = width / 2.0f;
+	m_aabb.max.y = height / 2.0f;
+	m_aabb.max.z = m_aabb.min.z = 0;
+	m_aabb.min.x = -m_aabb.max.x;
+	m_aabb.min.y = -m_aabb.max.y;
+}
+
+void Billboard::quadMesh(float width, float height, std::vector<Vec3>& vertices, std::vector<Vec3>& normals, std::vector<Vec2>& texels)
 {
 	Vec3 v1(-width/2.0f, -height/2.0f, 0);
 	Vec3 v2(-width/2.0f, height/2.0f, 0	);
@@ -248,26 +233,36 @@ void Billboard::createQuad(int width, int height)
 
 	n2 = n3 = n4 = n1;
 
-	m_aabb.max.x = width / 2.0f;
-	m_aabb.max.y = height / 2.0f;
-	m_aabb.max.z = m_aabb.min.z = 0;
-	m_aabb.min.x = -m_aabb.max.x;
-	m_aabb.min.y = -m_aabb.max.y;
+	vertices.push_back(v1);
+	vertices.push_back(v2);
+	vertices.push_back(v3);
+	vertices.push_back(v4);
 
-	m_vertices.push_back(v1);
-	m_vertices.push_back(v2);
-	m_vertices.push_back(v3);
-	m_vertices.push_back(v4);
+	texels.push_back(t1);
+	texels.push_back(t2);
+	texels.push_back(t3);
+	texels.push_back(t4);
 
-	m_texels.push_back(t1);
-	m_texels.push_back(t2);
-	m_texels.push_back(t3);
-	m_texels.push_back(t4);
+	normals.push_back(n1);
+	normals.push_back(n2);
+	normals.push_back(n3);
+	normals.push_back(n4);
+}
+
+void Billboard::getQuadVBOs(GLuint* vertices, GLuint* texels)
+{
+	GLuint normals;
 
-	m_normals.push_back(n1);
-	m_normals.push_back(n2);
-	m_normals.push_back(n3);
-	m_normals.push_back(n4);
+	//whoever asks first uploads it, a billboard or not
+	if (!VBOCache::sharedVBOCache()->getVBO("billboard_quad", vertices, &normals, texels))
+	{
+		std::vector<Vec3> quadVertices, quadNormals;
+		std::vector<Vec2> quadTexels;
+
+		quadMesh(1.0f, 1.0f, quadVertices, quadNormals, quadTexels);
+
+		VBOCache::sharedVBOCache()->addDataToVBOs("billboard_quad", quadVertices, quadNormals, quadTexels);
+	}
 }
 
 void Billboard::updateFrame(float dt)
@@ -297,6 +292,8 @@ void Billboard::createAnimatedQuad()
 
 	createQuad(width*m_fScaleX, height*m_fScaleY);
 
+	m_texelsFrame.clear();
+
 	float texelWidth = m_frameSize.width / m_dTexture->getContentSizeInPixels().width;
 	float texelHeight = m_frameSize.height / m_dTexture->getContentSizeInPixels().height;
 
@@ -323,6 +320,7 @@ void Billboard::createAnimatedQuad()
 	CC_ASSERT(m_texelsFrame.size() == m_nframes);
 
 	m_texels = m_texelsFrame[0];
+	m_meshId = "billboard_quad_" + framesId();
 }
 
 void Billboard::createCube(int width, int height, float thickness)
@@ -333,38 +331,37 @@ void Billboard::createAnimatedCube(float thickness)
 {
 }
 
-void Billboard::listenBackToForeground(CCObject *obj)
+void Billboard::restoreGLState()
 {
-	m_program = new CCGLProgram();
+	Model::restoreGLState();
 
-	if (m_textured && !m_textureToAlpha)
-	{
-		MESH_INIT_PHONG_TEXTURE(m_program);
-		CCShaderCache::sharedShaderCache()->addProgram(m_program, PHONG_SHADER_TEXTURE_KEY);
-	}
-	else
-	if (m_textureToAlpha)
-	{
-		MESH_INIT_PHONG_TEXTURE_TO_ALPHA(m_program);
-		CCShaderCache::sharedShaderCache()->addProgram(m_program, PHONG_SHADER_TEXTURE_TO_ALPHA_KEY);
-	}
-	else
-	{
-		MESH_INIT_PHONG(m_program);
-		CCShaderCache::sharedShaderCache()->addProgram(m_program, PHONG_SHADER_KEY);
-	}
+	//the old name may belong to another buffer by now, don't delete it
+	m_linksVBO = 0;
 
-	if (VBOCache::sharedVBOCache()->cacheIsInvalid())
-		VBOCache::sharedVBOCache()->purgeCache();
+	if (m_animatedHull)
+		generateLinks(0);
+}
 
-	setShaderProgram(m_program);
-	generateVBOs();
+unsigned int Billboard::shaderFeatures()
+{
+	unsigned int features = Model::shaderFeatures();
 
-	m_program->use();
+	//a hull can drop the texture of the billboard
+	if (m_hulled && !m_hullTextured)
+		features &= ~(PHONG_TEXTURE | PHONG_TEXTURE_TO_ALPHA);
 
-	initShaderLocations();
+	if (m_animatedHull)
+		features |= PHONG_ANIMATED_HULL;
 
-	m_lightsToSet = true;
+	return features;
+}
+
+void Billboard::initShaderLocations()
+{
+	Model::initShaderLocations();
+
+	if (m_animatedHull)
+		m_shaderLocations["CC_Time"] = getShaderProgram()->getUniformLocationForName("CC_Time");
 }
 
 void Billboard::draw3D()
@@ -373,8 +370,7 @@ void Billboard::draw3D()
 
 	m_at += CCDirector::sharedDirector()->getDeltaTime();
 
-	setupMatrices();
-	setupShadow();
+	updateMatrices();
 
 	bool toRender = true;
 
@@ -384,6 +380,11 @@ void Billboard::draw3D()
 	if (!toRender)
 		return;
 	
+	updateLights();
+	updateShaderProgram();
+
+	setupMatrices();
+	setupShadow();
 	setupLights();
 
 	if (m_animatedHull)
@@ -396,21 +397,32 @@ void Billboard::draw3D()
     setupMaterial(m_color, specular);
     setupAttribs();
 
+    if (m_lines && m_edgesIBO != 0)
+    {
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_edgesIBO);
+		glDrawElements(GL_LINES, m_edgeCounts[0], GL_UNSIGNED_SHORT, 0);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+    else
+    if (m_hulled && m_hullIBO != 0)
+    {
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_hullIBO);
+		glDrawElements(m_lines ? GL_LINES : m_indicesMode, m_indices.size(), GL_UNSIGNED_SHORT, 0);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+    else
     if (m_lines)
-		glDrawArrays(GL_LINES, 0,m_vertices.size());
+		glDrawArrays(GL_LINES, 0, m_vertexCount);
     else
 	if (m_hulled)
-	{
-		if (m_indices.size() > 0)
-			glDrawElements(GL_TRIANGLE_STRIP, m_indices.size(), GL_UNSIGNED_INT, &(m_indices[0]));
-		else
-			glDrawArrays(GL_TRIANGLES, 0, m_vertices.size());
-	}
+		glDrawArrays(GL_TRIANGLES, 0, m_vertexCount);
 	else
-		glDrawArrays(GL_TRIANGLE_STRIP, 0, m_vertices.size());
+		glDrawArrays(GL_TRIANGLE_STRIP, 0, m_vertexCount);
 
     CC_INCREMENT_GL_DRAWS(1);
 
+	disableAttribs();
+
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
 	CHECK_GL_ERROR_DEBUG();	
@@ -442,24 +454,83 @@ void Billboard::setColor(const Vec3& color)
 	m_color = color;
 }
 
-void Billboard::setupAttribs()
+void Billboard::generateVBOs()
 {
+	m_vertexCount = m_vertices.size();
+
+	Model::generateVBOs();
+
+	m_framesVBO = 0;
+	m_hullIBO = 0;
+
+	//sheets with the same layout have the same texels, share them
 	if (m_textured && m_nframes > 0)
+		m_framesVBO = VBOCache::sharedVBOCache()->getFramesVBO(framesId(), m_texelsFrame);
+
+	//hulls of the same id share the indices like their vertices
+	if (m_hulled && m_indices.size() > 0)
+		m_hullIBO = VBOCache::sharedVBOCache()->getIndexBuffer(m_meshId, m_indices);
+}
+
+void Billboard::edgeTriangles(std::vector<unsigned int>& triangles, std::vector<int>& firsts, std::vector<int>& counts)
+{
+	std::vector<unsigned int> strip;
+
+	if (m_hulled && m_indices.size() > 0)
+	{
+		if (m_indicesMode == GL_TRIANGLES)
+			triangles.assign(m_indices.begin(), m_indices.end());
+		else
+			strip.assign(m_indices.begin(), m_indices.end());
+	}
+	else
+	if (m_hulled)
+		weldVertices(m_vertices, triangles);
+	else
+		weldVertices(m_vertices, strip);	//quads and cubes are strips
+
+	for (unsigned int i = 0; i + 2 < strip.size(); i++)
 	{
-		glBindBuffer(GL_ARRAY_BUFFER, m_tVBO);
+		unsigned int a = strip[i], b = strip[i + 1], c = strip[i + 2];
 
-		if (m_nframes > 0)
-		{
-			m_texels = m_texelsFrame[m_currentFrame];
-			glBufferData(GL_ARRAY_BUFFER, m_texels.size()*sizeof(Vec2), &(m_texels[0]), GL_DYNAMIC_DRAW);
-		}
+		if (a == b || b == c || a == c)
+			continue;
 
-		glVertexAttribPointer(kCCVertexAttrib_TexCoords, 2, GL_FLOAT, GL_FALSE, 0, 0);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		if (i % 2 == 1)
+			std::swap(a, b);
+
+		triangles.push_back(a);
+		triangles.push_back(b);
+		triangles.push_back(c);
 	}
 
+	firsts.assign(1, 0);
+	counts.assign(1, (int)triangles.size());
+}
+
+std::string Billboard::framesId()
+{
+	char id[64];
+	snprintf(id, sizeof(id), "frames_%gx%g_%gx%g", m_frameSize.width, m_frameSize.height,
+		m_dTexture->getContentSizeInPixels().width, m_dTexture->getContentSizeInPixels().height);
+
+	return id;
+}
+
+void Billboard::setupAttribs()
+{
 	Model::setupAttribs();
 
+	//a frame is just an offset in the static buffer of all the frames
+	if (m_textured && m_framesVBO != 0 && !m_hulled)
+	{
+		GLsizeiptr offset = m_currentFrame * m_texelsFrame[0].size() * sizeof(Vec2);
+
+		glBindBuffer(GL_ARRAY_BUFFER, m_framesVBO);
+		glVertexAttribPointer(kCCVertexAttrib_TexCoords, 2, GL_FLOAT, GL_FALSE, 0, (const GLvoid*)offset);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
 	if (m_linksVBO == 0 && m_animatedHull)
 	{
 		glDisableVertexAttribArray(LINKS_VERTEX_ATTRIB);
@@ -468,7 +539,7 @@ void Billboard::setupAttribs()
 	if (m_animatedHull)
 	{
 		glBindBuffer(GL_ARRAY_BUFFER, m_linksVBO);
-		glVertexAttribPointer(glGetAttribLocation(getShaderProgram()->getProgram(), "a_links"), 3, GL_FLOAT, GL_FALSE, 0, 0);
+		glVertexAttribPointer(LINKS_VERTEX_ATTRIB, 3, GL_FLOAT, GL_FALSE, 0, 0);
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
 	}
 }
@@ -478,162 +549,143 @@ float Billboard::getRadius()
 	return 0.0f;
 }
 
-static double randomDistribution(double x)
+// xorshift32, small and reproducible across platforms, unlike rand()
+static unsigned int nextRandom(unsigned int& state)
 {
-	return 2.5 + sin(10 * x) / x;
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+
+	return state;
 }
 
-static double randomPoints(double(*function)(double), double xmin = 0, double xmax = 1)
+static float randomUnit(unsigned int& state)
 {
-	static double(*Fun)(double) = NULL, YMin, YMax;
-	static bool First = true;
-
-	// Initialises random generator for first call
-	if (First)
-	{
-		First = false;
-		srand((unsigned)time(NULL));
-	}
-#if (CC_TARGET_PLATFORM != CC_PLATFORM_WP8)
-	double randMax = 0x7fff;
-#else
-	double randMax = RAND_MAX;
-#endif
-	// Evaluates maximum of function
-	if (function != Fun)
-	{
-		Fun = function;
-		YMin = 0, YMax = Fun(xmin);
-		for (int iX = 1; iX < randMax; iX++)
-		{
-			double X = xmin + (xmax - xmin) * iX / randMax;
-			double Y = Fun(X);
-			YMax = Y > YMax ? Y : YMax;
-		}
-	}
-
-#if (CC_TARGET_PLATFORM == CC_PLATFORM_WP8)
-	// Gets random values for X & Y
-	double X = xmin + (xmax - xmin) * rand() / randMax;
-	double Y = YMin + (YMax - YMin) * rand() / randMax;
-#else
-	// Gets random values for X & Y
-	double X = xmin + (xmax - xmin) * fmod(rand(),randMax) / randMax;
-	double Y = YMin + (YMax - YMin) * fmod(rand(),randMax) / randMax;
-#endif
-	// Returns if valid and try again if not valid
-	return Y < function(X) ? X : randomPoints(Fun, xmin, xmax);
+	return (nextRandom(state) & 0xFFFFFF) / (float)0x1000000;
 }
 
-class compareVertex3F
+// Stratified sampling: the box is split in about count cells, the cells are
+// shuffled and each picked cell gets one jittered point. Points stay away from
+// the cell borders, so none lands on the outline or on another point.
+static void samplePoints(const kmAABB& box, int count, unsigned int seed, std::vector<Vec2>& points)
 {
-public:
-	bool operator()(Vec3 a, Vec3 b) const
-	{
-		return !(a.x == b.x && a.y == b.y && a.z == b.z);
-	}
-};
+	points.clear();
 
-void Billboard::generateVertexIndex()
-{
-	std::vector<unsigned int> indicesSet;
-	m_indices.resize(m_vertices.size());
-	unsigned int index = 0;
-	for (auto i = m_vertices.begin(); i != m_vertices.end(); i++, index++)
+	if (count <= 0)
+		return;
+
+	float width = box.max.x - box.min.x;
+	float height = box.max.y - box.min.y;
+
+	int cols = MAX(1, (int)ceilf(sqrtf(count * width / MAX(height, 1.0f))));
+	int rows = MAX(1, (count + cols - 1) / cols);
+
+	float cellWidth = width / cols;
+	float cellHeight = height / rows;
+
+	unsigned int state = seed * 2654435761u + 0x9E3779B9u;
+
+	if (state == 0)
+		state = 0x9E3779B9u;
+
+	std::vector<int> cells(cols * rows);
+
+	for (int i = 0; i < (int)cells.size(); i++)
+		cells[i] = i;
+
+	for (int i = 0; i < count && i < (int)cells.size(); i++)
 	{
-		Vec3& v1 = *i;
+		int swap = i + nextRandom(state) % (cells.size() - i);
+		std::swap(cells[i], cells[swap]);
 
-		unsigned int index2 = index + 1;
-		for (auto j = i + 1; j != m_vertices.end(); j++, index2++)
-		{
-			Vec3& v2 = *j;
-
-			if (v1.x == v2.x && v1.y == v2.y && v1.z == v2.z)
-			{
-				auto alreadyIn = std::find(indicesSet.begin(), indicesSet.end(), index2);
-
-				if (alreadyIn == indicesSet.end())
-				{
-					m_indices[index2] = index;
-					indicesSet.push_back(index2);
-				}
-			}
-			else
-			{
-				auto alreadyIn = std::find(indicesSet.begin(), indicesSet.end(), index2);
+		int col = cells[i] % cols;
+		int row = cells[i] / cols;
 
-				if (alreadyIn == indicesSet.end())
-					m_indices[index2] = index2;
-			}
-		}
+		float x = box.min.x + (col + 0.05f + 0.9f * randomUnit(state)) * cellWidth;
+		float y = box.min.y + (row + 0.05f + 0.9f * randomUnit(state)) * cellHeight;
+
+		points.push_back(Vec2(x, y));
 	}
 }
 
-void Billboard::generateTriangleStrip()
+// finished hulls by size, factor and seed, shared by every billboard asking for the same one
+struct HullMesh
+{
+	std::vector<Vec3> vertices;
+	std::vector<Vec3> normals;
+	std::vector<Vec2> texels;
+	std::vector<GLushort> indices;
+};
+
+static std::map<std::string, HullMesh> s_hullMeshes;
+
+void Billboard::generateVertexIndex()
 {
-	std::vector<unsigned int> newIndices;
+	std::vector<unsigned int> indices, remap;
 
-	using namespace triangle_stripper;
+	//vertices at the same position share one index, then triangles and vertices are reordered for the caches
+	weldVertices(m_vertices, indices);
 
-	// convert 32 bits indices from the submesh into the type used by Tri Stripper
-	indices Indices(m_indices.begin(), m_indices.end());
+	unsigned int count = optimizeIndexedMesh(indices, m_vertices.size(), remap, m_meshId);
 
-	primitive_vector PrimitivesVector;
+	//gles2 only has short indices, such a hull stays unindexed
+	if (count > 0xFFFF)
+	{
+		m_indices.clear();
+		return;
+	}
 
-	{ // we want to time the tri_stripper object destruction as well
-		tri_stripper TriStripper(Indices);
+	remapVertices(m_vertices, remap, count);
+	remapVertices(m_normals, remap, count);
+	remapVertices(m_texels, remap, count);
 
-		TriStripper.SetMinStripSize(2);
-		TriStripper.SetCacheSize();
-		TriStripper.SetBackwardSearch(false);
+	m_indices.assign(indices.begin(), indices.end());
+	m_indicesMode = GL_TRIANGLES;
+}
 
-		TriStripper.Strip(&PrimitivesVector);
+void Billboard::generateTriangleStrip()
+{
+	std::vector<unsigned int> indices(m_indices.begin(), m_indices.end());
+	std::vector<unsigned int> strip;
 
-		for (int i = 0; i < PrimitivesVector.size(); i++)
-		{
-			if (PrimitivesVector[i].Type == TRIANGLE_STRIP)
-			{
-				for (auto iter = PrimitivesVector[i].Indices.begin();
-					iter != PrimitivesVector[i].Indices.end();
-					iter++)
-				{
-					newIndices.push_back(*iter);
-				}
-			}
-		}
-	}
+	stripifyIndices(indices, strip);
 
-	m_indices = newIndices;
+	m_indices.assign(strip.begin(), strip.end());
+	m_indicesMode = GL_TRIANGLE_STRIP;
 }
 
-void Billboard::triangulation(int factor)
+void Billboard::triangulation(int factor, unsigned int seed)
 {
 	using namespace p2t;
 
-	vector<Triangle*> triangles;
-	list<Triangle*> map;
-	vector< vector<Point*> > polylines;
+	//points, edges and triangles live in the cdt pools, reused from one hull to the next
+	static CDT cdt;
+
+	//poly2tri throws on degenerate input, the next hull mustn't start from what's left
+	struct ClearOnExit
+	{
+		CDT& cdt;
+		~ClearOnExit(){ cdt.Clear(); }
+	} clear = { cdt };
+
 	vector<p2t::Point*> polyline;
 
-	polyline.push_back(new Point(m_aabb.min.x, m_aabb.min.y));
-	polyline.push_back(new Point(m_aabb.min.x, m_aabb.max.y));
-	polyline.push_back(new Point(m_aabb.max.x, m_aabb.max.y));
-	polyline.push_back(new Point(m_aabb.max.x, m_aabb.min.y));
+	polyline.push_back(cdt.NewPoint(m_aabb.min.x, m_aabb.min.y));
+	polyline.push_back(cdt.NewPoint(m_aabb.min.x, m_aabb.max.y));
+	polyline.push_back(cdt.NewPoint(m_aabb.max.x, m_aabb.max.y));
+	polyline.push_back(cdt.NewPoint(m_aabb.max.x, m_aabb.min.y));
 
-	polylines.push_back(polyline);
+	cdt.AddPolyline(polyline);
 
-	CDT* cdt = new CDT(polyline);
+	std::vector<Vec2> samples;
+	samplePoints(m_aabb, factor, seed, samples);
 
-	for (int i = 0; i < factor; i++)
-	{
-		double x = randomPoints(randomDistribution, m_aabb.min.x, m_aabb.max.x);
-		double y = randomPoints(randomDistribution, m_aabb.min.y, m_aabb.max.y);
-		cdt->AddPoint(new Point(x, y));
-	}
+	for (auto iter = samples.begin(); iter != samples.end(); iter++)
+		cdt.AddPoint(cdt.NewPoint(iter->x, iter->y));
 
-	cdt->Triangulate();
+	cdt.Triangulate();
 
-	triangles = cdt->GetTriangles();
+	const vector<Triangle*>& triangles = cdt.GetTriangles();
 
 	m_vertices.clear();
 	m_normals.clear();
@@ -670,109 +722,79 @@ void Billboard::triangulation(int factor)
 		m_normals.push_back(n2);
 		m_normals.push_back(n3);
 	}
-
-	delete cdt;
-
-	for (int i = 0; i < polylines.size(); i++)
-	{
-		vector<Point*> poly = polylines[i];
-
-		for (auto iter = polylines[i].begin(); iter != polylines[i].end(); iter++)
-		{
-			delete *iter;
-		}
-	}
 }
 
-void Billboard::hull(int factor, bool textured, bool animated, float increase, int axis)
+void Billboard::hull(int factor, bool textured, bool animated, float increase, int axis, unsigned int seed)
 {
 	m_animatedHull = false;
 	m_hulled = true;
+	m_hullTextured = textured;
 
 	glDisableVertexAttribArray(LINKS_VERTEX_ATTRIB);
 
-	triangulation(factor);
-	//generateVertexIndex();
-	//generateTriangleStrip();
+	//hulls are built at the real size, not on the unit quad
+	m_aabb.max.x = m_size.width / 2.0f;
+	m_aabb.max.y = m_size.height / 2.0f;
+	m_aabb.max.z = m_aabb.min.z = 0;
+	m_aabb.min.x = -m_aabb.max.x;
+	m_aabb.min.y = -m_aabb.max.y;
+	m_meshScale = Vec3(1, 1, 1);
 
-	if (!textured && !animated)
-	{
-		m_program = CCShaderCache::sharedShaderCache()->programForKey(PHONG_SHADER_KEY);
+	char id[64];
+	snprintf(id, sizeof(id), "billboard_hull_%gx%g_%d_%u", m_size.width, m_size.height, factor, seed);
+	m_meshId = id;
 
-		if (m_program == NULL)
-		{
-			m_program = new CCGLProgram();
-			MESH_INIT_PHONG(m_program);
-			CCShaderCache::sharedShaderCache()->addProgram(m_program, PHONG_SHADER_KEY);
-		}
+	auto cached = s_hullMeshes.find(m_meshId);
 
-		setShaderProgram(m_program);
+	if (cached != s_hullMeshes.end())
+	{
+		m_vertices = cached->second.vertices;
+		m_normals = cached->second.normals;
+		m_texels = cached->second.texels;
+		m_indices = cached->second.indices;
+		m_indicesMode = GL_TRIANGLES;
 	}
+	else
+	{
+		triangulation(factor, seed);
+		generateVertexIndex();
 
-	glDeleteBuffers(1, &m_pVBO);
-	glDeleteBuffers(1, &m_tVBO);
-	glDeleteBuffers(1, &m_nVBO);
+		HullMesh& mesh = s_hullMeshes[m_meshId];
+		mesh.vertices = m_vertices;
+		mesh.normals = m_normals;
+		mesh.texels = m_texels;
+		mesh.indices = m_indices;
+	}
 
-	generateVBOs();
+	if (!animated)
+		updateShaderProgram();
 
+	//before the VBOs, the vertices may not be kept after the upload
 	if (animated)
-		generateLinks(textured, increase);
+		generateLinks(increase);
+
+	//the VBOs are shared through the cache by the same id
+	generateVBOs();
 }
 
-void Billboard::generateLinks(bool textured, float increase)
+void Billboard::generateLinks(float increase)
 {
-	std::vector<unsigned int> links(m_vertices.size());
-	std::vector<unsigned int> linksCopy;
+	std::vector<unsigned int> links;
 
 	m_animatedHull = true;
 
-	//find duplicate vertices
+	//find duplicate vertices, each one is linked to the first at its position
+	weldVertices(m_vertices, links);
 
-	std::vector<unsigned int> linksSet;
-	linksSet.resize(m_vertices.size());
-	unsigned int index = 0;
-	for (auto i = m_vertices.begin(); i != m_vertices.end(); i++, index++)
-	{
-		Vec3& v1 = *i;
-
-		unsigned int index2 = index + 1;
-		for (auto j = i + 1; j != m_vertices.end(); j++, index2++)
-		{
-			Vec3& v2 = *j;
-
-			if (v1.x == v2.x && v1.y == v2.y && v1.z == v2.z)
-			{
-				auto alreadyIn = std::find(linksSet.begin(), linksSet.end(), index2);
-
-				if (alreadyIn == linksSet.end())
-				{
-					links[index2] = index;
-					linksSet.push_back(index2);
-				}
-			}
-			else
-			{
-				auto alreadyIn = std::find(linksSet.begin(), linksSet.end(), index2);
-
-				if (alreadyIn == linksSet.end())
-					links[index2] = index2;
-			}
-		}
-	}
-
-	//keep mapping of duplicate indices of vertices
-	linksCopy = links;
-
-	//keep unique list of indices
-	std::sort(links.begin(), links.end());
-	links.erase(std::unique(links.begin(), links.end()), links.end());
-
-	//create a map of value per index
-	std::map<unsigned int, float> linksMap;
+	//alternate the value between the unique vertices, in index order
+	std::vector<float> linksValue(m_vertices.size(), 0);
 	bool reverse = true;
-	for (auto iter = links.begin(); iter != links.end(); iter++)
+	for (unsigned int i = 0; i < links.size(); i++)
 	{
-		linksMap[*iter] = (reverse) ? 50 : -50;
+		if (links[i] != i)
+			continue;
+
+		linksValue[i] = (reverse) ? 50 : -50;
 
 		reverse = !reverse;
 	}
@@ -783,7 +805,7 @@ void Billboard::generateLinks(bool textured, float increase)
 	{
 		Vec3 v = Vec3(0, 0, 0);
 
-		v.z = linksMap[linksCopy[i]];
+		v.z = linksValue[links[i]];
 
 		linksValues.push_back(v);
 	}
@@ -797,37 +819,15 @@ void Billboard::generateLinks(bool textured, float increase)
 	glBufferData(GL_ARRAY_BUFFER, linksValues.size()*sizeof(Vec3), &(linksValues[0]), GL_STATIC_DRAW);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-	if (!textured)
-	{
-		m_program = CCShaderCache::sharedShaderCache()->programForKey(PHONG_SHADER_ANIMATED_KEY);
-
-		if (m_program == NULL)
-		{
-			m_program = new CCGLProgram();
-			MESH_INIT_PHONG_ANIMATED(m_program);
-			CCShaderCache::sharedShaderCache()->addProgram(m_program, PHONG_SHADER_ANIMATED_KEY);
-		}
-	}
-	else
-	{
-		m_program = CCShaderCache::sharedShaderCache()->programForKey(PHONG_SHADER_TEXTURE_ANIMATED_KEY);
-
-		if (m_program == NULL)
-		{
-			m_program = new CCGLProgram();
-			MESH_INIT_PHONG_TEXTURE_ANIMATED(m_program);
-			CCShaderCache::sharedShaderCache()->addProgram(m_program, PHONG_SHADER_TEXTURE_ANIMATED_KEY);
-		}
-	}
+	updateShaderProgram();
 
-	setShaderProgram(m_program);
-	
-	glBindAttribLocation(getShaderProgram()->getProgram(), LINKS_VERTEX_ATTRIB, "a_links");
 	glEnableVertexAttribArray(LINKS_VERTEX_ATTRIB);
+}
 
-	initShaderLocations();
-	
-	m_shaderLocations["CC_Time"] = glGetUniformLocation(getShaderProgram()->getProgram(), "CC_Time");
+void Billboard::purgeHullCache()
+{
+	//the VBOs stay, billboards still hulled draw from them by the same id
+	s_hullMeshes.clear();
 }
 
 void Billboard::dehull()
@@ -835,41 +835,24 @@ void Billboard::dehull()
 	if (!m_hulled)
 		return;
 	
-	if (m_animatedHull && m_textured)
-	{
-		m_program = CCShaderCache::sharedShaderCache()->programForKey(PHONG_SHADER_TEXTURE_KEY);
-		
-		if (m_program == NULL)
-		{
-			m_program = new CCGLProgram();
-			MESH_INIT_PHONG_TEXTURE(m_program);
-			CCShaderCache::sharedShaderCache()->addProgram(m_program, PHONG_SHADER_TEXTURE_KEY);
-		}
-	}
-	else
-	{
-		m_program = CCShaderCache::sharedShaderCache()->programForKey(PHONG_SHADER_KEY);
-		
-		if (m_program == NULL)
-		{
-			m_program = new CCGLProgram();
-			MESH_INIT_PHONG(m_program);
-			CCShaderCache::sharedShaderCache()->addProgram(m_program, PHONG_SHADER_KEY);
-		}
-	}
-	
 	m_hulled = m_animatedHull = false;
-	
-	setShaderProgram(m_program);
+	m_hullTextured = true;
+
+	updateShaderProgram();
 	
 	glDeleteBuffers(1, &m_linksVBO);
+	m_linksVBO = 0;
 	//glDisableVertexAttribArray(LINKS_VERTEX_ATTRIB);
-	
+
 	m_vertices.clear();
 	m_normals.clear();
 	m_texels.clear();
+	m_indices.clear();
 	
-	createQuad(m_aabb.max.x*2.0f, m_aabb.max.y*2.0f);
+	if (m_nframes > 0)
+		createAnimatedQuad();
+	else
+		createQuad(m_size.width, m_size.height);
+
 	generateVBOs();
-	initShaderLocations();
 }
\ No newline at end of file
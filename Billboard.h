@@ -28,36 +28,58 @@ namespace cocos3d
 
 		void setColor(const Vec3& color);
 
-		void hull(int factor, bool textured = true, bool animated = false, float increase = 50, int axis = 0x000);
+		// the same size, factor and seed always give the same hull, built only once
+		void hull(int factor, bool textured = true, bool animated = false, float increase = 50, int axis = 0x000, unsigned int seed = 0);
 		void dehull();
 
-		void listenBackToForeground(CCObject *obj);
+		// frees the vertices of the hulls kept for reuse, a purged hull is triangulated
+		// again the next time, the VBOs stay in the VBOCache for the billboards using them
+		static void purgeHullCache();
+
+		virtual void restoreGLState();
+
+		// the unit quad every billboard shares, drawn as a strip of 4 vertices
+		static void getQuadVBOs(GLuint* vertices, GLuint* texels);
 	protected:
 		Billboard();
 
 		void createQuad(int width, int height);
+		void createQuadMesh(float width, float height);
+		static void quadMesh(float width, float height, std::vector<Vec3>& vertices, std::vector<Vec3>& normals, std::vector<Vec2>& texels);
 		void createCube(int width, int height, float thickness);
 		void createAnimatedQuad();
 		void createAnimatedCube(float thickness);
 		void setupAttribs();
 		void setupAnimation();
+		void generateVBOs();
+		std::string framesId();
+
+		virtual unsigned int shaderFeatures();
+		virtual void initShaderLocations();
 
-		void triangulation(int factor);
-		void generateLinks(bool textured, float increase);
+		void triangulation(int factor, unsigned int seed);
+		void generateLinks(float increase);
 		void generateVertexIndex();
+		void edgeTriangles(std::vector<unsigned int>& triangles, std::vector<int>& firsts, std::vector<int>& counts);
 		void generateTriangleStrip();
 
 		std::vector<std::vector<Vec2> > m_texelsFrame;
 
-		std::vector<unsigned int> m_indices;
+		std::vector<GLushort> m_indices;
+		GLenum m_indicesMode;
+		GLuint m_hullIBO;
+		// what's drawn without indices, the vertices may be dropped once uploaded
+		unsigned int m_vertexCount;
 
 		Vec3 m_color;
 
 		GLuint m_linksVBO;
+		GLuint m_framesVBO;
 		
-		bool m_hulled, m_animatedHull;
+		bool m_hulled, m_animatedHull, m_hullTextured;
 		float m_delay, m_at;
 		CCSize m_frameSize;
+		CCSize m_size;
 		unsigned int m_rows, m_cols;
 	};
 }
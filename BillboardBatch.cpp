@@ -0,0 +1,418 @@
+#include "BillboardBatch.h"
+#include "Layer3D.h"
+#include "Camera.h"
+#include "shaders.h"
+#include "RestoreManager.h"
+
+using namespace cocos3d;
+
+// segments of the vertex ring, one is written while the others may still be drawn
+#define RING_SEGMENTS 3
+// 16 bit indices
+#define MAX_SPRITES (65536 / 4)
+
+BillboardBatch::BillboardBatch()
+: m_texture(NULL)
+, m_program(NULL)
+, m_capacity(0)
+, m_vbo(0)
+, m_ibo(0)
+, m_segment(0)
+, m_uploadNeeded(false)
+, m_mvLocation(-1)
+, m_pLocation(-1)
+, m_scaleLocation(-1)
+, m_textureLocation(-1)
+{
+	m_blendFunc.src = CC_BLEND_SRC;
+	m_blendFunc.dst = CC_BLEND_DST;
+}
+
+BillboardBatch::~BillboardBatch()
+{
+	if (m_vbo != 0)
+		glDeleteBuffers(1, &m_vbo);
+
+	if (m_ibo != 0)
+		glDeleteBuffers(1, &m_ibo);
+
+	if (m_texture != NULL)
+		m_texture->release();
+
+#if CC_ENABLE_CACHE_TEXTURE_DATA
+	RestoreManager::sharedRestoreManager()->removeNode(this);
+#endif
+}
+
+BillboardBatch* BillboardBatch::createWithTexture(CCTexture2D* texture, unsigned int capacity)
+{
+	BillboardBatch *pRet = new BillboardBatch();
+	if (pRet && pRet->initWithTexture(texture, capacity))
+	{
+		pRet->autorelease();
+		return pRet;
+	}
+	else
+	{
+		delete pRet;
+		pRet = NULL;
+		return NULL;
+	}
+}
+
+BillboardBatch* BillboardBatch::createWithTextureGrid(CCTexture2D* texture, unsigned int capacity, const int framesPerRow, const CCSize& frameSize)
+{
+	BillboardBatch *pRet = new BillboardBatch();
+	if (pRet && pRet->initWithTextureGrid(texture, capacity, framesPerRow, frameSize))
+	{
+		pRet->autorelease();
+		return pRet;
+	}
+	else
+	{
+		delete pRet;
+		pRet = NULL;
+		return NULL;
+	}
+}
+
+bool BillboardBatch::initWithTexture(CCTexture2D* texture, unsigned int capacity)
+{
+	if (texture == NULL)
+		return false;
+
+	CCSize size = texture->getContentSize();
+
+	return initWithTextureGrid(texture, capacity, 1, size);
+}
+
+bool BillboardBatch::initWithTextureGrid(CCTexture2D* texture, unsigned int capacity, const int framesPerRow, const CCSize& frameSize)
+{
+	if (texture == NULL || capacity == 0 || framesPerRow <= 0)
+		return false;
+
+	m_texture = texture;
+	m_texture->retain();
+
+	m_capacity = MIN(capacity, MAX_SPRITES);
+
+	//frames are read left to right, top to bottom
+	float texelWidth = frameSize.width / m_texture->getContentSize().width;
+	float texelHeight = frameSize.height / m_texture->getContentSize().height;
+	int rows = MAX(1, (int)(m_texture->getContentSize().height / frameSize.height));
+
+	for (int j = 0; j < rows; j++)
+	{
+		for (int i = 0; i < framesPerRow; i++)
+		{
+			Frame frame = { i*texelWidth, j*texelHeight, (i+1)*texelWidth, (j+1)*texelHeight };
+			m_frames.push_back(frame);
+		}
+	}
+
+	m_positions.reserve(m_capacity);
+	m_halfSizes.reserve(m_capacity);
+	m_rotations.reserve(m_capacity);
+	m_colors.reserve(m_capacity);
+	m_spriteFrames.reserve(m_capacity);
+	m_spriteDirty.reserve(m_capacity);
+	m_vertices.reserve(m_capacity * 4);
+
+	m_program = billboardBatchProgram();
+	setShaderProgram(m_program);
+
+	generateBuffers();
+	initShaderLocations();
+
+#if CC_ENABLE_CACHE_TEXTURE_DATA
+	RestoreManager::sharedRestoreManager()->addNode(this);
+#endif
+
+	return Node3D::init();
+}
+
+void BillboardBatch::generateBuffers()
+{
+	std::vector<GLushort> indices(m_capacity * 6);
+
+	for (unsigned int i = 0; i < m_capacity; i++)
+	{
+		GLushort first = (GLushort)(i * 4);
+
+		indices[i*6 + 0] = first;
+		indices[i*6 + 1] = first + 1;
+		indices[i*6 + 2] = first + 2;
+		indices[i*6 + 3] = first + 2;
+		indices[i*6 + 4] = first + 1;
+		indices[i*6 + 5] = first + 3;
+	}
+
+	glGenBuffers(1, &m_ibo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size()*sizeof(GLushort), &(indices[0]), GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	glGenBuffers(1, &m_vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+	glBufferData(GL_ARRAY_BUFFER, RING_SEGMENTS * m_capacity * 4 * sizeof(Vertex), NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	m_segment = 0;
+	m_uploadNeeded = true;
+}
+
+void BillboardBatch::initShaderLocations()
+{
+	m_mvLocation = m_program->getUniformLocationForName("CC_MVMatrix");
+	m_pLocation = m_program->getUniformLocationForName("CC_PMatrix");
+	m_scaleLocation = m_program->getUniformLocationForName("uScale");
+	m_textureLocation = m_program->getUniformLocationForName("uTexture");
+}
+
+void BillboardBatch::restoreGLState()
+{
+	m_program = billboardBatchProgram(RestoreManager::sharedRestoreManager()->claimProgram(BILLBOARD_BATCH_SHADER_KEY));
+	setShaderProgram(m_program);
+
+	//the old names may belong to other buffers by now, don't delete them
+	m_vbo = m_ibo = 0;
+
+	generateBuffers();
+	initShaderLocations();
+}
+
+int BillboardBatch::addSprite(const Vec3& position, const CCSize& size, const ccColor4B& color, float rotation, unsigned int frame)
+{
+	if (m_positions.size() >= m_capacity)
+		return -1;
+
+	unsigned int index = (unsigned int)m_positions.size();
+
+	m_positions.push_back(position);
+	m_halfSizes.push_back(Vec2(size.width / 2.0f, size.height / 2.0f));
+	m_rotations.push_back(rotation);
+	m_colors.push_back(color);
+	m_spriteFrames.push_back(frame < m_frames.size() ? frame : 0);
+	m_spriteDirty.push_back(false);
+
+	m_vertices.resize(m_positions.size() * 4);
+
+	markDirty(index);
+
+	return (int)index;
+}
+
+void BillboardBatch::removeSprite(unsigned int index)
+{
+	if (index >= m_positions.size())
+		return;
+
+	unsigned int last = (unsigned int)m_positions.size() - 1;
+
+	if (index != last)
+	{
+		m_positions[index] = m_positions[last];
+		m_halfSizes[index] = m_halfSizes[last];
+		m_rotations[index] = m_rotations[last];
+		m_colors[index] = m_colors[last];
+		m_spriteFrames[index] = m_spriteFrames[last];
+
+		markDirty(index);
+	}
+
+	m_positions.pop_back();
+	m_halfSizes.pop_back();
+	m_rotations.pop_back();
+	m_colors.pop_back();
+	m_spriteFrames.pop_back();
+	m_spriteDirty.pop_back();
+
+	m_vertices.resize(m_positions.size() * 4);
+
+	m_uploadNeeded = true;
+}
+
+void BillboardBatch::removeAllSprites()
+{
+	m_positions.clear();
+	m_halfSizes.clear();
+	m_rotations.clear();
+	m_colors.clear();
+	m_spriteFrames.clear();
+	m_spriteDirty.clear();
+	m_dirtySprites.clear();
+	m_vertices.clear();
+
+	m_uploadNeeded = true;
+}
+
+void BillboardBatch::setSpritePosition(unsigned int index, const Vec3& position)
+{
+	if (index >= m_positions.size())
+		return;
+
+	m_positions[index] = position;
+	markDirty(index);
+}
+
+void BillboardBatch::setSpriteSize(unsigned int index, const CCSize& size)
+{
+	if (index >= m_positions.size())
+		return;
+
+	m_halfSizes[index] = Vec2(size.width / 2.0f, size.height / 2.0f);
+	markDirty(index);
+}
+
+void BillboardBatch::setSpriteColor(unsigned int index, const ccColor4B& color)
+{
+	if (index >= m_positions.size())
+		return;
+
+	m_colors[index] = color;
+	markDirty(index);
+}
+
+void BillboardBatch::setSpriteRotation(unsigned int index, float rotation)
+{
+	if (index >= m_positions.size())
+		return;
+
+	m_rotations[index] = rotation;
+	markDirty(index);
+}
+
+void BillboardBatch::setSpriteFrame(unsigned int index, unsigned int frame)
+{
+	if (index >= m_positions.size() || frame >= m_frames.size())
+		return;
+
+	m_spriteFrames[index] = frame;
+	markDirty(index);
+}
+
+void BillboardBatch::markDirty(unsigned int index)
+{
+	if (!m_spriteDirty[index])
+	{
+		m_spriteDirty[index] = true;
+		m_dirtySprites.push_back(index);
+	}
+
+	m_uploadNeeded = true;
+}
+
+void BillboardBatch::updateVertices()
+{
+	//removed sprites may still be listed
+	unsigned int count = (unsigned int)m_positions.size();
+
+	for (auto iter = m_dirtySprites.begin(); iter != m_dirtySprites.end(); iter++)
+	{
+		unsigned int i = *iter;
+
+		if (i >= count)
+			continue;
+
+		const Vec3& center = m_positions[i];
+		const Vec2& half = m_halfSizes[i];
+		const Frame& frame = m_frames[m_spriteFrames[i]];
+		float rotation = m_rotations[i];
+
+		Vertex* quad = &m_vertices[i * 4];
+
+		quad[0].corner = Vec3(-half.x, -half.y, rotation);
+		quad[1].corner = Vec3( half.x, -half.y, rotation);
+		quad[2].corner = Vec3(-half.x,  half.y, rotation);
+		quad[3].corner = Vec3( half.x,  half.y, rotation);
+
+		quad[0].texel = Vec2(frame.u0, frame.v1);
+		quad[1].texel = Vec2(frame.u1, frame.v1);
+		quad[2].texel = Vec2(frame.u0, frame.v0);
+		quad[3].texel = Vec2(frame.u1, frame.v0);
+
+		for (int v = 0; v < 4; v++)
+		{
+			quad[v].center = center;
+			quad[v].color = m_colors[i];
+		}
+
+		m_spriteDirty[i] = false;
+	}
+
+	m_dirtySprites.clear();
+}
+
+void BillboardBatch::uploadVertices()
+{
+	updateVertices();
+
+	if (m_vertices.size() > 0)
+	{
+		m_segment = (m_segment + 1) % RING_SEGMENTS;
+
+		glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+		glBufferSubData(GL_ARRAY_BUFFER, m_segment * m_capacity * 4 * sizeof(Vertex), m_vertices.size()*sizeof(Vertex), &(m_vertices[0]));
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	m_uploadNeeded = false;
+}
+
+void BillboardBatch::draw3D()
+{
+	Layer3D* parent = dynamic_cast<Layer3D*>(m_pParent);
+
+	if (parent == NULL || m_positions.size() == 0)
+		return;
+
+	//nothing changed, draw the last segment again
+	if (m_uploadNeeded)
+		uploadVertices();
+
+	kmMat4 matrixM, matrixMV, rotation, translation, scale;
+	kmQuaternion quat;
+
+	kmMat4Translation(&translation, m_fullPosition.x, m_fullPosition.y, m_fullPosition.z);
+	kmQuaternionRotationYawPitchRoll(&quat, -m_yaw, -m_pitch, -m_roll);
+	kmMat4RotationQuaternion(&rotation, &quat);
+	kmMat4Scaling(&scale, m_scale, m_scale, m_scale);
+	kmMat4Multiply(&matrixM, &translation, &rotation);
+	kmMat4Multiply(&matrixM, &matrixM, &scale);
+	kmMat4Multiply(&matrixMV, &(parent->get3DCamera()->getViewMatrix()), &matrixM);
+
+	glUniformMatrix4fv(m_mvLocation, 1, 0, matrixMV.mat);
+	glUniformMatrix4fv(m_pLocation, 1, 0, parent->get3DCamera()->getProjectionMatrix().mat);
+	glUniform1f(m_scaleLocation, m_scale);
+	glUniform1i(m_textureLocation, 0);
+
+	ccGLBindTexture2D(m_texture->getName());
+	ccGLBlendFunc(m_blendFunc.src, m_blendFunc.dst);
+
+	//sprites are sorted by nobody, don't let them hide each other
+	glDepthMask(GL_FALSE);
+
+	ccGLEnableVertexAttribs(kCCVertexAttribFlag_PosColorTex);
+	glEnableVertexAttribArray(kCCVertexAttrib_Corner);
+
+	size_t base = m_segment * m_capacity * 4 * sizeof(Vertex);
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+	glVertexAttribPointer(kCCVertexAttrib_Position, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const GLvoid*)(base + offsetof(Vertex, center)));
+	glVertexAttribPointer(kCCVertexAttrib_Corner, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const GLvoid*)(base + offsetof(Vertex, corner)));
+	glVertexAttribPointer(kCCVertexAttrib_TexCoords, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const GLvoid*)(base + offsetof(Vertex, texel)));
+	glVertexAttribPointer(kCCVertexAttrib_Color, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (const GLvoid*)(base + offsetof(Vertex, color)));
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
+	glDrawElements(GL_TRIANGLES, (GLsizei)(m_positions.size() * 6), GL_UNSIGNED_SHORT, 0);
+
+	CC_INCREMENT_GL_DRAWS(1);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glDisableVertexAttribArray(kCCVertexAttrib_Corner);
+	glDepthMask(GL_TRUE);
+
+	CHECK_GL_ERROR_DEBUG();
+}
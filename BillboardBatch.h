@@ -0,0 +1,99 @@
+#ifndef __BILLBOARD_BATCH_H__
+#define __BILLBOARD_BATCH_H__
+#include <vector>
+#include "Node3D.h"
+
+namespace cocos3d
+{
+	// Draws thousands of camera facing sprites sharing one texture in a single call.
+	// Sprites are kept in packed arrays, only the changed ones are rebuilt on the cpu
+	// and the vertices are streamed into a ring of buffer segments, so the gpu never
+	// waits for a segment it's still reading.
+	//
+	// Removing a sprite moves the last one into its slot, so indices returned by
+	// addSprite are only stable until the next removeSprite.
+	class BillboardBatch : public Node3D
+	{
+	public:
+		virtual ~BillboardBatch();
+
+		static BillboardBatch* createWithTexture(CCTexture2D* texture, unsigned int capacity);
+		static BillboardBatch* createWithTextureGrid(CCTexture2D* texture, unsigned int capacity, const int framesPerRow, const CCSize& frameSize);
+
+		virtual bool initWithTexture(CCTexture2D* texture, unsigned int capacity);
+		virtual bool initWithTextureGrid(CCTexture2D* texture, unsigned int capacity, const int framesPerRow, const CCSize& frameSize);
+
+		// returns the sprite index or -1 when the batch is full
+		int addSprite(const Vec3& position, const CCSize& size, const ccColor4B& color = ccc4(255, 255, 255, 255), float rotation = 0, unsigned int frame = 0);
+		void removeSprite(unsigned int index);
+		void removeAllSprites();
+
+		void setSpritePosition(unsigned int index, const Vec3& position);
+		void setSpriteSize(unsigned int index, const CCSize& size);
+		void setSpriteColor(unsigned int index, const ccColor4B& color);
+		void setSpriteRotation(unsigned int index, float rotation);
+		void setSpriteFrame(unsigned int index, unsigned int frame);
+
+		const Vec3& getSpritePosition(unsigned int index){ return m_positions[index]; }
+		unsigned int getSpriteCount(){ return (unsigned int)m_positions.size(); }
+		unsigned int getCapacity(){ return m_capacity; }
+		unsigned int getFrameCount(){ return (unsigned int)m_frames.size(); }
+
+		void setBlendFunc(const ccBlendFunc& blendFunc){ m_blendFunc = blendFunc; }
+		const ccBlendFunc& getBlendFunc(){ return m_blendFunc; }
+
+		virtual void setScale(float scale){ m_scale = scale; }
+
+		virtual void draw3D();
+		virtual void restoreGLState();
+
+	protected:
+		BillboardBatch();
+
+		struct Vertex
+		{
+			Vec3 center;
+			Vec3 corner;	// offset from the center and rotation
+			Vec2 texel;
+			ccColor4B color;
+		};
+
+		struct Frame
+		{
+			float u0, v0, u1, v1;
+		};
+
+		void generateBuffers();
+		void initShaderLocations();
+		void markDirty(unsigned int index);
+		void updateVertices();
+		void uploadVertices();
+
+		CCTexture2D* m_texture;
+		CCGLProgram* m_program;
+
+		unsigned int m_capacity;
+
+		//sprites
+		std::vector<Vec3> m_positions;
+		std::vector<Vec2> m_halfSizes;
+		std::vector<float> m_rotations;
+		std::vector<ccColor4B> m_colors;
+		std::vector<unsigned int> m_spriteFrames;
+
+		std::vector<unsigned int> m_dirtySprites;
+		std::vector<bool> m_spriteDirty;
+
+		std::vector<Frame> m_frames;
+		std::vector<Vertex> m_vertices;
+
+		GLuint m_vbo, m_ibo;
+		unsigned int m_segment;
+		bool m_uploadNeeded;
+
+		GLint m_mvLocation, m_pLocation, m_scaleLocation, m_textureLocation;
+
+		ccBlendFunc m_blendFunc;
+	};
+}
+#endif
@@ -0,0 +1,317 @@
+#include "CompressedTexture.h"
+#include "GLCapabilities.h"
+#include <map>
+
+using namespace cocos3d;
+
+static std::map<std::string, CCTexture2D*> s_compressedTextures;
+
+struct CompressedVariant
+{
+	const char* suffix;
+	GLenum format;
+};
+
+// best first, the gpu picks the first it reads
+static const CompressedVariant compressedVariants[] = {
+	{ ".astc.ktx", GL_COMPRESSED_RGBA_ASTC_4x4_KHR },
+	{ ".etc2.ktx", GL_COMPRESSED_RGBA8_ETC2_EAC },
+	{ ".pvrtc.ktx", GL_COMPRESSED_RGBA_PVRTC_4BPPV1_IMG },
+	{ ".dxt.ktx", GL_COMPRESSED_RGBA_S3TC_DXT5_EXT },
+	{ ".etc1.ktx", GL_ETC1_RGB8_OES }
+};
+
+static bool endsWith(const std::string& value, const std::string& suffix)
+{
+	return value.size() >= suffix.size() && value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+CompressedTexture::CompressedTexture()
+: m_uploadedBytes(0)
+{
+#if CC_ENABLE_CACHE_TEXTURE_DATA
+	RestoreManager::sharedRestoreManager()->addListener(this);
+#endif
+}
+
+CompressedTexture::~CompressedTexture()
+{
+#if CC_ENABLE_CACHE_TEXTURE_DATA
+	RestoreManager::sharedRestoreManager()->removeListener(this);
+#endif
+}
+
+CompressedTexture* CompressedTexture::createWithFile(const std::string& file)
+{
+	CompressedTexture *pRet = new CompressedTexture();
+	if (pRet && pRet->initWithFile(file))
+	{
+		pRet->autorelease();
+	}
+	else
+	{
+		delete pRet;
+		pRet = NULL;
+	}
+	return pRet;
+}
+
+CompressedTexture* CompressedTexture::createWithKTXData(const unsigned char* data, unsigned long size)
+{
+	CompressedTexture *pRet = new CompressedTexture();
+	if (pRet && pRet->initWithKTXData(data, size))
+	{
+		pRet->autorelease();
+	}
+	else
+	{
+		delete pRet;
+		pRet = NULL;
+	}
+	return pRet;
+}
+
+bool CompressedTexture::initWithFile(const std::string& file)
+{
+	std::string fullPath = CCFileUtils::sharedFileUtils()->fullPathForFilename(file.c_str());
+
+	unsigned long size = 0;
+	unsigned char* data = CCFileUtils::sharedFileUtils()->getFileData(fullPath.c_str(), "rb", &size);
+
+	if (data == NULL)
+		return false;
+
+	KTXImage image;
+	bool pRet = parseKTX(data, size, &image) && upload(image);
+
+	delete [] data;
+
+	if (!pRet)
+		CCLOG("cocos3d: can't upload %s", file.c_str());
+
+	m_path = fullPath;
+
+	return pRet;
+}
+
+bool CompressedTexture::initWithKTXData(const unsigned char* data, unsigned long size)
+{
+	KTXImage image;
+
+	if (!parseKTX(data, size, &image) || !upload(image))
+		return false;
+
+#if CC_ENABLE_CACHE_TEXTURE_DATA
+	m_data.assign(data, data + size);
+#endif
+
+	return true;
+}
+
+bool CompressedTexture::isCompressedFile(const std::string& file)
+{
+	return endsWith(file, ".ktx");
+}
+
+bool CompressedTexture::supportsFormat(GLenum internalFormat)
+{
+	return GLCapabilities::sharedGLCapabilities()->supportsCompressedFormat(internalFormat);
+}
+
+bool CompressedTexture::upload(const KTXImage& image)
+{
+	GLenum format = image.internalFormat;
+	bool decode = false;
+
+	if (image.isCompressed() && !supportsFormat(format))
+	{
+		//etc2 decoders read etc1 blocks as they are
+		if (format == GL_ETC1_RGB8_OES && supportsFormat(GL_COMPRESSED_RGB8_ETC2))
+			format = GL_COMPRESSED_RGB8_ETC2;
+		else
+		if (format == GL_ETC1_RGB8_OES)
+			decode = true;
+		else
+			return false;
+	}
+	else
+	if (!image.isCompressed() && (image.type != GL_UNSIGNED_BYTE || (image.format != GL_RGBA && image.format != GL_RGB)))
+	{
+		return false;
+	}
+
+	glGenTextures(1, &m_uName);
+	ccGLBindTexture2D(m_uName);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	std::vector<unsigned char> rgba;
+
+	m_uploadedBytes = 0;
+
+	for (unsigned int level = 0; level < image.levels.size(); level++)
+	{
+		const KTXLevel& ktxLevel = image.levels[level];
+
+		if (decode)
+		{
+			rgba.resize(ktxLevel.width * ktxLevel.height * 4);
+
+			if (!decodeETC1(ktxLevel.data, ktxLevel.size, ktxLevel.width, ktxLevel.height, &rgba[0]))
+				return false;
+
+			glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, ktxLevel.width, ktxLevel.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, &rgba[0]);
+			m_uploadedBytes += (unsigned int)rgba.size();
+		}
+		else
+		if (image.isCompressed())
+		{
+			glCompressedTexImage2D(GL_TEXTURE_2D, level, format, ktxLevel.width, ktxLevel.height, 0, ktxLevel.size, ktxLevel.data);
+			m_uploadedBytes += ktxLevel.size;
+		}
+		else
+		{
+			glTexImage2D(GL_TEXTURE_2D, level, image.format, ktxLevel.width, ktxLevel.height, 0, image.format, GL_UNSIGNED_BYTE, ktxLevel.data);
+			m_uploadedBytes += ktxLevel.size;
+		}
+	}
+
+	//gles2 has no max level, a chain stopping before 1x1 is incomplete and left unused
+	unsigned int fullChain = 1;
+
+	for (unsigned int size = MAX(image.width, image.height); size > 1; size >>= 1)
+		fullChain++;
+
+	bool pot = (ccNextPOT(image.width) == image.width && ccNextPOT(image.height) == image.height);
+
+	m_bHasMipmaps = (image.levels.size() >= fullChain);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, m_bHasMipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, pot ? GL_REPEAT : GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, pot ? GL_REPEAT : GL_CLAMP_TO_EDGE);
+
+	CHECK_GL_ERROR_DEBUG();
+
+	m_uPixelsWide = image.width;
+	m_uPixelsHigh = image.height;
+	m_tContentSize = CCSizeMake(image.width, image.height);
+	m_fMaxS = 1;
+	m_fMaxT = 1;
+	m_bHasPremultipliedAlpha = false;
+
+	//cocos2d has no compressed formats but pvrtc, the others pass for the 4 bit one,
+	//getUploadedBytes is what they really take
+	if (decode)
+		m_ePixelFormat = kCCTexture2DPixelFormat_RGBA8888;
+	else
+	if (!image.isCompressed())
+		m_ePixelFormat = (image.format == GL_RGB) ? kCCTexture2DPixelFormat_RGB888 : kCCTexture2DPixelFormat_RGBA8888;
+	else
+	if (format == GL_COMPRESSED_RGB_PVRTC_2BPPV1_IMG || format == GL_COMPRESSED_RGBA_PVRTC_2BPPV1_IMG)
+		m_ePixelFormat = kCCTexture2DPixelFormat_PVRTC2;
+	else
+		m_ePixelFormat = kCCTexture2DPixelFormat_PVRTC4;
+
+	setShaderProgram(CCShaderCache::sharedShaderCache()->programForKey(kCCShader_PositionTexture));
+
+	return true;
+}
+
+void CompressedTexture::restoreGLState()
+{
+	//the name went away with the context
+	m_uName = 0;
+
+	if (!m_data.empty())
+	{
+		KTXImage image;
+
+		if (parseKTX(&m_data[0], m_data.size(), &image))
+			upload(image);
+	}
+	else
+	if (!m_path.empty())
+	{
+		initWithFile(m_path);
+	}
+}
+
+CCTexture2D* CompressedTexture::textureForFile(const std::string& file)
+{
+	auto found = s_compressedTextures.find(file);
+
+	if (found != s_compressedTextures.end())
+		return found->second;
+
+	std::string base = file.substr(0, file.size() - 4);
+	CCTexture2D* texture = NULL;
+
+	for (unsigned int i = 0; i < sizeof(compressedVariants) / sizeof(compressedVariants[0]) && texture == NULL; i++)
+	{
+		std::string variant = base + compressedVariants[i].suffix;
+
+		if (!supportsFormat(compressedVariants[i].format))
+			continue;
+
+		if (CCFileUtils::sharedFileUtils()->isFileExist(CCFileUtils::sharedFileUtils()->fullPathForFilename(variant.c_str())))
+			texture = createWithFile(variant);
+	}
+
+	if (texture == NULL && CCFileUtils::sharedFileUtils()->isFileExist(CCFileUtils::sharedFileUtils()->fullPathForFilename(file.c_str())))
+		texture = createWithFile(file);
+
+	if (texture == NULL)
+	{
+		CCLOG("cocos3d: no compressed texture for %s the gpu reads, decoding %s.png", file.c_str(), base.c_str());
+
+		texture = CCTextureCache::sharedTextureCache()->addImage((base + ".png").c_str());
+	}
+
+	if (texture != NULL)
+	{
+		texture->retain();
+		s_compressedTextures[file] = texture;
+	}
+
+	return texture;
+}
+
+CCTexture2D* CompressedTexture::textureForData(const std::string& key, const unsigned char* data, unsigned long size)
+{
+	auto found = s_compressedTextures.find(key);
+
+	if (found != s_compressedTextures.end())
+		return found->second;
+
+	CCTexture2D* texture = createWithKTXData(data, size);
+
+	if (texture == NULL)
+	{
+		CCLOG("cocos3d: can't upload %s", key.c_str());
+		return NULL;
+	}
+
+	texture->retain();
+	s_compressedTextures[key] = texture;
+
+	return texture;
+}
+
+void CompressedTexture::removeTextureForFile(const std::string& file)
+{
+	auto found = s_compressedTextures.find(file);
+
+	if (found == s_compressedTextures.end())
+		return;
+
+	found->second->release();
+	s_compressedTextures.erase(found);
+}
+
+void CompressedTexture::purgeCache()
+{
+	for (auto iter = s_compressedTextures.begin(); iter != s_compressedTextures.end(); iter++)
+		iter->second->release();
+
+	s_compressedTextures.clear();
+}
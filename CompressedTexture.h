@@ -0,0 +1,58 @@
+#ifndef __COMPRESSED_TEXTURE_H__
+#define __COMPRESSED_TEXTURE_H__
+#include "cocos2d.h"
+#include <string>
+#include <vector>
+#include "KTXParser.h"
+#include "RestoreManager.h"
+
+using namespace std;
+using namespace cocos2d;
+
+namespace cocos3d
+{
+	// A texture uploaded from a KTX container as it is, mip levels included, in the
+	// compressed format the gpu reads. ETC1 is decoded on the cpu when the gpu can't
+	// read it, any other format the gpu can't read fails.
+	class CompressedTexture : public CCTexture2D, public RestoreListener
+	{
+	public:
+		CompressedTexture();
+		virtual ~CompressedTexture();
+
+		static CompressedTexture* createWithFile(const std::string& file);
+		static CompressedTexture* createWithKTXData(const unsigned char* data, unsigned long size);
+
+		bool initWithFile(const std::string& file);
+		bool initWithKTXData(const unsigned char* data, unsigned long size);
+
+		static bool isCompressedFile(const std::string& file);
+		static bool supportsFormat(GLenum internalFormat);
+
+		// For "name.ktx" the first of name.astc.ktx, name.etc2.ktx, name.pvrtc.ktx,
+		// name.dxt.ktx and name.etc1.ktx the gpu reads, then name.ktx, then name.png
+		// through CCTextureCache. Cached by file, like CCTextureCache::addImage.
+		static CCTexture2D* textureForFile(const std::string& file);
+		static CCTexture2D* textureForData(const std::string& key, const unsigned char* data, unsigned long size);
+
+		// the cached texture goes once nothing else holds it
+		static void removeTextureForFile(const std::string& file);
+		static void purgeCache();
+
+		virtual void restoreGLState();
+
+		// every level as it was uploaded, compressed or decoded
+		unsigned int getUploadedBytes(){ return m_uploadedBytes; }
+
+	private:
+		bool upload(const KTXImage& image);
+
+		unsigned int m_uploadedBytes;
+
+		std::string m_path;
+
+		// the container, when it came from memory there is nowhere to read it again from
+		std::vector<unsigned char> m_data;
+	};
+}
+#endif
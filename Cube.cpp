@@ -1,17 +1,156 @@
 #include "Cube.h"
+#include "VBOCache.h"
+#include "RestoreManager.h"
 
 using namespace cocos3d;
 
+#define CUBE_MESH_ID "cube_unit"
+#define CUBE_HALF_SIZE 40
+
+Cube::Cube()
+: m_texture(NULL)
+, m_vertexVBO(0)
+, m_texelVBO(0)
+, m_ibo(0)
+, m_locationsProgram(NULL)
+, m_mvpLocation(-1)
+{
+}
+
+Cube::~Cube()
+{
+	CC_SAFE_RELEASE(m_texture);
+
+#if CC_ENABLE_CACHE_TEXTURE_DATA
+	RestoreManager::sharedRestoreManager()->removeNode(this);
+#endif
+}
+
+Cube* Cube::createWithTexture(CCTexture2D* texture)
+{
+	Cube *pRet = new Cube();
+	if (pRet && pRet->initWithTexture(texture))
+	{
+		pRet->autorelease();
+	}
+	else
+	{
+		delete pRet;
+		pRet = NULL;
+	}
+	return pRet;
+}
+
+Cube* Cube::createWithFile(const std::string& path)
+{
+	return createWithTexture(CCTextureCache::sharedTextureCache()->addImage(path.c_str()));
+}
+
 bool Cube::init()
 {
-	m_texture = CCTextureCache::sharedTextureCache()->addImage("HelloWorld.png");
+	return initWithTexture(CCTextureCache::sharedTextureCache()->addImage(CUBE_DEFAULT_TEXTURE));
+}
+
+bool Cube::initWithTexture(CCTexture2D* texture)
+{
+	setTexture(texture);
+	generateBuffers();
+
+#if CC_ENABLE_CACHE_TEXTURE_DATA
+	RestoreManager::sharedRestoreManager()->addNode(this);
+#endif
 
 	return Node3D::init();
 }
 
+void Cube::setTexture(CCTexture2D* texture)
+{
+	CC_SAFE_RETAIN(texture);
+	CC_SAFE_RELEASE(m_texture);
+
+	m_texture = texture;
+}
+
+void Cube::generateBuffers()
+{
+	VBOCache* cache = VBOCache::sharedVBOCache();
+
+	GLuint normalVBO = 0;
+
+	if (!cache->getVBO(CUBE_MESH_ID, &m_vertexVBO, &normalVBO, &m_texelVBO))
+	{
+		//front, right, back, left, top, bottom, each face as the strip it used to be drawn with
+		static const float positions[6][4][3] = {
+			{ { -1, -1,  1 }, { -1,  1,  1 }, {  1, -1,  1 }, {  1,  1,  1 } },
+			{ {  1, -1,  1 }, {  1,  1,  1 }, {  1, -1, -1 }, {  1,  1, -1 } },
+			{ {  1, -1, -1 }, {  1,  1, -1 }, { -1, -1, -1 }, { -1,  1, -1 } },
+			{ { -1, -1,  1 }, { -1,  1,  1 }, { -1, -1, -1 }, { -1,  1, -1 } },
+			{ {  1,  1,  1 }, { -1,  1,  1 }, {  1,  1, -1 }, { -1,  1, -1 } },
+			{ {  1, -1,  1 }, { -1, -1,  1 }, {  1, -1, -1 }, { -1, -1, -1 } }
+		};
+
+		static const float normals[6][3] = {
+			{ 0, 0, 1 }, { 1, 0, 0 }, { 0, 0, -1 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }
+		};
+
+		static const float sideTexels[4][2] = { { 0, 1 }, { 0, 0 }, { 1, 1 }, { 1, 0 } };
+		static const float capTexels[4][2] = { { 0, 0 }, { 1, 0 }, { 0, 1 }, { 1, 1 } };
+
+		std::vector<Vec3> vertices, faceNormals;
+		std::vector<Vec2> texels;
+
+		for (int face = 0; face < 6; face++)
+		{
+			const float (*uv)[2] = (face < 4) ? sideTexels : capTexels;
+
+			for (int i = 0; i < 4; i++)
+			{
+				vertices.push_back(Vec3(positions[face][i][0], positions[face][i][1], positions[face][i][2]));
+				faceNormals.push_back(Vec3(normals[face][0], normals[face][1], normals[face][2]));
+				texels.push_back(Vec2(uv[i][0], uv[i][1]));
+			}
+		}
+
+		cache->addDataToVBOs(CUBE_MESH_ID, vertices, faceNormals, texels);
+	}
+
+	std::vector<GLushort> indices;
+
+	//the two triangles of each face's strip, same winding
+	for (GLushort face = 0; face < 6; face++)
+	{
+		GLushort first = face * 4;
+		GLushort quad[6] = { first, (GLushort)(first + 1), (GLushort)(first + 2),
+							 (GLushort)(first + 2), (GLushort)(first + 1), (GLushort)(first + 3) };
+
+		indices.insert(indices.end(), quad, quad + 6);
+	}
+
+	m_ibo = cache->getIndexBuffer(CUBE_MESH_ID, indices);
+}
+
+void Cube::restoreGLState()
+{
+	generateBuffers();
+
+	m_locationsProgram = NULL;
+}
+
 void Cube::draw3D()
 {
-	CCSize size = CCDirector::sharedDirector()->getWinSize();
+	CCGLProgram* program = getShaderProgram();
+
+	if (program == NULL || m_ibo == 0)
+		return;
+
+	//the program can be changed at any time, the location is resolved once for each
+	if (program != m_locationsProgram)
+	{
+		m_mvpLocation = program->getUniformLocationForName("CC_MVPMatrix");
+		m_locationsProgram = program;
+	}
+
+	program->use();
 
 	float posX = m_position.x + this->m_pParent->getPositionX();
 	float posY = m_position.y + this->m_pParent->getPositionY();
@@ -19,120 +158,52 @@ void Cube::draw3D()
 	kmMat4 matrixP;
 	kmMat4 matrixMV;
 	kmMat4 matrixMVP;
-	
+
 	kmMat3 rotation;
 	kmVec3 translation;
 	kmMat4 rotationAndMove;
+	kmMat4 scale;
 
 	kmQuaternion quat;
-		
-	GLuint matrixId = glGetUniformLocation(getShaderProgram()->getProgram(), "CC_MVPMatrix");
-	
+
 	kmGLGetMatrix(KM_GL_PROJECTION, &matrixP );
 	kmGLGetMatrix(KM_GL_MODELVIEW, &matrixMV );
 
 	kmQuaternionRotationYawPitchRoll(&quat, m_yaw, m_pitch, m_roll);
 	kmMat3RotationQuaternion(&rotation, &quat);
 
-	kmVec3Fill(&translation, posX, posY, m_fullPosition.z);// this->m_obPosition.x, this->m_obPosition.y, 400);
+	kmVec3Fill(&translation, posX, posY, m_fullPosition.z);
 
 	kmMat4RotationTranslation(&rotationAndMove, &rotation, &translation);
 
+	//the shared mesh is a unit cube
+	float len = CUBE_HALF_SIZE * m_fScaleX;
+	kmMat4Scaling(&scale, len, len, len);
+
 	kmMat4Multiply(&matrixMVP, &matrixP, &matrixMV);
 	kmMat4Multiply(&matrixMVP, &matrixMVP, &rotationAndMove);				// apply rotation and translation to the matrix
+	kmMat4Multiply(&matrixMVP, &matrixMVP, &scale);
+
+	program->setUniformLocationWithMatrix4fv(m_mvpLocation, matrixMVP.mat, 1);
+
+	// texture for the box
+	ccGLBindTexture2D(m_texture != NULL ? m_texture->getName() : 0);
+
+	ccGLEnableVertexAttribs(kCCVertexAttribFlag_Position | kCCVertexAttribFlag_TexCoords);
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_vertexVBO);
+	glVertexAttribPointer(kCCVertexAttrib_Position, 3, GL_FLOAT, GL_FALSE, 0, 0);
 
-	getShaderProgram()->setUniformLocationWithMatrix4fv(matrixId, matrixMVP.mat, 1);
-
-	// texture for the box	
-	ccGLBindTexture2D( m_texture->getName() );
-
-	//draw the box
-	ccVertex3F vertices[4];
-	ccVertex2F uv[4];
-
-	glVertexAttribPointer(kCCVertexAttrib_Position, 3, GL_FLOAT, GL_FALSE, 0, vertices);
-	glVertexAttribPointer(kCCVertexAttrib_TexCoords, 2, GL_FLOAT, GL_FALSE, 0, uv);
-
-	float x = 0;
-	float y = 0;
-	float len = 40*m_fScaleX;
-
-	/////////// front
-	vertices[0] = vertex3(x-len,y-len,len);
-	vertices[1] = vertex3(x-len,y+len,len);
-	vertices[2] = vertex3(x+len,y-len,len);
-	vertices[3] = vertex3(x+len,y+len,len);
-
-	uv[0] = vertex2(0, 1);
-	uv[1] = vertex2(0, 0);
-	uv[2] = vertex2(1, 1);
-	uv[3] = vertex2(1, 0);
-
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-
-	////////// right
-	vertices[0] = vertex3(x+len,y-len,len);
-	vertices[1] = vertex3(x+len,y+len,len);
-	vertices[2] = vertex3(x+len,y-len,-len);
-	vertices[3] = vertex3(x+len,y+len,-len);
-
-	uv[0] = vertex2(0, 1);
-	uv[1] = vertex2(0, 0);
-	uv[2] = vertex2(1, 1);
-	uv[3] = vertex2(1, 0);
-
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-
-	///////// back
-	vertices[0] = vertex3(x+len,y-len,-len);
-	vertices[1] = vertex3(x+len,y+len,-len);
-	vertices[2] = vertex3(x-len,y-len,-len);
-	vertices[3] = vertex3(x-len,y+len,-len);
-
-	uv[0] = vertex2(0, 1);
-	uv[1] = vertex2(0, 0);
-	uv[2] = vertex2(1, 1);
-	uv[3] = vertex2(1, 0);
-
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-
-	////////// left
-	vertices[0] = vertex3(x-len,y-len,len);
-	vertices[1] = vertex3(x-len,y+len,len);
-	vertices[2] = vertex3(x-len,y-len,-len);
-	vertices[3] = vertex3(x-len,y+len,-len);
-
-	uv[0] = vertex2(0, 1);
-	uv[1] = vertex2(0, 0);
-	uv[2] = vertex2(1, 1);
-	uv[3] = vertex2(1, 0);
-
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-	
-
-	///////// top
-	vertices[0] = vertex3(x+len,y+len,len);
-	vertices[1] = vertex3(x-len,y+len,len);
-	vertices[2] = vertex3(x+len,y+len,-len);
-	vertices[3] = vertex3(x-len,y+len,-len);
-
-	uv[0] = vertex2(0, 0);
-	uv[1] = vertex2(1, 0);
-	uv[2] = vertex2(0, 1);
-	uv[3] = vertex2(1, 1);
-
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-
-	///////// bottom
-	vertices[0] = vertex3(x+len,y-len,len);
-	vertices[1] = vertex3(x-len,y-len,len);
-	vertices[2] = vertex3(x+len,y-len,-len);
-	vertices[3] = vertex3(x-len,y-len,-len);
-
-	uv[0] = vertex2(0, 0);
-	uv[1] = vertex2(1, 0);
-	uv[2] = vertex2(0, 1);
-	uv[3] = vertex2(1, 1);
-
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-}
\ No newline at end of file
+	glBindBuffer(GL_ARRAY_BUFFER, m_texelVBO);
+	glVertexAttribPointer(kCCVertexAttrib_TexCoords, 2, GL_FLOAT, GL_FALSE, 0, 0);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
+	glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_SHORT, 0);
+
+	CC_INCREMENT_GL_DRAWS(1);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	CHECK_GL_ERROR_DEBUG();
+}
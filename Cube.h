@@ -4,16 +4,42 @@
 
 namespace cocos3d
 {
+	// texture used by Cube::create()
+	#ifndef CUBE_DEFAULT_TEXTURE
+	#define CUBE_DEFAULT_TEXTURE "HelloWorld.png"
+	#endif
+
 	class Cube : public Node3D
 	{
 	public:
+		virtual ~Cube();
+
 		CREATE_FUNC(Cube);
+		static Cube* createWithTexture(CCTexture2D* texture);
+		static Cube* createWithFile(const std::string& path);
 
 		virtual bool init();
+		virtual bool initWithTexture(CCTexture2D* texture);
+
+		void setTexture(CCTexture2D* texture);
+		CCTexture2D* getTexture(){ return m_texture; }
+
 		void draw3D();
+		virtual void restoreGLState();
+
+	protected:
+		Cube();
+
+		void generateBuffers();
 
 	private:
 		CCTexture2D* m_texture;
+
+		// every cube shares one unit mesh, scaled when drawn
+		GLuint m_vertexVBO, m_texelVBO, m_ibo;
+
+		CCGLProgram* m_locationsProgram;
+		GLint m_mvpLocation;
 	};
 }
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,178 @@
+#include "DebugDraw.h"
+#include <math.h>
+
+using namespace cocos3d;
+
+DebugDraw::DebugDraw()
+: m_vbo(0)
+, m_vboSize(0)
+{
+#if CC_ENABLE_CACHE_TEXTURE_DATA
+	RestoreManager::sharedRestoreManager()->addListener(this);
+#endif
+}
+
+DebugDraw::~DebugDraw()
+{
+#if CC_ENABLE_CACHE_TEXTURE_DATA
+	RestoreManager::sharedRestoreManager()->removeListener(this);
+#endif
+
+	if (m_vbo != 0)
+		glDeleteBuffers(1, &m_vbo);
+}
+
+DebugDraw* DebugDraw::create()
+{
+	DebugDraw* pRet = new DebugDraw();
+	pRet->autorelease();
+
+	return pRet;
+}
+
+void DebugDraw::restoreGLState()
+{
+	//the buffer went away with the context
+	m_vbo = 0;
+	m_vboSize = 0;
+}
+
+void DebugDraw::addLine(const Vec3& from, const Vec3& to, const ccColor4B& color)
+{
+	Vertex a = { from, color };
+	Vertex b = { to, color };
+
+	m_vertices.push_back(a);
+	m_vertices.push_back(b);
+}
+
+void DebugDraw::addBox(const kmAABB& box, const kmMat4& transform, const ccColor4B& color)
+{
+	Vec3 corners[8];
+
+	for (int i = 0; i < 8; i++)
+	{
+		kmVec3 corner;
+		corner.x = (i & 1) ? box.max.x : box.min.x;
+		corner.y = (i & 2) ? box.max.y : box.min.y;
+		corner.z = (i & 4) ? box.max.z : box.min.z;
+
+		kmVec3TransformCoord(&corner, &corner, &transform);
+
+		corners[i] = Vec3(corner.x, corner.y, corner.z);
+	}
+
+	//corners differing by one bit share an edge
+	static const int edges[24] = {
+		0, 1, 2, 3, 4, 5, 6, 7,
+		0, 2, 1, 3, 4, 6, 5, 7,
+		0, 4, 1, 5, 2, 6, 3, 7
+	};
+
+	for (int i = 0; i < 24; i += 2)
+		addLine(corners[edges[i]], corners[edges[i + 1]], color);
+}
+
+void DebugDraw::addBox(const kmAABB& box, const ccColor4B& color)
+{
+	kmMat4 identity;
+	kmMat4Identity(&identity);
+
+	addBox(box, identity, color);
+}
+
+void DebugDraw::addSphere(const Vec3& center, float radius, const ccColor4B& color, unsigned int segments)
+{
+	segments = MAX(segments, 3u);
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		Vec3 previous;
+
+		for (unsigned int i = 0; i <= segments; i++)
+		{
+			float angle = 2.0f * (float)M_PI * i / segments;
+			float c = cosf(angle) * radius;
+			float s = sinf(angle) * radius;
+
+			Vec3 point = center;
+
+			if (axis == 0)
+			{
+				point.y += c;
+				point.z += s;
+			}
+			else
+			if (axis == 1)
+			{
+				point.x += c;
+				point.z += s;
+			}
+			else
+			{
+				point.x += c;
+				point.y += s;
+			}
+
+			if (i > 0)
+				addLine(previous, point, color);
+
+			previous = point;
+		}
+	}
+}
+
+void DebugDraw::addFrustum(const kmMat4& viewProjection, const ccColor4B& color)
+{
+	kmMat4 inverse;
+	kmMat4Inverse(&inverse, &viewProjection);
+
+	//the clip space cube back in world space is the frustum
+	kmAABB clip;
+	clip.min.x = clip.min.y = clip.min.z = -1;
+	clip.max.x = clip.max.y = clip.max.z = 1;
+
+	addBox(clip, inverse, color);
+}
+
+void DebugDraw::flush(const kmMat4& viewProjection)
+{
+	if (m_vertices.empty())
+		return;
+
+	CCGLProgram* program = CCShaderCache::sharedShaderCache()->programForKey(kCCShader_PositionColor);
+	program->use();
+
+	//the program may have been reloaded since the last frame
+	GLint loc = program->getUniformLocationForName("CC_MVPMatrix");
+	program->setUniformLocationWithMatrix4fv(loc, (GLfloat*)viewProjection.mat, 1);
+
+	if (m_vbo == 0)
+		glGenBuffers(1, &m_vbo);
+
+	size_t size = m_vertices.size() * sizeof(Vertex);
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+
+	//a new store each frame, so the driver doesn't wait on the last frame's lines
+	if (size > m_vboSize)
+		m_vboSize = MAX(size, m_vboSize * 2);
+
+	glBufferData(GL_ARRAY_BUFFER, m_vboSize, NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, size, &(m_vertices[0]));
+
+	ccGLEnableVertexAttribs(kCCVertexAttribFlag_Position | kCCVertexAttribFlag_Color);
+
+	glVertexAttribPointer(kCCVertexAttrib_Position, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const GLvoid*)offsetof(Vertex, position));
+	glVertexAttribPointer(kCCVertexAttrib_Color, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (const GLvoid*)offsetof(Vertex, color));
+
+	glDrawArrays(GL_LINES, 0, (GLsizei)m_vertices.size());
+
+	CC_INCREMENT_GL_DRAWS(1);
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	CHECK_GL_ERROR_DEBUG();
+
+	m_vertices.clear();
+}
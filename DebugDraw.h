@@ -0,0 +1,55 @@
+#ifndef __DEBUG_DRAW_H__
+#define __DEBUG_DRAW_H__
+#include "cocos2d.h"
+#include <vector>
+#include "Node3D.h"
+#include "RestoreManager.h"
+
+using namespace std;
+using namespace cocos2d;
+
+namespace cocos3d
+{
+	// Collects the debug lines of every node during a frame, in world space, and
+	// draws them all at once when the layer is done visiting its children.
+	class DebugDraw : public CCObject, public RestoreListener
+	{
+	public:
+		DebugDraw();
+		~DebugDraw();
+
+		static DebugDraw* create();
+
+		void addLine(const Vec3& from, const Vec3& to, const ccColor4B& color);
+
+		// box in the space of the transform, a model's aabb with its model matrix
+		void addBox(const kmAABB& box, const kmMat4& transform, const ccColor4B& color);
+		void addBox(const kmAABB& box, const ccColor4B& color);
+
+		// three circles, one around each axis
+		void addSphere(const Vec3& center, float radius, const ccColor4B& color, unsigned int segments = 16);
+
+		// the volume seen through a projection * view matrix
+		void addFrustum(const kmMat4& viewProjection, const ccColor4B& color);
+
+		// one draw for everything added since the last flush
+		void flush(const kmMat4& viewProjection);
+
+		unsigned int getLineCount(){ return (unsigned int)m_vertices.size() / 2; }
+
+		virtual void restoreGLState();
+
+	private:
+		struct Vertex
+		{
+			Vec3 position;
+			ccColor4B color;
+		};
+
+		std::vector<Vertex> m_vertices;
+
+		GLuint m_vbo;
+		size_t m_vboSize;
+	};
+}
+#endif
@@ -0,0 +1,115 @@
+#include "FrameAtlas.h"
+#include "AtlasPacker.h"
+#include <math.h>
+
+using namespace cocos3d;
+
+FrameAtlas::FrameAtlas()
+: m_texture(NULL)
+{
+}
+
+FrameAtlas::~FrameAtlas()
+{
+	CC_SAFE_RELEASE(m_texture);
+}
+
+FrameAtlas* FrameAtlas::createWithFiles(const std::vector<std::string>& files, unsigned int gutter)
+{
+	FrameAtlas *pRet = new FrameAtlas();
+	if (pRet && pRet->initWithFiles(files, gutter))
+	{
+		pRet->autorelease();
+	}
+	else
+	{
+		delete pRet;
+		pRet = NULL;
+	}
+	return pRet;
+}
+
+bool FrameAtlas::initWithFiles(const std::vector<std::string>& files, unsigned int gutter)
+{
+	if (files.empty())
+		return false;
+
+	std::vector<CCImage*> images;
+	unsigned int cellWidth = 0, cellHeight = 0;
+	std::string key = "frame_atlas";
+
+	for (auto iter = files.begin(); iter != files.end(); iter++)
+	{
+		CCImage* image = new CCImage();
+
+		if (!image->initWithImageFile(iter->c_str()))
+		{
+			CCLOG("cocos3d: FrameAtlas can't load %s", iter->c_str());
+
+			image->release();
+			continue;
+		}
+
+		cellWidth = MAX(cellWidth, (unsigned int)image->getWidth());
+		cellHeight = MAX(cellHeight, (unsigned int)image->getHeight());
+
+		images.push_back(image);
+		key += ":" + *iter;
+	}
+
+	if (images.empty())
+		return false;
+
+	cellWidth += gutter * 2;
+	cellHeight += gutter * 2;
+
+	unsigned int columns = (unsigned int)ceilf(sqrtf((float)images.size()));
+	unsigned int rows = ((unsigned int)images.size() + columns - 1) / columns;
+
+	//power of two, gles2 can only mipmap those
+	unsigned int width = ccNextPOT(columns * cellWidth);
+	unsigned int height = ccNextPOT(rows * cellHeight);
+
+	std::vector<unsigned char> pixels(width * height * 4, 0);
+
+	for (unsigned int i = 0; i < images.size(); i++)
+	{
+		CCImage* image = images[i];
+
+		int frameWidth = image->getWidth();
+		int frameHeight = image->getHeight();
+
+		unsigned int x0 = (i % columns) * cellWidth + gutter;
+		unsigned int y0 = (i / columns) * cellHeight + gutter;
+
+		blitWithGutter(image, &pixels[0], width, x0, y0, gutter);
+
+		Frame frame;
+		frame.scaleU = frameWidth / (float)width;
+		frame.scaleV = frameHeight / (float)height;
+		frame.offsetU = x0 / (float)width;
+		frame.offsetV = y0 / (float)height;
+
+		m_frames.push_back(frame);
+
+		image->release();
+	}
+
+	//through the texture cache, so the atlas is shared by key and restored with the context
+	CCImage* atlas = new CCImage();
+
+	if (atlas->initWithImageData(&pixels[0], (int)pixels.size(), CCImage::kFmtRawData, width, height, 8))
+	{
+		m_texture = CCTextureCache::sharedTextureCache()->addUIImage(atlas, key.c_str());
+		CC_SAFE_RETAIN(m_texture);
+	}
+
+	atlas->release();
+
+	if (m_texture == NULL)
+		return false;
+
+	m_texture->setAntiAliasTexParameters();
+
+	return true;
+}
@@ -0,0 +1,43 @@
+#ifndef __FRAME_ATLAS_H__
+#define __FRAME_ATLAS_H__
+#include "cocos2d.h"
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace cocos2d;
+
+namespace cocos3d
+{
+	// pixels repeated around every frame, so filtering never reads the neighbour frame
+	#define FRAME_ATLAS_GUTTER 2
+
+	// The frames of a texture animation packed in a grid of one texture at load time.
+	// Models pick a frame with a texcoord scale and offset instead of binding another
+	// texture, so all the models animated with the same atlas share one bind.
+	class FrameAtlas : public CCObject
+	{
+	public:
+		struct Frame
+		{
+			// texcoord * scale + offset gives the texcoord inside the atlas
+			float scaleU, scaleV;
+			float offsetU, offsetV;
+		};
+
+		FrameAtlas();
+		~FrameAtlas();
+
+		static FrameAtlas* createWithFiles(const std::vector<std::string>& files, unsigned int gutter = FRAME_ATLAS_GUTTER);
+		bool initWithFiles(const std::vector<std::string>& files, unsigned int gutter);
+
+		CCTexture2D* getTexture(){ return m_texture; }
+		unsigned int getFrameCount(){ return (unsigned int)m_frames.size(); }
+		const Frame& getFrame(unsigned int index){ return m_frames[index]; }
+
+	private:
+		CCTexture2D* m_texture;
+		std::vector<Frame> m_frames;
+	};
+}
+#endif
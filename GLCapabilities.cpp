@@ -0,0 +1,166 @@
+#include "GLCapabilities.h"
+#include "KTXParser.h"
+#include <sstream>
+#include <vector>
+
+using namespace cocos3d;
+
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+static std::string glString(GLenum name)
+{
+	const char* value = (const char*)glGetString(name);
+
+	return (value != NULL) ? value : "";
+}
+
+// some drivers leave an error behind when an optional query isn't known to them, a
+// few reads are enough for that, a lost context may never stop returning one
+static void discardQueryErrors()
+{
+	for (int i = 0; i < 4 && glGetError() != GL_NO_ERROR; i++);
+}
+
+GLCapabilities::GLCapabilities()
+: m_queried(false)
+, m_gles3(false)
+, m_maxTextureSize(0)
+, m_maxTextureUnits(0)
+, m_maxVertexAttribs(0)
+, m_maxAnisotropy(0)
+, m_vertexArrayObjects(false)
+, m_instancing(false)
+, m_programBinaryFormats(0)
+{
+}
+
+GLCapabilities::~GLCapabilities()
+{
+}
+
+GLCapabilities* GLCapabilities::sharedGLCapabilities()
+{
+	static GLCapabilities* capabilities = nullptr;
+
+	if (capabilities == nullptr)
+	{
+		capabilities = new GLCapabilities();
+		capabilities->autorelease();
+		capabilities->retain();
+	}
+
+	return capabilities;
+}
+
+void GLCapabilities::query()
+{
+	if (m_queried)
+		return;
+
+	m_queried = true;
+
+	m_vendor = glString(GL_VENDOR);
+	m_renderer = glString(GL_RENDERER);
+	m_version = glString(GL_VERSION);
+	m_gles3 = (m_version.find("OpenGL ES 3") != std::string::npos);
+
+	m_extensions.clear();
+
+	std::istringstream extensions(glString(GL_EXTENSIONS));
+	std::string extension;
+
+	while (extensions >> extension)
+		m_extensions.insert(extension);
+
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &m_maxTextureSize);
+	glGetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS, &m_maxTextureUnits);
+	glGetIntegerv(GL_MAX_VERTEX_ATTRIBS, &m_maxVertexAttribs);
+
+	m_maxAnisotropy = 0;
+
+	if (hasExtension("GL_EXT_texture_filter_anisotropic"))
+	{
+		glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &m_maxAnisotropy);
+		discardQueryErrors();
+	}
+
+	m_vertexArrayObjects = m_gles3 ||
+						   hasExtension("GL_OES_vertex_array_object") ||
+						   hasExtension("GL_ARB_vertex_array_object") ||
+						   hasExtension("GL_APPLE_vertex_array_object");
+
+	m_instancing = m_gles3 ||
+				   hasExtension("GL_EXT_instanced_arrays") ||
+				   hasExtension("GL_ANGLE_instanced_arrays") ||
+				   hasExtension("GL_ARB_instanced_arrays") ||
+				   hasExtension("GL_NV_instanced_arrays");
+
+	m_programBinaryFormats = 0;
+
+	if (m_gles3 || hasExtension("GL_OES_get_program_binary") || hasExtension("GL_ARB_get_program_binary"))
+	{
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &m_programBinaryFormats);
+		discardQueryErrors();
+	}
+
+	m_compressedFormats.clear();
+
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_COMPRESSED_TEXTURE_FORMATS, &count);
+
+	if (count > 0)
+	{
+		std::vector<GLint> formats(count);
+		glGetIntegerv(GL_COMPRESSED_TEXTURE_FORMATS, &formats[0]);
+
+		m_compressedFormats.insert(formats.begin(), formats.end());
+	}
+
+	CCLOG("cocos3d: %s, %s, %u extensions, max anisotropy %g, vao %d, instancing %d, %d program binary formats",
+		m_renderer.c_str(), m_version.c_str(), (unsigned int)m_extensions.size(),
+		m_maxAnisotropy, m_vertexArrayObjects, m_instancing, m_programBinaryFormats);
+}
+
+bool GLCapabilities::hasExtension(const std::string& name)
+{
+	query();
+
+	return m_extensions.find(name) != m_extensions.end();
+}
+
+bool GLCapabilities::supportsCompressedFormat(GLenum format)
+{
+	query();
+
+	if (m_compressedFormats.find(format) != m_compressedFormats.end())
+		return true;
+
+	//not every driver lists what its extensions enable
+	switch (format)
+	{
+	case GL_ETC1_RGB8_OES:
+		return hasExtension("GL_OES_compressed_ETC1_RGB8_texture");
+
+	case GL_COMPRESSED_RGB8_ETC2:
+	case GL_COMPRESSED_RGBA8_ETC2_EAC:
+		return m_gles3 || hasExtension("GL_ARB_ES3_compatibility");
+
+	case GL_COMPRESSED_RGB_PVRTC_4BPPV1_IMG:
+	case GL_COMPRESSED_RGB_PVRTC_2BPPV1_IMG:
+	case GL_COMPRESSED_RGBA_PVRTC_4BPPV1_IMG:
+	case GL_COMPRESSED_RGBA_PVRTC_2BPPV1_IMG:
+		return hasExtension("GL_IMG_texture_compression_pvrtc");
+
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+		return hasExtension("GL_EXT_texture_compression_s3tc");
+
+	default:
+		if (format >= GL_COMPRESSED_RGBA_ASTC_4x4_KHR && format <= GL_COMPRESSED_RGBA_ASTC_12x12_KHR)
+			return hasExtension("GL_KHR_texture_compression_astc_ldr");
+
+		return false;
+	}
+}
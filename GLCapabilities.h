@@ -0,0 +1,70 @@
+#ifndef __GL_CAPABILITIES_H__
+#define __GL_CAPABILITIES_H__
+#include "cocos2d.h"
+#include <string>
+#include <set>
+#include <unordered_set>
+
+using namespace std;
+using namespace cocos2d;
+
+namespace cocos3d
+{
+	// What the context can do, queried once on first use and again after the context
+	// is lost, so nothing else has to call glGetString or glGet* for it.
+	class GLCapabilities : public CCObject
+	{
+	public:
+		GLCapabilities();
+		~GLCapabilities();
+
+		static GLCapabilities* sharedGLCapabilities();
+
+		bool hasExtension(const std::string& name);
+
+		const std::string& getVendor(){ query(); return m_vendor; }
+		const std::string& getRenderer(){ query(); return m_renderer; }
+		const std::string& getVersion(){ query(); return m_version; }
+		bool isGLES3(){ query(); return m_gles3; }
+
+		GLint getMaxTextureSize(){ query(); return m_maxTextureSize; }
+		GLint getMaxTextureUnits(){ query(); return m_maxTextureUnits; }
+		GLint getMaxVertexAttribs(){ query(); return m_maxVertexAttribs; }
+
+		// 0 without GL_EXT_texture_filter_anisotropic
+		GLfloat getMaxAnisotropy(){ query(); return m_maxAnisotropy; }
+
+		bool supportsVertexArrayObjects(){ query(); return m_vertexArrayObjects; }
+		bool supportsInstancing(){ query(); return m_instancing; }
+
+		// formats glGetProgramBinary can write, 0 when there are none
+		GLint getProgramBinaryFormatCount(){ query(); return m_programBinaryFormats; }
+
+		// listed by GL_COMPRESSED_TEXTURE_FORMATS or enabled by a known extension
+		bool supportsCompressedFormat(GLenum format);
+
+		// next call queries the context again, RestoreManager does it on a new context
+		void invalidate(){ m_queried = false; }
+
+	private:
+		void query();
+
+		bool m_queried;
+
+		std::unordered_set<std::string> m_extensions;
+		std::set<GLenum> m_compressedFormats;
+
+		std::string m_vendor, m_renderer, m_version;
+		bool m_gles3;
+
+		GLint m_maxTextureSize;
+		GLint m_maxTextureUnits;
+		GLint m_maxVertexAttribs;
+		GLfloat m_maxAnisotropy;
+
+		bool m_vertexArrayObjects;
+		bool m_instancing;
+		GLint m_programBinaryFormats;
+	};
+}
+#endif
@@ -0,0 +1,266 @@
+#include "Impostor.h"
+#include "Model.h"
+#include "Billboard.h"
+#include "RestoreManager.h"
+#include "shaders.h"
+#include <math.h>
+
+using namespace cocos3d;
+
+static float pitchOfRow(unsigned int row)
+{
+	return -M_PI / 2.0f + (row + 0.5f) * M_PI / IMPOSTOR_PITCH_VIEWS;
+}
+
+static float yawOfColumn(unsigned int column)
+{
+	return column * 2.0f * M_PI / IMPOSTOR_YAW_VIEWS;
+}
+
+Impostor::Impostor()
+: m_texture(NULL)
+, m_fbo(0)
+, m_depth(0)
+, m_viewSize(0)
+, m_captured(false)
+, m_failed(false)
+, m_program(NULL)
+{
+}
+
+Impostor::~Impostor()
+{
+	if (m_fbo != 0)
+		glDeleteFramebuffers(1, &m_fbo);
+
+	if (m_depth != 0)
+		glDeleteRenderbuffers(1, &m_depth);
+
+	CC_SAFE_RELEASE(m_texture);
+}
+
+Impostor* Impostor::create(unsigned int viewSize)
+{
+	Impostor* pRet = new Impostor();
+
+	if (pRet->init(viewSize))
+	{
+		pRet->autorelease();
+	}
+	else
+	{
+		delete pRet;
+		pRet = NULL;
+	}
+
+	return pRet;
+}
+
+bool Impostor::init(unsigned int viewSize)
+{
+	m_viewSize = viewSize;
+
+	unsigned int width = m_viewSize * IMPOSTOR_YAW_VIEWS;
+	unsigned int height = m_viewSize * IMPOSTOR_PITCH_VIEWS;
+
+	m_texture = new CCTexture2D();
+
+	//no pixels, the views are rendered into it
+	if (!m_texture->initWithData(NULL, kCCTexture2DPixelFormat_RGBA8888, width, height, CCSize(width, height)))
+		return false;
+
+	m_program = impostorProgram();
+	initShaderLocations();
+
+	return true;
+}
+
+void Impostor::initShaderLocations()
+{
+	m_mvLocation = m_program->getUniformLocationForName("CC_MVMatrix");
+	m_pLocation = m_program->getUniformLocationForName("CC_PMatrix");
+	m_centerLocation = m_program->getUniformLocationForName("uCenter");
+	m_sizeLocation = m_program->getUniformLocationForName("uSize");
+	m_frameLocation = m_program->getUniformLocationForName("uFrame");
+	m_textureLocation = m_program->getUniformLocationForName("uTexture");
+	m_alphaLocation = m_program->getUniformLocationForName("uAlpha");
+}
+
+void Impostor::restoreGLState()
+{
+	m_program = impostorProgram(RestoreManager::sharedRestoreManager()->claimProgram(IMPOSTOR_SHADER_KEY));
+	initShaderLocations();
+
+	unsigned int width = m_viewSize * IMPOSTOR_YAW_VIEWS;
+	unsigned int height = m_viewSize * IMPOSTOR_PITCH_VIEWS;
+
+	//the texture isn't in the texture cache, nothing else brings its name back
+	m_texture->initWithData(NULL, kCCTexture2DPixelFormat_RGBA8888, width, height, CCSize(width, height));
+
+	//the old names may belong to something else by now, don't delete them
+	m_fbo = m_depth = 0;
+	m_captured = m_failed = false;
+}
+
+bool Impostor::createFramebuffer()
+{
+	glGenRenderbuffers(1, &m_depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16, m_texture->getPixelsWide(), m_texture->getPixelsHigh());
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &m_fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_texture->getName(), 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depth);
+
+	return (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+}
+
+bool Impostor::capture(Model* model, const kmVec3& center, float radius)
+{
+	if (m_failed)
+		return false;
+
+	GLint oldFBO;
+	GLint oldViewport[4];
+	GLfloat oldClearColor[4];
+
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &oldFBO);
+	glGetIntegerv(GL_VIEWPORT, oldViewport);
+	glGetFloatv(GL_COLOR_CLEAR_VALUE, oldClearColor);
+
+	GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+	GLboolean blend = glIsEnabled(GL_BLEND);
+
+	if (m_fbo == 0 && !createFramebuffer())
+	{
+		CCLOG("cocos3d: impostor framebuffer incomplete, the model is drawn as it is");
+		m_failed = true;
+	}
+
+	if (!m_failed)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+		glViewport(0, 0, m_texture->getPixelsWide(), m_texture->getPixelsHigh());
+
+		glClearColor(0, 0, 0, 0);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		//the views replace the clear color, they aren't blended over it
+		glEnable(GL_DEPTH_TEST);
+		glDisable(GL_BLEND);
+
+		//every view sees the whole bounding sphere
+		kmMat4 projection;
+		kmMat4OrthographicProjection(&projection, -radius, radius, -radius, radius, radius * 0.5f, radius * 3.5f);
+
+		const kmMat4& matrixM = model->m_matrixM;
+
+		kmVec3 up = { 0, 1, 0 };
+		kmVec3TransformNormal(&up, &up, &matrixM);
+		kmVec3Normalize(&up, &up);
+
+		for (unsigned int row = 0; row < IMPOSTOR_PITCH_VIEWS; row++)
+		{
+			float pitch = pitchOfRow(row);
+
+			for (unsigned int column = 0; column < IMPOSTOR_YAW_VIEWS; column++)
+			{
+				float yaw = yawOfColumn(column);
+
+				//from the model to the eye, turned along with the model
+				kmVec3 direction = { cosf(pitch) * sinf(yaw), sinf(pitch), cosf(pitch) * cosf(yaw) };
+				kmVec3TransformNormal(&direction, &direction, &matrixM);
+				kmVec3Normalize(&direction, &direction);
+
+				kmVec3 eye;
+				kmVec3Scale(&eye, &direction, radius * 2.0f);
+				kmVec3Add(&eye, &eye, &center);
+
+				kmMat4 view;
+				kmMat4LookAt(&view, &eye, &center, &up);
+
+				glViewport(column * m_viewSize, row * m_viewSize, m_viewSize, m_viewSize);
+
+				model->drawView(view, projection);
+			}
+		}
+
+		m_captured = true;
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, oldFBO);
+	glViewport(oldViewport[0], oldViewport[1], oldViewport[2], oldViewport[3]);
+	glClearColor(oldClearColor[0], oldClearColor[1], oldClearColor[2], oldClearColor[3]);
+
+	if (!depthTest)
+		glDisable(GL_DEPTH_TEST);
+
+	if (blend)
+		glEnable(GL_BLEND);
+
+	CHECK_GL_ERROR_DEBUG();
+
+	return m_captured;
+}
+
+unsigned int Impostor::viewForDirection(const kmVec3& direction)
+{
+	float length = kmVec3Length(&direction);
+
+	if (length == 0)
+		return 0;
+
+	float yaw = atan2f(direction.x, direction.z);
+	float pitch = asinf(MAX(-1.0f, MIN(1.0f, direction.y / length)));
+
+	int column = (int)floorf(yaw / (2.0f * M_PI / IMPOSTOR_YAW_VIEWS) + 0.5f);
+	column = (column % IMPOSTOR_YAW_VIEWS + IMPOSTOR_YAW_VIEWS) % IMPOSTOR_YAW_VIEWS;
+
+	int row = (int)floorf((pitch + M_PI / 2.0f) / (M_PI / IMPOSTOR_PITCH_VIEWS));
+	row = MAX(0, MIN(IMPOSTOR_PITCH_VIEWS - 1, row));
+
+	return row * IMPOSTOR_YAW_VIEWS + column;
+}
+
+void Impostor::draw(const kmMat4& view, const kmMat4& projection, const kmVec3& center, float radius, unsigned int viewIndex, float opacity)
+{
+	GLuint vertices, texels;
+	Billboard::getQuadVBOs(&vertices, &texels);
+
+	unsigned int row = viewIndex / IMPOSTOR_YAW_VIEWS;
+	unsigned int column = viewIndex % IMPOSTOR_YAW_VIEWS;
+
+	//the quad has its texels upside down from what was rendered, the frame flips them
+	float width = 1.0f / IMPOSTOR_YAW_VIEWS;
+	float height = 1.0f / IMPOSTOR_PITCH_VIEWS;
+
+	m_program->use();
+
+	glUniformMatrix4fv(m_mvLocation, 1, GL_FALSE, view.mat);
+	glUniformMatrix4fv(m_pLocation, 1, GL_FALSE, projection.mat);
+	glUniform3f(m_centerLocation, center.x, center.y, center.z);
+	glUniform1f(m_sizeLocation, radius * 2.0f);
+	glUniform4f(m_frameLocation, column * width, (row + 1) * height, width, -height);
+	glUniform1i(m_textureLocation, 0);
+	glUniform1f(m_alphaLocation, opacity);
+
+	ccGLBindTexture2D(m_texture->getName());
+
+	ccGLEnableVertexAttribs(kCCVertexAttribFlag_Position | kCCVertexAttribFlag_TexCoords);
+
+	glBindBuffer(GL_ARRAY_BUFFER, vertices);
+	glVertexAttribPointer(kCCVertexAttrib_Position, 3, GL_FLOAT, GL_FALSE, 0, 0);
+
+	glBindBuffer(GL_ARRAY_BUFFER, texels);
+	glVertexAttribPointer(kCCVertexAttrib_TexCoords, 2, GL_FLOAT, GL_FALSE, 0, 0);
+
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+	CC_INCREMENT_GL_DRAWS(1);
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	CHECK_GL_ERROR_DEBUG();
+}
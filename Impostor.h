@@ -0,0 +1,66 @@
+#ifndef __IMPOSTOR_H__
+#define __IMPOSTOR_H__
+#include "cocos2d.h"
+#include "Node3D.h"
+
+using namespace cocos2d;
+
+namespace cocos3d
+{
+	// views around the model, one column each
+	#define IMPOSTOR_YAW_VIEWS 8
+	// rows of views, from below the model to above it
+	#define IMPOSTOR_PITCH_VIEWS 4
+	// pixels of a view in the atlas
+	#define IMPOSTOR_VIEW_SIZE 64
+
+	class Model;
+
+	// A model rendered once, lit as it is, from a ring of directions for each row of
+	// pitch, into the views of one texture through an offscreen framebuffer. Far away
+	// the model is drawn as the unit quad of the billboards, facing the camera, with
+	// the view closest to where the camera is, and no lighting runs for it.
+	class Impostor : public CCObject
+	{
+	public:
+		Impostor();
+		~Impostor();
+
+		static Impostor* create(unsigned int viewSize = IMPOSTOR_VIEW_SIZE);
+		bool init(unsigned int viewSize);
+
+		// renders every view of the model, its matrices are left as they were for the
+		// last view, false if it can't be rendered offscreen
+		bool capture(Model* model, const kmVec3& center, float radius);
+		bool isCaptured(){ return m_captured; }
+		bool hasFailed(){ return m_failed; }
+
+		// the view closest to a direction from the model to the camera, in model space
+		unsigned int viewForDirection(const kmVec3& direction);
+
+		// the quad facing the camera, center and radius as they were captured
+		void draw(const kmMat4& view, const kmMat4& projection, const kmVec3& center, float radius, unsigned int viewIndex, float opacity);
+
+		CCTexture2D* getTexture(){ return m_texture; }
+		unsigned int getViewSize(){ return m_viewSize; }
+
+		// the framebuffer went away with the context, the texture is restored empty
+		void restoreGLState();
+
+	private:
+		bool createFramebuffer();
+		void initShaderLocations();
+
+		CCTexture2D* m_texture;
+		GLuint m_fbo, m_depth;
+		unsigned int m_viewSize;
+		bool m_captured, m_failed;
+
+		CCGLProgram* m_program;
+		GLint m_mvLocation, m_pLocation,
+			  m_centerLocation, m_sizeLocation,
+			  m_frameLocation, m_textureLocation,
+			  m_alphaLocation;
+	};
+}
+#endif
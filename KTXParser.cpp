@@ -0,0 +1,188 @@
+#include "KTXParser.h"
+#include <string.h>
+
+using namespace cocos3d;
+
+#define KTX_HEADER_SIZE 64
+#define KTX_ENDIANNESS 0x04030201
+#define KTX_ENDIANNESS_SWAPPED 0x01020304
+
+static const unsigned char ktxIdentifier[12] = {
+	0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A
+};
+
+static unsigned int readUInt(const unsigned char* data, bool swap)
+{
+	unsigned int value;
+	memcpy(&value, data, sizeof(value));
+
+	if (swap)
+		value = (value >> 24) | ((value >> 8) & 0xFF00) | ((value << 8) & 0xFF0000) | (value << 24);
+
+	return value;
+}
+
+bool cocos3d::parseKTX(const unsigned char* data, unsigned long size, KTXImage* image)
+{
+	if (data == NULL || size < KTX_HEADER_SIZE || memcmp(data, ktxIdentifier, sizeof(ktxIdentifier)) != 0)
+		return false;
+
+	unsigned int endianness = readUInt(data + 12, false);
+
+	if (endianness != KTX_ENDIANNESS && endianness != KTX_ENDIANNESS_SWAPPED)
+		return false;
+
+	bool swap = (endianness == KTX_ENDIANNESS_SWAPPED);
+
+	image->type = readUInt(data + 16, swap);
+	image->format = readUInt(data + 24, swap);
+	image->internalFormat = readUInt(data + 28, swap);
+	image->width = readUInt(data + 36, swap);
+	image->height = readUInt(data + 40, swap);
+
+	unsigned int depth = readUInt(data + 44, swap);
+	unsigned int arrayElements = readUInt(data + 48, swap);
+	unsigned int faces = readUInt(data + 52, swap);
+	unsigned int levels = readUInt(data + 56, swap);
+	unsigned int keyValueBytes = readUInt(data + 60, swap);
+
+	if (image->width == 0 || image->height == 0 || depth > 1 || arrayElements > 0 || faces != 1)
+		return false;
+
+	if (levels == 0)
+		levels = 1;
+
+	image->levels.clear();
+
+	//checked before adding, a 32 bit unsigned long would wrap around
+	if (keyValueBytes > size - KTX_HEADER_SIZE)
+		return false;
+
+	unsigned long offset = KTX_HEADER_SIZE + (unsigned long)keyValueBytes;
+
+	for (unsigned int level = 0; level < levels; level++)
+	{
+		if (offset + 4 > size)
+			return false;
+
+		unsigned int levelSize = readUInt(data + offset, swap);
+		offset += 4;
+
+		if (levelSize > size - offset)
+			return false;
+
+		KTXLevel ktxLevel;
+		ktxLevel.data = data + offset;
+		ktxLevel.size = levelSize;
+		ktxLevel.width = MAX(image->width >> level, 1u);
+		ktxLevel.height = MAX(image->height >> level, 1u);
+
+		image->levels.push_back(ktxLevel);
+
+		//every level starts 4 bytes aligned
+		offset += ((unsigned long)levelSize + 3) & ~3ul;
+	}
+
+	return true;
+}
+
+unsigned int cocos3d::etc1LevelSize(unsigned int width, unsigned int height)
+{
+	return ((width + 3) / 4) * ((height + 3) / 4) * 8;
+}
+
+static const int etc1Modifiers[8][2] = {
+	{ 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 }, { 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 }
+};
+
+static inline unsigned char clampColor(int value)
+{
+	return (unsigned char)MIN(MAX(value, 0), 255);
+}
+
+// one 4x4 block, two sub-blocks of 2x4 (or 4x2 when flipped) with a base color and a
+// modifier table each, every pixel adds one of four modifiers of its table to its base
+static void decodeETC1Block(const unsigned char* block, unsigned char colors[16][3])
+{
+	int base[2][3];
+
+	bool differential = (block[3] & 2) != 0;
+	bool flipped = (block[3] & 1) != 0;
+
+	for (int c = 0; c < 3; c++)
+	{
+		if (differential)
+		{
+			int first = block[c] >> 3;
+			int delta = block[c] & 7;
+			int second = first + ((delta & 4) ? delta - 8 : delta);
+
+			base[0][c] = (first << 3) | (first >> 2);
+			base[1][c] = ((second & 31) << 3) | ((second & 31) >> 2);
+		}
+		else
+		{
+			base[0][c] = ((block[c] >> 4) << 4) | (block[c] >> 4);
+			base[1][c] = ((block[c] & 15) << 4) | (block[c] & 15);
+		}
+	}
+
+	int tables[2] = { block[3] >> 5, (block[3] >> 2) & 7 };
+
+	unsigned int msbs = (block[4] << 8) | block[5];
+	unsigned int lsbs = (block[6] << 8) | block[7];
+
+	for (int x = 0; x < 4; x++)
+	{
+		for (int y = 0; y < 4; y++)
+		{
+			//pixels are numbered by columns
+			int i = x * 4 + y;
+			int subBlock = flipped ? (y >= 2) : (x >= 2);
+
+			int index = (((msbs >> i) & 1) << 1) | ((lsbs >> i) & 1);
+			int modifier = etc1Modifiers[tables[subBlock]][index & 1];
+
+			if (index & 2)
+				modifier = -modifier;
+
+			for (int c = 0; c < 3; c++)
+				colors[y * 4 + x][c] = clampColor(base[subBlock][c] + modifier);
+		}
+	}
+}
+
+bool cocos3d::decodeETC1(const unsigned char* data, unsigned int size, unsigned int width, unsigned int height, unsigned char* rgba)
+{
+	if (size < etc1LevelSize(width, height))
+		return false;
+
+	unsigned int blocksWide = (width + 3) / 4;
+	unsigned int blocksHigh = (height + 3) / 4;
+
+	unsigned char colors[16][3];
+
+	for (unsigned int by = 0; by < blocksHigh; by++)
+	{
+		for (unsigned int bx = 0; bx < blocksWide; bx++)
+		{
+			decodeETC1Block(data + (by * blocksWide + bx) * 8, colors);
+
+			//blocks on the right and bottom edges are cut
+			for (unsigned int y = 0; y < 4 && by * 4 + y < height; y++)
+			{
+				for (unsigned int x = 0; x < 4 && bx * 4 + x < width; x++)
+				{
+					unsigned char* pixel = rgba + ((by * 4 + y) * width + bx * 4 + x) * 4;
+
+					pixel[0] = colors[y * 4 + x][0];
+					pixel[1] = colors[y * 4 + x][1];
+					pixel[2] = colors[y * 4 + x][2];
+					pixel[3] = 255;
+				}
+			}
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,61 @@
+#ifndef __KTX_PARSER_H__
+#define __KTX_PARSER_H__
+#include "cocos2d.h"
+#include <vector>
+
+using namespace std;
+using namespace cocos2d;
+
+#ifndef GL_ETC1_RGB8_OES
+#define GL_ETC1_RGB8_OES							0x8D64
+#endif
+#ifndef GL_COMPRESSED_RGB8_ETC2
+#define GL_COMPRESSED_RGB8_ETC2						0x9274
+#define GL_COMPRESSED_RGBA8_ETC2_EAC				0x9278
+#endif
+#ifndef GL_COMPRESSED_RGB_PVRTC_4BPPV1_IMG
+#define GL_COMPRESSED_RGB_PVRTC_4BPPV1_IMG			0x8C00
+#define GL_COMPRESSED_RGB_PVRTC_2BPPV1_IMG			0x8C01
+#define GL_COMPRESSED_RGBA_PVRTC_4BPPV1_IMG			0x8C02
+#define GL_COMPRESSED_RGBA_PVRTC_2BPPV1_IMG			0x8C03
+#endif
+#ifndef GL_COMPRESSED_RGBA_ASTC_4x4_KHR
+#define GL_COMPRESSED_RGBA_ASTC_4x4_KHR				0x93B0
+#define GL_COMPRESSED_RGBA_ASTC_12x12_KHR			0x93BD
+#endif
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT				0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT			0x83F3
+#endif
+
+namespace cocos3d
+{
+	struct KTXLevel
+	{
+		const unsigned char* data;
+		unsigned int size;
+		unsigned int width, height;
+	};
+
+	struct KTXImage
+	{
+		// glType and glFormat are 0 for compressed data
+		GLenum type, format, internalFormat;
+		unsigned int width, height;
+
+		// as many as in the file, one when the file asks for them to be generated
+		std::vector<KTXLevel> levels;
+
+		bool isCompressed() const { return type == 0; }
+	};
+
+	// 2d textures only: no array, no cube map, no depth. The levels point into data.
+	// Neither the parser nor the decoder make gl calls, they run without a context.
+	bool parseKTX(const unsigned char* data, unsigned long size, KTXImage* image);
+
+	unsigned int etc1LevelSize(unsigned int width, unsigned int height);
+
+	// rgba8888, width * height * 4 bytes
+	bool decodeETC1(const unsigned char* data, unsigned int size, unsigned int width, unsigned int height, unsigned char* rgba);
+}
+#endif
@@ -2,15 +2,37 @@
 #include "Node3D.h"
 #include "Light.h"
 #include "Camera.h"
+#include "Scene3D.h"
+#include <algorithm>
 
 using namespace cocos3d;
 
+Layer3D::Layer3D()
+: m_debugDraw(NULL)
+, m_residency(NULL)
+{
+}
+
+Layer3D::~Layer3D()
+{
+	CC_SAFE_RELEASE(m_debugDraw);
+	CC_SAFE_RELEASE(m_residency);
+}
+
 bool Layer3D::init()
 {
 	m_fixedLights = true;
 	m_lightsDirty = false;
+	m_lightGridDirty = true;
+	m_lightsVersion = 0;
 	m_camera = NULL;
 
+	m_debugDraw = DebugDraw::create();
+	m_debugDraw->retain();
+
+	m_residency = ResidencyManager::create();
+	m_residency->retain();
+
 	return true;
 }
 
@@ -19,7 +41,98 @@ void Layer3D::visit()
 	if (m_camera == NULL)
 		add3DCamera(Camera::create());
 
+	updateLightGrid();
+
+	//streamed meshes and textures are accounted with the rest of the scene's
+	Scene3D* scene = dynamic_cast<Scene3D*>(getParent());
+
+	if (scene != NULL)
+		m_residency->setCache(scene->getCache());
+
+	m_residency->update(m_camera, CCDirector::sharedDirector()->getDeltaTime());
+
 	CCLayer::visit();
+
+	if (m_debugDraw->getLineCount() > 0)
+	{
+		kmMat4 viewProjection;
+		kmMat4Multiply(&viewProjection, &(m_camera->getProjectionMatrix()), &(m_camera->getViewMatrix()));
+
+		m_debugDraw->flush(viewProjection);
+	}
+}
+
+void Layer3D::updateLightGrid()
+{
+	//lights clear their dirty flag when drawn, so a dirty light moved since last frame
+	for (auto iter = m_lights.begin();
+		 !m_lightGridDirty && iter != m_lights.end();
+		 iter++)
+	{
+		if ((*iter)->hasMoved())
+			m_lightGridDirty = true;
+	}
+
+	if (!m_lightGridDirty)
+		return;
+
+	m_lightGrid.build(m_lights);
+	m_lightGridDirty = false;
+	m_lightsDirty = true;
+	m_lightsVersion++;
+}
+
+void Layer3D::setLightCellSize(float cellSize)
+{
+	m_lightGrid.setCellSize(cellSize);
+	m_lightGridDirty = true;
+}
+
+void Layer3D::getLightsForNode(Node3D* node, unsigned int maxLights, std::vector<Light*>& lights)
+{
+	lights.clear();
+
+	if (m_lights.size() == 0)
+		return;
+
+	if (m_lightGridDirty)
+		updateLightGrid();
+
+	const Vec3& center = node->get3DPosition();
+	float radius = node->getRadius();
+
+	m_lightGrid.query(center, radius, m_lightCandidates);
+
+	//kept between calls, every model asks for its lights
+	std::vector<LightScore>& scores = m_lightScores;
+	scores.clear();
+
+	for (auto iter = m_lightCandidates.begin(); iter != m_lightCandidates.end(); iter++)
+	{
+		Light* light = *iter;
+		const Vec3& position = light->get3DPosition();
+
+		float dx = position.x - center.x;
+		float dy = position.y - center.y;
+		float dz = position.z - center.z;
+
+		//distance to the node bounding sphere, not to its center
+		float distance = std::max(sqrtf(dx*dx + dy*dy + dz*dz) - radius, 0.0f);
+		float range = light->getRange();
+
+		if (range >= 0 && distance > range)
+			continue;
+
+		LightScore score = { light, light->getInfluence(distance), distance };
+		scores.push_back(score);
+	}
+
+	unsigned int count = std::min((unsigned int)scores.size(), maxLights);
+
+	std::partial_sort(scores.begin(), scores.begin() + count, scores.end());
+
+	for (unsigned int i = 0; i < count; i++)
+		lights.push_back(scores[i].light);
 }
 
 void Layer3D::add3DCamera(Camera* camera)
@@ -40,9 +153,6 @@ Camera* Layer3D::get3DCamera()
 
 void Layer3D::addLight(Light* light)
 {
-	if (m_lights.size() == 4)
-		return;
-
 	for (auto iter = m_lights.begin();
 		 iter != m_lights.end();
 		 iter++)
@@ -54,7 +164,7 @@ void Layer3D::addLight(Light* light)
 	m_lights.push_back(light);
 	addChild(light);
 
-	m_lightsDirty = true;
+	m_lightsDirty = m_lightGridDirty = true;
 }
 
 void Layer3D::removeLight(Light* light)
@@ -67,11 +177,11 @@ void Layer3D::removeLight(Light* light)
 		{
 			m_lights.erase(iter);
 			removeChild(light);
-			return;
+			break;
 		}
 	}
 
-	m_lightsDirty = true;
+	m_lightsDirty = m_lightGridDirty = true;
 }
 
 void Layer3D::removeAllLights()
@@ -84,7 +194,8 @@ void Layer3D::removeAllLights()
 	}
 
 	m_lights.clear();
-	m_lightsDirty = true;
+	m_lightGrid.clear();
+	m_lightsDirty = m_lightGridDirty = true;
 }
 
 void Layer3D::setFixedLights(bool fixedLights)
@@ -107,7 +218,7 @@ void Layer3D::setPosition(const CCPoint& position)
 			light->setPosition(newPosition);
 		}
 
-		m_lightsDirty = true;
+		m_lightsDirty = m_lightGridDirty = true;
 	}
 
 	if (m_camera != NULL)
@@ -2,6 +2,9 @@
 #define __LAYER_3D_H__
 #include "cocos2d.h"
 #include "Node3D.h"
+#include "LightGrid.h"
+#include "DebugDraw.h"
+#include "ResidencyManager.h"
 
 using namespace cocos2d;
 
@@ -16,6 +19,9 @@ namespace cocos3d
 
 		CREATE_FUNC(Layer3D);
 
+		Layer3D();
+		virtual ~Layer3D();
+
 		virtual bool init();
 
 		virtual void visit();
@@ -27,20 +33,52 @@ namespace cocos3d
 		void removeLight(Light* light);
 		void removeAllLights();
 		void setFixedLights(bool fixedLights = true);
+		void setLightCellSize(float cellSize);
+		void getLightsForNode(Node3D* node, unsigned int maxLights, std::vector<Light*>& lights);
 		bool hasLights(){ return (m_lights.size() > 0); }
 		std::vector<Light*>& getLights(){ return m_lights; }
 		bool lightsDirty(){ return m_lightsDirty; }
 		void cleanDirtyLights(){ m_lightsDirty = false; }
-        void makeLightsDirty(){ m_lightsDirty = true; }
+        void makeLightsDirty(){ m_lightsDirty = m_lightGridDirty = true; }
+		// goes up every time the lights are added, removed, moved or changed
+		unsigned int getLightsVersion(){ if (m_lightGridDirty) updateLightGrid(); return m_lightsVersion; }
+
+		// debug lines of the nodes, drawn in one go after the children
+		DebugDraw* getDebugDraw(){ return m_debugDraw; }
+
+		// loads and evicts the streamed models by their distance to the camera
+		ResidencyManager* getResidency(){ return m_residency; }
 
 		virtual void setPosition(const CCPoint& position);
 		virtual void setPositionX(float posX){ setPosition(CCPoint(posX, getPositionY())); }
 		virtual void setPositionY(float posY){ setPosition(CCPoint(getPositionX(), posY)); }
 	private:
+		struct LightScore
+		{
+			Light* light;
+			float influence;
+			float distance;
+
+			bool operator<(const LightScore& other) const
+			{
+				if (influence != other.influence)
+					return influence > other.influence;
+
+				return distance < other.distance;
+			}
+		};
+
 		void createDefaultCamera();
+		void updateLightGrid();
 		std::vector<Light*> m_lights;
-		bool m_fixedLights, m_lightsDirty;
+		std::vector<Light*> m_lightCandidates;
+		std::vector<LightScore> m_lightScores;
+		LightGrid m_lightGrid;
+		bool m_fixedLights, m_lightsDirty, m_lightGridDirty;
+		unsigned int m_lightsVersion;
 		Camera* m_camera;
+		DebugDraw* m_debugDraw;
+		ResidencyManager* m_residency;
 		Vec3 m_originalCamPos, m_originalCamCenter;
 
 		friend class Light;
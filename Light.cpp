@@ -99,6 +99,7 @@ bool Light::init()
 {
 	m_enabled = true;
 	m_intensity = 1.0f;
+	m_attenuation = Vec3(1.0f, 0.0f, 0.0f);
 
 	return CCNode::init();
 }
@@ -131,10 +132,49 @@ void Light::setIntensity(float intensity)
 	m_intensity = intensity;
 }
 
+void Light::setAttenuation(const Vec3& attenuation)
+{
+	m_attenuation = attenuation;
+
+	setParentDirty();
+}
+
+float Light::getRange()
+{
+	//distance where the light contribution drops under 1/256, -1 when it never does
+	const float threshold = 256.0f * m_intensity;
+
+	float a = m_attenuation.z;
+	float b = m_attenuation.y;
+	float c = m_attenuation.x - threshold;
+
+	if (c >= 0)
+		return 0;
+
+	if (a > 0)
+		return (-b + sqrtf(b*b - 4*a*c)) / (2*a);
+
+	if (b > 0)
+		return -c / b;
+
+	return -1;
+}
+
+float Light::getInfluence(float distance)
+{
+	float brightness = std::max(std::max(m_diffuse.x, m_diffuse.y), m_diffuse.z) + std::max(std::max(m_ambient.x, m_ambient.y), m_ambient.z);
+	float attenuation = m_attenuation.x + m_attenuation.y * distance + m_attenuation.z * distance * distance;
+
+	if (attenuation <= 0)
+		attenuation = 1.0f;
+
+	return (m_intensity * brightness) / attenuation;
+}
+
 void Light::setParentDirty()
 {
 	Layer3D* node = dynamic_cast<Layer3D*>(m_pParent);
 
 	if (node != NULL)
-		node->m_lightsDirty = true;
+		node->makeLightsDirty();
 }
\ No newline at end of file
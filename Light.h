@@ -37,11 +37,12 @@ namespace cocos3d
 	public:
 		CREATE_FUNC(Light);
 
+		// lights sent to the shaders per object, the layer itself accepts any number
 		static const int maxLights = 4;
 
 		virtual bool init();
 
-		void setEnabled(bool enabled){ m_enabled = enabled; }
+		void setEnabled(bool enabled){ m_enabled = enabled; setParentDirty(); }
 
 		void setAmbientDiffuseSpecularIntensity(const Vec3& ambient, const Vec3& diffuse, const Vec3& specular, float intensity = 1.0f); 
 
@@ -53,6 +54,13 @@ namespace cocos3d
 		void setCutOffAngle(float angle){ m_cutoffAngleCosine = angle; }
 		void setSpotExponent(float exponent){ m_spotExponent = exponent; }
 
+		// constant, linear and quadratic factors
+		void setAttenuation(const Vec3& attenuation);
+		const Vec3& getAttenuation(){ return m_attenuation; }
+
+		float getRange();
+		float getInfluence(float distance);
+
 		const Vec3& getAmbient(){ return m_ambient; }
 		const Vec3& getDiffuse(){ return m_diffuse; }
 		const Vec3& getSpecular(){ return m_specular; }
@@ -60,6 +68,7 @@ namespace cocos3d
 		const float getIntensity(){ return m_intensity; }
 
 		bool isEnabled(){ return m_enabled; }
+		bool hasMoved(){ return m_dirty; }
 
 		void setParentDirty();
 
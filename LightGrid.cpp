@@ -0,0 +1,107 @@
+#include "LightGrid.h"
+#include "Light.h"
+#include <algorithm>
+
+using namespace cocos3d;
+
+// a light spanning more cells than this per axis is treated as global
+#define MAX_CELLS_PER_AXIS 8
+
+LightGrid::LightGrid(float cellSize)
+: m_cellSize(cellSize)
+{
+}
+
+void LightGrid::setCellSize(float cellSize)
+{
+	if (cellSize > 0)
+		m_cellSize = cellSize;
+}
+
+long long LightGrid::cellKey(int x, int y, int z)
+{
+	//21 bits per axis
+	return ((long long)(x & 0x1FFFFF) << 42) | ((long long)(y & 0x1FFFFF) << 21) | (long long)(z & 0x1FFFFF);
+}
+
+int LightGrid::cellCoord(float value)
+{
+	return (int)floorf(value / m_cellSize);
+}
+
+void LightGrid::clear()
+{
+	m_cells.clear();
+	m_globalLights.clear();
+}
+
+void LightGrid::build(const std::vector<Light*>& lights)
+{
+	clear();
+
+	for (auto iter = lights.begin(); iter != lights.end(); iter++)
+	{
+		Light* light = *iter;
+
+		if (!light->isEnabled())
+			continue;
+
+		float range = light->getRange();
+		const Vec3& position = light->get3DPosition();
+
+		if (range < 0 || range / m_cellSize > MAX_CELLS_PER_AXIS)
+		{
+			m_globalLights.push_back(light);
+			continue;
+		}
+
+		int minX = cellCoord(position.x - range), maxX = cellCoord(position.x + range);
+		int minY = cellCoord(position.y - range), maxY = cellCoord(position.y + range);
+		int minZ = cellCoord(position.z - range), maxZ = cellCoord(position.z + range);
+
+		for (int x = minX; x <= maxX; x++)
+			for (int y = minY; y <= maxY; y++)
+				for (int z = minZ; z <= maxZ; z++)
+					m_cells[cellKey(x, y, z)].push_back(light);
+	}
+}
+
+void LightGrid::query(const Vec3& position, float radius, std::vector<Light*>& candidates)
+{
+	candidates.clear();
+	candidates.insert(candidates.end(), m_globalLights.begin(), m_globalLights.end());
+
+	if (m_cells.empty())
+		return;
+
+	int minX = cellCoord(position.x - radius), maxX = cellCoord(position.x + radius);
+	int minY = cellCoord(position.y - radius), maxY = cellCoord(position.y + radius);
+	int minZ = cellCoord(position.z - radius), maxZ = cellCoord(position.z + radius);
+
+	//big nodes: walk every occupied cell instead of every overlapped one
+	if ((long long)(maxX - minX + 1) * (maxY - minY + 1) * (maxZ - minZ + 1) > (long long)m_cells.size())
+	{
+		for (auto iter = m_cells.begin(); iter != m_cells.end(); iter++)
+			candidates.insert(candidates.end(), iter->second.begin(), iter->second.end());
+	}
+	else
+	{
+		for (int x = minX; x <= maxX; x++)
+		{
+			for (int y = minY; y <= maxY; y++)
+			{
+				for (int z = minZ; z <= maxZ; z++)
+				{
+					auto found = m_cells.find(cellKey(x, y, z));
+
+					if (found != m_cells.end())
+						candidates.insert(candidates.end(), found->second.begin(), found->second.end());
+				}
+			}
+		}
+	}
+
+	//a light touching several cells is listed once per cell
+	std::sort(candidates.begin(), candidates.end());
+	candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+}
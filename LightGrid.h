@@ -0,0 +1,40 @@
+#ifndef __LIGHT_GRID_H__
+#define __LIGHT_GRID_H__
+#include "cocos2d.h"
+#include <vector>
+#include <map>
+#include "Node3D.h"
+
+using namespace cocos2d;
+
+namespace cocos3d
+{
+	class Light;
+
+	// Uniform grid over the layer space. Every light is stored in all the cells its
+	// range touches, so a query only has to look at the cells around the node.
+	// Lights without a finite range (no attenuation) are kept in a global list.
+	class LightGrid
+	{
+	public:
+		LightGrid(float cellSize = 256.0f);
+
+		void setCellSize(float cellSize);
+		float getCellSize(){ return m_cellSize; }
+
+		void build(const std::vector<Light*>& lights);
+		void clear();
+
+		void query(const Vec3& position, float radius, std::vector<Light*>& candidates);
+
+	private:
+		long long cellKey(int x, int y, int z);
+		int cellCoord(float value);
+
+		float m_cellSize;
+
+		std::map<long long, std::vector<Light*> > m_cells;
+		std::vector<Light*> m_globalLights;
+	};
+}
+#endif
@@ -0,0 +1,132 @@
+#include "MaterialAtlas.h"
+#include <sstream>
+
+using namespace cocos3d;
+
+MaterialAtlas::MaterialAtlas()
+{
+}
+
+MaterialAtlas::~MaterialAtlas()
+{
+	purgeCache();
+}
+
+MaterialAtlas* MaterialAtlas::sharedMaterialAtlas()
+{
+	static MaterialAtlas* atlas = nullptr;
+
+	if (atlas == nullptr)
+	{
+		atlas = new MaterialAtlas();
+		atlas->autorelease();
+		atlas->retain();
+	}
+
+	return atlas;
+}
+
+bool MaterialAtlas::addPagesWithFile(const std::string& file)
+{
+	std::string fullPath = CCFileUtils::sharedFileUtils()->fullPathForFilename(file.c_str());
+
+	unsigned long size = 0;
+	unsigned char* data = CCFileUtils::sharedFileUtils()->getFileData(fullPath.c_str(), "rb", &size);
+
+	if (data == NULL)
+	{
+		CCLOG("cocos3d: MaterialAtlas can't read %s", file.c_str());
+		return false;
+	}
+
+	std::string contents((const char*)data, size);
+	delete [] data;
+
+	size_t slash = fullPath.find_last_of("/\\");
+	std::string directory = (slash == std::string::npos) ? "" : fullPath.substr(0, slash + 1);
+
+	//pages of this descriptor go after the ones already loaded
+	unsigned int firstPage = (unsigned int)m_pages.size();
+	std::vector<CCSize> pageSizes;
+
+	std::istringstream stream(contents);
+	std::string line;
+
+	while (std::getline(stream, line))
+	{
+		std::istringstream fields(line);
+		std::string type;
+
+		fields >> type;
+
+		if (type == "page")
+		{
+			std::string pageFile;
+			unsigned int width = 0, height = 0;
+
+			fields >> pageFile >> width >> height;
+
+			CCTexture2D* page = CCTextureCache::sharedTextureCache()->addImage((directory + pageFile).c_str());
+
+			if (page == NULL)
+			{
+				CCLOG("cocos3d: MaterialAtlas can't load %s", pageFile.c_str());
+				return false;
+			}
+
+			//the gutters keep the first mip levels of a texture to itself
+			page->generateMipmap();
+			page->setAntiAliasTexParameters();
+			page->retain();
+
+			m_pages.push_back(page);
+			pageSizes.push_back(CCSizeMake((float)width, (float)height));
+		}
+		else
+		if (type == "entry")
+		{
+			unsigned int page = 0, x = 0, y = 0, width = 0, height = 0;
+			std::string name;
+
+			fields >> page >> x >> y >> width >> height;
+			fields >> std::ws;
+			std::getline(fields, name);
+
+			if (page >= pageSizes.size() || name.empty())
+				continue;
+
+			Entry entry;
+			entry.page = m_pages[firstPage + page];
+			entry.pageIndex = firstPage + page;
+			entry.scaleU = width / pageSizes[page].width;
+			entry.scaleV = height / pageSizes[page].height;
+			entry.offsetU = x / pageSizes[page].width;
+			entry.offsetV = y / pageSizes[page].height;
+
+			m_entries[name] = entry;
+		}
+	}
+
+	return true;
+}
+
+bool MaterialAtlas::getEntry(const std::string& name, Entry* entry)
+{
+	auto found = m_entries.find(name);
+
+	if (found == m_entries.end())
+		return false;
+
+	*entry = found->second;
+
+	return true;
+}
+
+void MaterialAtlas::purgeCache()
+{
+	for (auto iter = m_pages.begin(); iter != m_pages.end(); iter++)
+		(*iter)->release();
+
+	m_pages.clear();
+	m_entries.clear();
+}
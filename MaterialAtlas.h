@@ -0,0 +1,50 @@
+#ifndef __MATERIAL_ATLAS_H__
+#define __MATERIAL_ATLAS_H__
+#include "cocos2d.h"
+#include <string>
+#include <map>
+#include <vector>
+
+using namespace std;
+using namespace cocos2d;
+
+namespace cocos3d
+{
+	// The atlas pages written by AtlasPacker. A model created with a texture that's
+	// in a page draws with the page instead, its texcoords moved inside the page, so
+	// every model of the page binds the same texture.
+	//
+	// Descriptor, one line each:
+	//   page <file> <width> <height>
+	//   entry <page> <x> <y> <width> <height> <texture name>
+	class MaterialAtlas : public CCObject
+	{
+	public:
+		struct Entry
+		{
+			CCTexture2D* page;
+			unsigned int pageIndex;
+
+			// texcoord * scale + offset gives the texcoord inside the page
+			float scaleU, scaleV;
+			float offsetU, offsetV;
+		};
+
+		MaterialAtlas();
+		~MaterialAtlas();
+
+		static MaterialAtlas* sharedMaterialAtlas();
+
+		// pages are looked for next to the descriptor
+		bool addPagesWithFile(const std::string& file);
+
+		bool getEntry(const std::string& name, Entry* entry);
+
+		void purgeCache();
+
+	private:
+		std::vector<CCTexture2D*> m_pages;
+		std::map<std::string, Entry> m_entries;
+	};
+}
+#endif
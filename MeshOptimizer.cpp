@@ -0,0 +1,386 @@
+#include "MeshOptimizer.h"
+#include <math.h>
+#include <map>
+#include <unordered_set>
+
+using namespace cocos3d;
+
+// Forsyth's scoring, tuned for a 32 entries lru cache
+#define FORSYTH_CACHE_SIZE 32
+#define FORSYTH_CACHE_DECAY_POWER 1.5f
+#define FORSYTH_LAST_TRIANGLE_SCORE 0.75f
+#define FORSYTH_VALENCE_BOOST_SCALE 2.0f
+#define FORSYTH_VALENCE_BOOST_POWER 0.5f
+
+static float vertexScore(int cachePosition, unsigned int remainingTriangles)
+{
+	//no triangle left to draw, never pick it
+	if (remainingTriangles == 0)
+		return -1.0f;
+
+	float score = 0;
+
+	if (cachePosition >= 0)
+	{
+		//the last triangle's vertices are scored the same, whatever the order they were added in
+		if (cachePosition < 3)
+			score = FORSYTH_LAST_TRIANGLE_SCORE;
+		else
+			score = powf(1.0f - (cachePosition - 3) / (float)(FORSYTH_CACHE_SIZE - 3), FORSYTH_CACHE_DECAY_POWER);
+	}
+
+	//favor the vertices with few triangles left, so lone triangles aren't left behind
+	score += FORSYTH_VALENCE_BOOST_SCALE * powf((float)remainingTriangles, -FORSYTH_VALENCE_BOOST_POWER);
+
+	return score;
+}
+
+class lessVertex3F
+{
+public:
+	bool operator()(const Vec3& a, const Vec3& b) const
+	{
+		if (a.x != b.x) return a.x < b.x;
+		if (a.y != b.y) return a.y < b.y;
+		return a.z < b.z;
+	}
+};
+
+// For every vertex, the index of the first vertex at the same position (itself
+// when it's the first one). Sorted keys instead of comparing all the pairs.
+void cocos3d::weldVertices(const std::vector<Vec3>& vertices, std::vector<unsigned int>& firsts)
+{
+	std::map<Vec3, unsigned int, lessVertex3F> welded;
+
+	firsts.resize(vertices.size());
+
+	for (unsigned int i = 0; i < vertices.size(); i++)
+	{
+		const Vec3& v = vertices[i];
+
+		//NaN never equals anything, not even itself
+		if (v.x != v.x || v.y != v.y || v.z != v.z)
+		{
+			firsts[i] = i;
+			continue;
+		}
+
+		firsts[i] = welded.insert(std::make_pair(v, i)).first->second;
+	}
+}
+
+void cocos3d::buildEdgeIndices(const std::vector<unsigned int>& triangles,
+								const std::vector<int>& firsts,
+								const std::vector<int>& counts,
+								std::vector<unsigned int>& edges,
+								std::vector<int>& edgeFirsts,
+								std::vector<int>& edgeCounts)
+{
+	std::unordered_set<unsigned long long> seen;
+	seen.reserve(triangles.size());
+
+	edges.clear();
+	edgeFirsts.clear();
+	edgeCounts.clear();
+
+	for (unsigned int group = 0; group < firsts.size(); group++)
+	{
+		int first = (int)edges.size();
+
+		for (int t = firsts[group]; t + 2 < firsts[group] + counts[group]; t += 3)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int a = triangles[t + k];
+				unsigned int b = triangles[t + (k + 1) % 3];
+
+				if (a == b)
+					continue;
+
+				//the same edge in both directions, drawn once by the first group having it
+				unsigned long long key = (a < b) ? ((unsigned long long)a << 32 | b) : ((unsigned long long)b << 32 | a);
+
+				if (seen.insert(key).second)
+				{
+					edges.push_back(a);
+					edges.push_back(b);
+				}
+			}
+		}
+
+		edgeFirsts.push_back(first);
+		edgeCounts.push_back((int)edges.size() - first);
+	}
+}
+
+float cocos3d::computeACMR(const std::vector<unsigned int>& indices, unsigned int vertexCount, unsigned int cacheSize)
+{
+	if (indices.size() < 3)
+		return 0;
+
+	//timestamp of each vertex entering the fifo, it's still in while less than cacheSize entries came after it
+	std::vector<unsigned int> entered(vertexCount, 0);
+	unsigned int time = cacheSize + 1;
+	unsigned int misses = 0;
+
+	for (unsigned int i = 0; i < indices.size(); i++)
+	{
+		unsigned int index = indices[i];
+
+		if (time - entered[index] > cacheSize)
+		{
+			entered[index] = time++;
+			misses++;
+		}
+	}
+
+	return misses / (float)(indices.size() / 3);
+}
+
+void cocos3d::optimizeVertexCache(std::vector<unsigned int>& indices, unsigned int vertexCount)
+{
+	unsigned int triangleCount = (unsigned int)indices.size() / 3;
+
+	if (triangleCount == 0)
+		return;
+
+	//triangles of each vertex, packed: vertex v owns [firsts[v], firsts[v] + remaining[v])
+	std::vector<unsigned int> remaining(vertexCount, 0);
+	std::vector<unsigned int> firsts(vertexCount, 0);
+
+	for (unsigned int i = 0; i < triangleCount * 3; i++)
+		remaining[indices[i]]++;
+
+	for (unsigned int v = 1; v < vertexCount; v++)
+		firsts[v] = firsts[v - 1] + remaining[v - 1];
+
+	std::vector<unsigned int> adjacency(triangleCount * 3);
+	std::vector<unsigned int> filled(vertexCount, 0);
+
+	for (unsigned int t = 0; t < triangleCount; t++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int v = indices[t * 3 + k];
+			adjacency[firsts[v] + filled[v]++] = t;
+		}
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+
+	for (unsigned int v = 0; v < vertexCount; v++)
+		vertexScores[v] = vertexScore(-1, remaining[v]);
+
+	std::vector<float> triangleScores(triangleCount);
+	std::vector<bool> emitted(triangleCount, false);
+
+	for (unsigned int t = 0; t < triangleCount; t++)
+	{
+		triangleScores[t] = vertexScores[indices[t * 3]]
+						  + vertexScores[indices[t * 3 + 1]]
+						  + vertexScores[indices[t * 3 + 2]];
+	}
+
+	std::vector<unsigned int> optimized;
+	optimized.reserve(triangleCount * 3);
+
+	std::vector<unsigned int> cache, newCache;
+	cache.reserve(FORSYTH_CACHE_SIZE + 3);
+	newCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+	int best = -1;
+	unsigned int scan = 0;
+
+	for (unsigned int emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+	{
+		//nothing in the cache has triangles left, start again from the best remaining one
+		if (best < 0)
+		{
+			float bestScore = -1;
+
+			while (scan < triangleCount && emitted[scan])
+				scan++;
+
+			for (unsigned int t = scan; t < triangleCount; t++)
+			{
+				if (!emitted[t] && triangleScores[t] > bestScore)
+				{
+					bestScore = triangleScores[t];
+					best = (int)t;
+				}
+			}
+		}
+
+		unsigned int triangle = (unsigned int)best;
+		emitted[triangle] = true;
+
+		newCache.clear();
+
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int v = indices[triangle * 3 + k];
+			optimized.push_back(v);
+			newCache.push_back(v);
+
+			//take the triangle out of the vertex's list
+			unsigned int* begin = &adjacency[firsts[v]];
+			unsigned int* end = begin + remaining[v];
+
+			for (unsigned int* iter = begin; iter != end; iter++)
+			{
+				if (*iter == triangle)
+				{
+					*iter = *(end - 1);
+					break;
+				}
+			}
+
+			remaining[v]--;
+		}
+
+		for (unsigned int i = 0; i < cache.size(); i++)
+		{
+			unsigned int v = cache[i];
+
+			if (v != newCache[0] && v != newCache[1] && v != newCache[2])
+				newCache.push_back(v);
+		}
+
+		//evicted vertices lose their cache bonus
+		for (unsigned int i = FORSYTH_CACHE_SIZE; i < newCache.size(); i++)
+		{
+			cachePosition[newCache[i]] = -1;
+			vertexScores[newCache[i]] = vertexScore(-1, remaining[newCache[i]]);
+		}
+
+		if (newCache.size() > FORSYTH_CACHE_SIZE)
+			newCache.resize(FORSYTH_CACHE_SIZE);
+
+		cache.swap(newCache);
+
+		for (unsigned int i = 0; i < cache.size(); i++)
+		{
+			cachePosition[cache[i]] = (int)i;
+			vertexScores[cache[i]] = vertexScore((int)i, remaining[cache[i]]);
+		}
+
+		//only triangles touching the cache changed, the next one is among them
+		best = -1;
+		float bestScore = -1;
+
+		for (unsigned int i = 0; i < cache.size(); i++)
+		{
+			unsigned int v = cache[i];
+
+			for (unsigned int j = 0; j < remaining[v]; j++)
+			{
+				unsigned int t = adjacency[firsts[v] + j];
+
+				triangleScores[t] = vertexScores[indices[t * 3]]
+								  + vertexScores[indices[t * 3 + 1]]
+								  + vertexScores[indices[t * 3 + 2]];
+
+				if (triangleScores[t] > bestScore)
+				{
+					bestScore = triangleScores[t];
+					best = (int)t;
+				}
+			}
+		}
+	}
+
+	indices.swap(optimized);
+}
+
+unsigned int cocos3d::optimizeVertexFetch(std::vector<unsigned int>& indices, unsigned int vertexCount, std::vector<unsigned int>& remap)
+{
+	remap.assign(vertexCount, INVALID_VERTEX_INDEX);
+
+	unsigned int next = 0;
+
+	for (unsigned int i = 0; i < indices.size(); i++)
+	{
+		unsigned int& index = indices[i];
+
+		if (remap[index] == INVALID_VERTEX_INDEX)
+			remap[index] = next++;
+
+		index = remap[index];
+	}
+
+	return next;
+}
+
+void cocos3d::stripifyIndices(const std::vector<unsigned int>& indices, std::vector<unsigned int>& strip)
+{
+	strip.clear();
+
+	for (unsigned int t = 0; t + 2 < indices.size(); t += 3)
+	{
+		const unsigned int* triangle = &indices[t];
+		size_t n = strip.size();
+
+		if (n == 0)
+		{
+			strip.insert(strip.end(), triangle, triangle + 3);
+			continue;
+		}
+
+		//the next vertex makes triangle n - 2, odd ones have their first two vertices swapped
+		unsigned int first = (n % 2 == 0) ? strip[n - 2] : strip[n - 1];
+		unsigned int second = (n % 2 == 0) ? strip[n - 1] : strip[n - 2];
+
+		bool joined = false;
+
+		for (int r = 0; r < 3 && !joined; r++)
+		{
+			if (triangle[r] == first && triangle[(r + 1) % 3] == second)
+			{
+				strip.push_back(triangle[(r + 2) % 3]);
+				joined = true;
+			}
+		}
+
+		if (joined)
+			continue;
+
+		//degenerate triangles up to an even position, so the winding is kept
+		strip.push_back(strip[n - 1]);
+		strip.push_back(triangle[0]);
+
+		if (n % 2 == 1)
+			strip.push_back(triangle[0]);
+
+		strip.insert(strip.end(), triangle, triangle + 3);
+	}
+}
+
+unsigned int cocos3d::optimizeIndexedMesh(std::vector<unsigned int>& indices,
+										  unsigned int vertexCount,
+										  std::vector<unsigned int>& remap,
+										  const std::string& name,
+										  MeshOptimizationStats* stats)
+{
+	//only logged, CCLOG is empty in release builds
+	CC_UNUSED_PARAM(name);
+
+	float before = computeACMR(indices, vertexCount);
+
+	optimizeVertexCache(indices, vertexCount);
+	unsigned int optimizedCount = optimizeVertexFetch(indices, vertexCount, remap);
+
+	float after = computeACMR(indices, optimizedCount);
+
+	CCLOG("cocos3d: %s ACMR %.3f -> %.3f, %u triangles, %u vertices",
+		name.c_str(), before, after, (unsigned int)indices.size() / 3, optimizedCount);
+
+	if (stats != NULL)
+	{
+		stats->acmrBefore = before;
+		stats->acmrAfter = after;
+		stats->vertexCount = optimizedCount;
+	}
+
+	return optimizedCount;
+}
@@ -0,0 +1,72 @@
+#ifndef __MESH_OPTIMIZER_H__
+#define __MESH_OPTIMIZER_H__
+#include "cocos2d.h"
+#include <vector>
+#include <string>
+#include "Node3D.h"
+
+using namespace std;
+using namespace cocos2d;
+
+namespace cocos3d
+{
+	// average cache miss ratio of the sizes gpus usually have, lower is better
+	#define ACMR_CACHE_SIZE 16
+
+	struct MeshOptimizationStats
+	{
+		float acmrBefore, acmrAfter;
+		unsigned int vertexCount;
+	};
+
+	// For every vertex, the index of the first vertex at the same position (itself
+	// when it's the first one), so an unindexed list becomes an indexed one
+	void weldVertices(const std::vector<Vec3>& vertices, std::vector<unsigned int>& firsts);
+
+	// unique edges of a triangle list as GL_LINES indices, firsts and counts split the
+	// triangles in groups (materials) and the edges come out in the same groups
+	void buildEdgeIndices(const std::vector<unsigned int>& triangles,
+						  const std::vector<int>& firsts,
+						  const std::vector<int>& counts,
+						  std::vector<unsigned int>& edges,
+						  std::vector<int>& edgeFirsts,
+						  std::vector<int>& edgeCounts);
+
+	// transformed vertices per triangle with a fifo post-transform cache,
+	// 3 is the worst, about 0.5 the best a regular grid can do
+	float computeACMR(const std::vector<unsigned int>& indices, unsigned int vertexCount, unsigned int cacheSize = ACMR_CACHE_SIZE);
+
+	// reorders the triangles of a list for vertex cache reuse (Forsyth's linear-speed algorithm)
+	void optimizeVertexCache(std::vector<unsigned int>& indices, unsigned int vertexCount);
+
+	// renumbers the vertices in first use order and drops the unused ones, remap[old] is
+	// the new index or INVALID_VERTEX_INDEX, returns the new vertex count
+	#define INVALID_VERTEX_INDEX 0xFFFFFFFF
+	unsigned int optimizeVertexFetch(std::vector<unsigned int>& indices, unsigned int vertexCount, std::vector<unsigned int>& remap);
+
+	// one strip for the whole list, joined by degenerate triangles, same winding
+	void stripifyIndices(const std::vector<unsigned int>& indices, std::vector<unsigned int>& strip);
+
+	// cache and fetch passes together, logs the ACMR before and after under the given name
+	unsigned int optimizeIndexedMesh(std::vector<unsigned int>& indices,
+									 unsigned int vertexCount,
+									 std::vector<unsigned int>& remap,
+									 const std::string& name,
+									 MeshOptimizationStats* stats = NULL);
+
+	// moves the vertex attributes where optimizeVertexFetch put them
+	template <class T>
+	void remapVertices(std::vector<T>& attribute, const std::vector<unsigned int>& remap, unsigned int vertexCount)
+	{
+		std::vector<T> remapped(vertexCount);
+
+		for (unsigned int i = 0; i < attribute.size() && i < remap.size(); i++)
+		{
+			if (remap[i] != INVALID_VERTEX_INDEX)
+				remapped[remap[i]] = attribute[i];
+		}
+
+		attribute.swap(remapped);
+	}
+}
+#endif
@@ -0,0 +1,161 @@
+#include "MeshQuantizer.h"
+#include <math.h>
+#include <float.h>
+
+using namespace cocos3d;
+
+#define UNORM16_MAX 65535.0f
+
+static GLushort toUnorm16(float value)
+{
+	return (GLushort)floorf(MAX(0.0f, MIN(1.0f, value)) * UNORM16_MAX + 0.5f);
+}
+
+static float signNotZero(float value)
+{
+	return (value >= 0) ? 1.0f : -1.0f;
+}
+
+void cocos3d::computeQuantization(const std::vector<Vec3>& positions,
+								  const std::vector<Vec2>& texels,
+								  VertexQuantization& quantization)
+{
+	Vec3 min(FLT_MAX, FLT_MAX, FLT_MAX);
+	Vec3 max(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+	for (auto iter = positions.begin(); iter != positions.end(); iter++)
+	{
+		min.x = MIN(min.x, iter->x); max.x = MAX(max.x, iter->x);
+		min.y = MIN(min.y, iter->y); max.y = MAX(max.y, iter->y);
+		min.z = MIN(min.z, iter->z); max.z = MAX(max.z, iter->z);
+	}
+
+	if (positions.empty())
+		min = max = Vec3();
+
+	quantization.min = min;
+	quantization.size = Vec3(max.x - min.x, max.y - min.y, max.z - min.z);
+
+	Vec2 texelMin(FLT_MAX, FLT_MAX);
+	Vec2 texelMax(-FLT_MAX, -FLT_MAX);
+
+	for (auto iter = texels.begin(); iter != texels.end(); iter++)
+	{
+		texelMin.x = MIN(texelMin.x, iter->x); texelMax.x = MAX(texelMax.x, iter->x);
+		texelMin.y = MIN(texelMin.y, iter->y); texelMax.y = MAX(texelMax.y, iter->y);
+	}
+
+	if (texels.empty())
+	{
+		texelMin = Vec2(0, 0);
+		texelMax = Vec2(1, 1);
+	}
+
+	//repeating texels keep their range, not just [0, 1]
+	quantization.texelOffset = texelMin;
+	quantization.texelScale = Vec2(texelMax.x - texelMin.x, texelMax.y - texelMin.y);
+}
+
+void cocos3d::quantizeVertices(const std::vector<Vec3>& positions,
+							   const std::vector<Vec3>& normals,
+							   const std::vector<Vec2>& texels,
+							   const VertexQuantization& quantization,
+							   QuantizedVertices& quantized)
+{
+	const Vec3& min = quantization.min;
+	const Vec3& size = quantization.size;
+
+	//a flat axis is all at its min
+	Vec3 inverse(size.x > 0 ? 1.0f / size.x : 0,
+				 size.y > 0 ? 1.0f / size.y : 0,
+				 size.z > 0 ? 1.0f / size.z : 0);
+
+	quantized.positions.resize(positions.size() * QUANTIZED_POSITION_COMPONENTS);
+
+	for (unsigned int i = 0; i < positions.size(); i++)
+	{
+		GLushort* position = &quantized.positions[i * QUANTIZED_POSITION_COMPONENTS];
+
+		position[0] = toUnorm16((positions[i].x - min.x) * inverse.x);
+		position[1] = toUnorm16((positions[i].y - min.y) * inverse.y);
+		position[2] = toUnorm16((positions[i].z - min.z) * inverse.z);
+		position[3] = 0;
+	}
+
+	quantized.normals.resize(normals.size() * 2);
+
+	for (unsigned int i = 0; i < normals.size(); i++)
+		encodeOctahedral(normals[i], &quantized.normals[i * 2]);
+
+	const Vec2& offset = quantization.texelOffset;
+	const Vec2& scale = quantization.texelScale;
+
+	Vec2 texelInverse(scale.x > 0 ? 1.0f / scale.x : 0,
+					  scale.y > 0 ? 1.0f / scale.y : 0);
+
+	quantized.texels.resize(texels.size() * 2);
+
+	for (unsigned int i = 0; i < texels.size(); i++)
+	{
+		quantized.texels[i * 2] = toUnorm16((texels[i].x - offset.x) * texelInverse.x);
+		quantized.texels[i * 2 + 1] = toUnorm16((texels[i].y - offset.y) * texelInverse.y);
+	}
+}
+
+void cocos3d::encodeOctahedral(const Vec3& normal, GLushort* encoded)
+{
+	float length = fabsf(normal.x) + fabsf(normal.y) + fabsf(normal.z);
+
+	//degenerate triangles have no normal, any will do
+	if (length == 0)
+	{
+		encoded[0] = encoded[1] = toUnorm16(0.5f);
+		return;
+	}
+
+	float x = normal.x / length;
+	float y = normal.y / length;
+
+	if (normal.z < 0)
+	{
+		float foldedX = (1.0f - fabsf(y)) * signNotZero(x);
+		float foldedY = (1.0f - fabsf(x)) * signNotZero(y);
+
+		x = foldedX;
+		y = foldedY;
+	}
+
+	encoded[0] = toUnorm16(x * 0.5f + 0.5f);
+	encoded[1] = toUnorm16(y * 0.5f + 0.5f);
+}
+
+Vec3 cocos3d::decodeOctahedral(const GLushort* encoded)
+{
+	//the same as decodeNormal in the phong shaders
+	float x = encoded[0] / UNORM16_MAX * 2.0f - 1.0f;
+	float y = encoded[1] / UNORM16_MAX * 2.0f - 1.0f;
+	float z = 1.0f - fabsf(x) - fabsf(y);
+
+	if (z < 0)
+	{
+		float unfoldedX = (1.0f - fabsf(y)) * signNotZero(x);
+		float unfoldedY = (1.0f - fabsf(x)) * signNotZero(y);
+
+		x = unfoldedX;
+		y = unfoldedY;
+	}
+
+	float length = sqrtf(x*x + y*y + z*z);
+
+	return Vec3(x / length, y / length, z / length);
+}
+
+void cocos3d::dequantizationMatrix(const VertexQuantization& quantization, kmMat4* matrix)
+{
+	kmMat4 translation, scale;
+
+	kmMat4Translation(&translation, quantization.min.x, quantization.min.y, quantization.min.z);
+	kmMat4Scaling(&scale, quantization.size.x, quantization.size.y, quantization.size.z);
+
+	kmMat4Multiply(matrix, &translation, &scale);
+}
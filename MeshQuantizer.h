@@ -0,0 +1,51 @@
+#ifndef __MESH_QUANTIZER_H__
+#define __MESH_QUANTIZER_H__
+#include "cocos2d.h"
+#include <vector>
+#include "Node3D.h"
+
+using namespace std;
+using namespace cocos2d;
+
+namespace cocos3d
+{
+	// Where the 16 bit values of a mesh map back to: a position is min + q * size in
+	// the box of the mesh, a texel offset + q * scale in the range of its texels,
+	// q going from 0 to 1 as the shaders see it
+	struct VertexQuantization
+	{
+		Vec3 min, size;
+		Vec2 texelOffset, texelScale;
+	};
+
+	// 16 bytes a vertex instead of 32, every value an unsigned normalized short:
+	// positions 4 per vertex (the 4th keeps them aligned), octahedral normals 2,
+	// texels 2
+	struct QuantizedVertices
+	{
+		std::vector<GLushort> positions;
+		std::vector<GLushort> normals;
+		std::vector<GLushort> texels;
+	};
+
+	#define QUANTIZED_POSITION_COMPONENTS 4
+
+	// the box of the positions and the range of the texels
+	void computeQuantization(const std::vector<Vec3>& positions,
+							 const std::vector<Vec2>& texels,
+							 VertexQuantization& quantization);
+
+	void quantizeVertices(const std::vector<Vec3>& positions,
+						  const std::vector<Vec3>& normals,
+						  const std::vector<Vec2>& texels,
+						  const VertexQuantization& quantization,
+						  QuantizedVertices& quantized);
+
+	// unit normal folded on an octahedron, then on its upper half
+	void encodeOctahedral(const Vec3& normal, GLushort* encoded);
+	Vec3 decodeOctahedral(const GLushort* encoded);
+
+	// what the model matrix is multiplied by so the positions come back
+	void dequantizationMatrix(const VertexQuantization& quantization, kmMat4* matrix);
+}
+#endif
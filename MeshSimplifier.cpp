@@ -0,0 +1,588 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include "OBJParser.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <queue>
+#include <algorithm>
+#include <unordered_map>
+
+using namespace cocos3d;
+
+#define LOD_FILE_MAGIC 0x444F4C43 // "CLOD"
+#define LOD_FILE_VERSION 1
+
+// symmetric 4x4, the error of a point is its squared distance to the planes summed
+struct Quadric
+{
+	double xx, xy, xz, xw, yy, yz, yw, zz, zw, ww;
+};
+
+static void addPlane(Quadric& q, double a, double b, double c, double d, double weight)
+{
+	q.xx += weight * a * a; q.xy += weight * a * b; q.xz += weight * a * c; q.xw += weight * a * d;
+	q.yy += weight * b * b; q.yz += weight * b * c; q.yw += weight * b * d;
+	q.zz += weight * c * c; q.zw += weight * c * d;
+	q.ww += weight * d * d;
+}
+
+static void addQuadric(Quadric& q, const Quadric& other)
+{
+	q.xx += other.xx; q.xy += other.xy; q.xz += other.xz; q.xw += other.xw;
+	q.yy += other.yy; q.yz += other.yz; q.yw += other.yw;
+	q.zz += other.zz; q.zw += other.zw;
+	q.ww += other.ww;
+}
+
+static double evaluate(const Quadric& q, const Vec3& p)
+{
+	double x = p.x, y = p.y, z = p.z;
+
+	return q.xx * x * x + 2 * q.xy * x * y + 2 * q.xz * x * z + 2 * q.xw * x
+		 + q.yy * y * y + 2 * q.yz * y * z + 2 * q.yw * y
+		 + q.zz * z * z + 2 * q.zw * z
+		 + q.ww;
+}
+
+static Vec3 subtract(const Vec3& a, const Vec3& b)
+{
+	return Vec3(a.x - b.x, a.y - b.y, a.z - b.z);
+}
+
+static Vec3 cross(const Vec3& a, const Vec3& b)
+{
+	return Vec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+
+static float dot(const Vec3& a, const Vec3& b)
+{
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+static unsigned long long edgeKey(unsigned int a, unsigned int b)
+{
+	return (a < b) ? ((unsigned long long)a << 32 | b) : ((unsigned long long)b << 32 | a);
+}
+
+struct Collapse
+{
+	double cost;
+	unsigned int from, to;
+	unsigned int fromVersion, toVersion;
+
+	bool operator>(const Collapse& other) const { return cost > other.cost; }
+};
+
+// Collapses a welded triangle list down a triangle count at a time, so a whole chain
+// comes out of one run. Vertices are indices into the positions, the first of each
+// position, the others are never used.
+class Simplifier
+{
+public:
+	Simplifier(const std::vector<Vec3>& positions, const std::vector<int>& firsts, const std::vector<int>& counts);
+
+	void collapseTo(unsigned int targetTriangles);
+	unsigned int getTriangleCount(){ return m_liveTriangles; }
+
+	void output(const std::vector<Vec2>& texels, MeshLODLevel& level);
+
+private:
+	void pushEdge(unsigned int a, unsigned int b);
+	bool canCollapse(unsigned int from, unsigned int to);
+	void collapse(unsigned int from, unsigned int to);
+
+	const std::vector<Vec3>& m_positions;
+	const std::vector<int>& m_firsts;
+	const std::vector<int>& m_counts;
+
+	std::vector<unsigned int> m_corners;
+	std::vector<bool> m_alive;
+	unsigned int m_liveTriangles;
+
+	std::vector<Quadric> m_quadrics;
+	std::vector<std::vector<unsigned int> > m_triangles;
+	std::vector<unsigned int> m_versions;
+
+	std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse> > m_collapses;
+};
+
+Simplifier::Simplifier(const std::vector<Vec3>& positions, const std::vector<int>& firsts, const std::vector<int>& counts)
+: m_positions(positions)
+, m_firsts(firsts)
+, m_counts(counts)
+, m_liveTriangles(0)
+{
+	unsigned int triangleCount = (unsigned int)positions.size() / 3;
+
+	weldVertices(positions, m_corners);
+	m_corners.resize(triangleCount * 3);
+
+	std::vector<int> materials(triangleCount, 0);
+
+	for (unsigned int group = 0; group < firsts.size(); group++)
+	{
+		for (int t = firsts[group] / 3; t < (firsts[group] + counts[group]) / 3 && t < (int)triangleCount; t++)
+			materials[t] = group;
+	}
+
+	Quadric zero = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+	m_alive.assign(triangleCount, false);
+	m_quadrics.assign(positions.size(), zero);
+	m_triangles.resize(positions.size());
+	m_versions.assign(positions.size(), 0);
+
+	struct EdgeUse
+	{
+		unsigned int count;
+		unsigned int triangle;
+		int material;
+		bool seam;
+	};
+
+	std::unordered_map<unsigned long long, EdgeUse> edges;
+
+	for (unsigned int t = 0; t < triangleCount; t++)
+	{
+		unsigned int* corners = &m_corners[t * 3];
+
+		if (corners[0] == corners[1] || corners[1] == corners[2] || corners[0] == corners[2])
+			continue;
+
+		const Vec3& a = positions[corners[0]];
+		Vec3 normal = cross(subtract(positions[corners[1]], a), subtract(positions[corners[2]], a));
+		float length = sqrtf(dot(normal, normal));
+
+		if (length == 0)
+			continue;
+
+		m_alive[t] = true;
+		m_liveTriangles++;
+
+		//weighted by area, big faces hold their plane better
+		for (int k = 0; k < 3; k++)
+		{
+			addPlane(m_quadrics[corners[k]], normal.x / length, normal.y / length, normal.z / length,
+					 -dot(normal, a) / length, length * 0.5f);
+
+			m_triangles[corners[k]].push_back(t);
+
+			EdgeUse& use = edges[edgeKey(corners[k], corners[(k + 1) % 3])];
+
+			if (use.count == 0)
+			{
+				use.triangle = t;
+				use.material = materials[t];
+				use.seam = false;
+			}
+			else
+			if (use.material != materials[t])
+			{
+				use.seam = true;
+			}
+
+			use.count++;
+		}
+	}
+
+	for (auto iter = edges.begin(); iter != edges.end(); iter++)
+	{
+		unsigned int a = (unsigned int)(iter->first >> 32);
+		unsigned int b = (unsigned int)(iter->first & 0xFFFFFFFF);
+
+		//a plane through the edge, across its face, keeps the outline where it is
+		if (iter->second.count == 1 || iter->second.seam)
+		{
+			const unsigned int* corners = &m_corners[iter->second.triangle * 3];
+			const Vec3& c = positions[corners[0]];
+
+			Vec3 face = cross(subtract(positions[corners[1]], c), subtract(positions[corners[2]], c));
+			Vec3 edge = subtract(positions[b], positions[a]);
+			Vec3 normal = cross(edge, face);
+
+			float length = sqrtf(dot(normal, normal));
+
+			if (length > 0)
+			{
+				float weight = MESH_LOD_BORDER_WEIGHT * dot(edge, edge);
+				float d = -dot(normal, positions[a]) / length;
+
+				addPlane(m_quadrics[a], normal.x / length, normal.y / length, normal.z / length, d, weight);
+				addPlane(m_quadrics[b], normal.x / length, normal.y / length, normal.z / length, d, weight);
+			}
+		}
+
+		pushEdge(a, b);
+	}
+}
+
+void Simplifier::pushEdge(unsigned int a, unsigned int b)
+{
+	Quadric quadric = m_quadrics[a];
+	addQuadric(quadric, m_quadrics[b]);
+
+	//onto the end that costs less
+	double toB = evaluate(quadric, m_positions[b]);
+	double toA = evaluate(quadric, m_positions[a]);
+
+	Collapse collapse;
+
+	if (toB <= toA)
+	{
+		collapse.cost = toB;
+		collapse.from = a;
+		collapse.to = b;
+	}
+	else
+	{
+		collapse.cost = toA;
+		collapse.from = b;
+		collapse.to = a;
+	}
+
+	collapse.fromVersion = m_versions[collapse.from];
+	collapse.toVersion = m_versions[collapse.to];
+
+	m_collapses.push(collapse);
+}
+
+bool Simplifier::canCollapse(unsigned int from, unsigned int to)
+{
+	const std::vector<unsigned int>& triangles = m_triangles[from];
+
+	for (auto iter = triangles.begin(); iter != triangles.end(); iter++)
+	{
+		if (!m_alive[*iter])
+			continue;
+
+		const unsigned int* corners = &m_corners[*iter * 3];
+
+		//those go away with the edge
+		if (corners[0] == to || corners[1] == to || corners[2] == to)
+			continue;
+
+		Vec3 moved[3];
+
+		for (int k = 0; k < 3; k++)
+			moved[k] = m_positions[corners[k] == from ? to : corners[k]];
+
+		const Vec3& a = m_positions[corners[0]];
+		Vec3 before = cross(subtract(m_positions[corners[1]], a), subtract(m_positions[corners[2]], a));
+		Vec3 after = cross(subtract(moved[1], moved[0]), subtract(moved[2], moved[0]));
+
+		if (dot(before, after) <= 0)
+			return false;
+	}
+
+	return true;
+}
+
+void Simplifier::collapse(unsigned int from, unsigned int to)
+{
+	addQuadric(m_quadrics[to], m_quadrics[from]);
+
+	std::vector<unsigned int>& fromTriangles = m_triangles[from];
+	std::vector<unsigned int>& toTriangles = m_triangles[to];
+
+	for (auto iter = fromTriangles.begin(); iter != fromTriangles.end(); iter++)
+	{
+		if (!m_alive[*iter])
+			continue;
+
+		unsigned int* corners = &m_corners[*iter * 3];
+
+		if (corners[0] == to || corners[1] == to || corners[2] == to)
+		{
+			m_alive[*iter] = false;
+			m_liveTriangles--;
+			continue;
+		}
+
+		for (int k = 0; k < 3; k++)
+		{
+			if (corners[k] == from)
+				corners[k] = to;
+		}
+
+		toTriangles.push_back(*iter);
+	}
+
+	std::vector<unsigned int>().swap(fromTriangles);
+
+	m_versions[from]++;
+	m_versions[to]++;
+
+	//the dead ones go, and the edges around the vertex are priced again
+	std::vector<unsigned int> alive, neighbours;
+
+	for (auto iter = toTriangles.begin(); iter != toTriangles.end(); iter++)
+	{
+		if (!m_alive[*iter])
+			continue;
+
+		alive.push_back(*iter);
+
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int corner = m_corners[*iter * 3 + k];
+
+			if (corner != to)
+				neighbours.push_back(corner);
+		}
+	}
+
+	toTriangles.swap(alive);
+
+	std::sort(neighbours.begin(), neighbours.end());
+	neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+
+	for (auto iter = neighbours.begin(); iter != neighbours.end(); iter++)
+		pushEdge(to, *iter);
+}
+
+void Simplifier::collapseTo(unsigned int targetTriangles)
+{
+	while (m_liveTriangles > targetTriangles && !m_collapses.empty())
+	{
+		Collapse next = m_collapses.top();
+		m_collapses.pop();
+
+		//priced before one of its ends changed, it's been pushed again since
+		if (next.fromVersion != m_versions[next.from] || next.toVersion != m_versions[next.to])
+			continue;
+
+		if (!canCollapse(next.from, next.to))
+			continue;
+
+		collapse(next.from, next.to);
+	}
+}
+
+void Simplifier::output(const std::vector<Vec2>& texels, MeshLODLevel& level)
+{
+	bool textured = (texels.size() == m_positions.size());
+
+	for (unsigned int group = 0; group < m_firsts.size(); group++)
+	{
+		level.firsts.push_back((int)level.positions.size());
+
+		for (int t = m_firsts[group] / 3; t < (m_firsts[group] + m_counts[group]) / 3 && t < (int)m_alive.size(); t++)
+		{
+			if (!m_alive[t])
+				continue;
+
+			const unsigned int* corners = &m_corners[t * 3];
+
+			const Vec3& a = m_positions[corners[0]];
+			const Vec3& b = m_positions[corners[1]];
+			const Vec3& c = m_positions[corners[2]];
+
+			//as OBJParser::flatNormals makes them
+			Vec3 normal = cross(subtract(c, a), subtract(b, a));
+
+			for (int k = 0; k < 3; k++)
+			{
+				level.positions.push_back(m_positions[corners[k]]);
+				level.normals.push_back(normal);
+
+				//the corner's own texel, its vertex may have moved but not far
+				if (textured)
+					level.texels.push_back(texels[t * 3 + k]);
+			}
+		}
+
+		level.counts.push_back((int)level.positions.size() - level.firsts.back());
+	}
+}
+
+void cocos3d::buildLODChain(const std::vector<Vec3>& positions,
+							const std::vector<Vec2>& texels,
+							const std::vector<int>& firsts,
+							const std::vector<int>& counts,
+							unsigned int levels,
+							std::vector<MeshLODLevel>& chain)
+{
+	chain.clear();
+
+	if (positions.size() < 3)
+		return;
+
+	Simplifier simplifier(positions, firsts, counts);
+
+	unsigned int triangles = simplifier.getTriangleCount();
+
+	for (unsigned int level = 0; level < levels; level++)
+	{
+		unsigned int target = (unsigned int)(triangles * MESH_LOD_RATIO);
+
+		if (target < MESH_LOD_MIN_TRIANGLES)
+			break;
+
+		simplifier.collapseTo(target);
+
+		unsigned int reached = simplifier.getTriangleCount();
+
+		//stuck on faces that would flip, the next levels would be the same
+		if (reached > (triangles + target) / 2)
+			break;
+
+		chain.push_back(MeshLODLevel());
+		simplifier.output(texels, chain.back());
+
+		triangles = reached;
+	}
+}
+
+template <class T>
+static bool writeVector(FILE* file, const std::vector<T>& values)
+{
+	unsigned int count = (unsigned int)values.size();
+
+	return fwrite(&count, sizeof(count), 1, file) == 1
+		&& (count == 0 || fwrite(&values[0], sizeof(T), count, file) == count);
+}
+
+template <class T>
+static bool readVector(const unsigned char*& data, const unsigned char* end, std::vector<T>& values)
+{
+	unsigned int count = 0;
+
+	if (end - data < (long)sizeof(count))
+		return false;
+
+	memcpy(&count, data, sizeof(count));
+	data += sizeof(count);
+
+	if ((unsigned long)(end - data) / sizeof(T) < count)
+		return false;
+
+	values.resize(count);
+
+	if (count > 0)
+		memcpy(&values[0], data, count * sizeof(T));
+
+	data += count * sizeof(T);
+
+	return true;
+}
+
+// the ranges of every group inside the level's triangles, so a draw can't read past
+// its buffers
+static bool validLevel(const MeshLODLevel& level)
+{
+	unsigned int vertexCount = (unsigned int)level.positions.size();
+
+	if (level.normals.size() != vertexCount ||
+		(!level.texels.empty() && level.texels.size() != vertexCount) ||
+		level.firsts.size() != level.counts.size())
+		return false;
+
+	for (unsigned int i = 0; i < level.firsts.size(); i++)
+	{
+		int first = level.firsts[i];
+		int count = level.counts[i];
+
+		if (first < 0 || count < 0 || count % 3 != 0 ||
+			(unsigned int)first > vertexCount || (unsigned int)count > vertexCount - first)
+			return false;
+	}
+
+	return true;
+}
+
+bool cocos3d::saveLODChain(const std::string& path, const std::vector<MeshLODLevel>& chain)
+{
+	FILE* file = fopen(path.c_str(), "wb");
+
+	if (file == NULL)
+	{
+		CCLOG("cocos3d: can't write %s", path.c_str());
+		return false;
+	}
+
+	unsigned int header[] = { LOD_FILE_MAGIC, LOD_FILE_VERSION, (unsigned int)chain.size() };
+
+	bool saved = (fwrite(header, sizeof(header), 1, file) == 1);
+
+	for (auto iter = chain.begin(); saved && iter != chain.end(); iter++)
+	{
+		saved = writeVector(file, iter->positions)
+			&& writeVector(file, iter->normals)
+			&& writeVector(file, iter->texels)
+			&& writeVector(file, iter->firsts)
+			&& writeVector(file, iter->counts);
+	}
+
+	fclose(file);
+
+	return saved;
+}
+
+bool cocos3d::loadLODChain(const std::string& path, std::vector<MeshLODLevel>& chain)
+{
+	chain.clear();
+
+	unsigned long size = 0;
+	unsigned char* data = CCFileUtils::sharedFileUtils()->getFileData(path.c_str(), "rb", &size);
+
+	if (data == NULL)
+		return false;
+
+	const unsigned char* cursor = data;
+	const unsigned char* end = data + size;
+
+	unsigned int header[3] = { 0, 0, 0 };
+
+	bool loaded = (size >= sizeof(header));
+
+	if (loaded)
+	{
+		memcpy(header, cursor, sizeof(header));
+		cursor += sizeof(header);
+
+		loaded = (header[0] == LOD_FILE_MAGIC && header[1] == LOD_FILE_VERSION);
+	}
+
+	for (unsigned int i = 0; loaded && i < header[2]; i++)
+	{
+		chain.push_back(MeshLODLevel());
+		MeshLODLevel& level = chain.back();
+
+		loaded = readVector(cursor, end, level.positions)
+			&& readVector(cursor, end, level.normals)
+			&& readVector(cursor, end, level.texels)
+			&& readVector(cursor, end, level.firsts)
+			&& readVector(cursor, end, level.counts)
+			&& validLevel(level);
+	}
+
+	delete [] data;
+
+	if (!loaded)
+	{
+		CCLOG("cocos3d: %s isn't a level of detail chain", path.c_str());
+		chain.clear();
+	}
+
+	return loaded;
+}
+
+bool cocos3d::buildLODFile(const std::string& objFile, const std::string& mtlFile, unsigned int levels)
+{
+	std::string fullPathObj = CCFileUtils::sharedFileUtils()->fullPathForFilename(objFile.c_str());
+	std::string fullPathMtl = CCFileUtils::sharedFileUtils()->fullPathForFilename(mtlFile.c_str());
+
+	OBJParser parser;
+
+	if (!parser.readFile(fullPathObj, fullPathMtl))
+		return false;
+
+	std::vector<MeshLODLevel> chain;
+	buildLODChain(parser.positions(), parser.texels(), parser.firsts(), parser.counts(), levels, chain);
+
+	for (unsigned int i = 0; i < chain.size(); i++)
+		CCLOG("cocos3d: %s level %u, %u triangles", objFile.c_str(), i + 1, (unsigned int)chain[i].positions.size() / 3);
+
+	return saveLODChain(fullPathObj + ".lod", chain);
+}
@@ -0,0 +1,50 @@
+#ifndef __MESH_SIMPLIFIER_H__
+#define __MESH_SIMPLIFIER_H__
+#include "cocos2d.h"
+#include <vector>
+#include <string>
+#include "Node3D.h"
+
+using namespace std;
+using namespace cocos2d;
+
+namespace cocos3d
+{
+	// each level keeps about this much of the triangles of the one before
+	#define MESH_LOD_RATIO 0.5f
+	// no level is made under this many triangles
+	#define MESH_LOD_MIN_TRIANGLES 64
+	// how much more the edges on a border or a material seam weigh, so outlines hold
+	#define MESH_LOD_BORDER_WEIGHT 10.0f
+
+	// one level of detail, drawn like the mesh it comes from: a triangle list with
+	// flat normals, in the same material groups (some may be empty)
+	struct MeshLODLevel
+	{
+		std::vector<Vec3> positions;
+		std::vector<Vec3> normals;
+		std::vector<Vec2> texels;
+		std::vector<int> firsts;
+		std::vector<int> counts;
+	};
+
+	// Quadric error edge collapse (Garland and Heckbert) of a triangle list, as OBJParser
+	// gives them, vertices at the same position are one. Each vertex collapses onto a
+	// neighbour, so corners keep their texel, and no collapse flips a face. Levels come
+	// out coarser one after the other, the chain stops early when a level can't get
+	// much smaller than the one before. The mesh itself isn't part of it.
+	void buildLODChain(const std::vector<Vec3>& positions,
+					   const std::vector<Vec2>& texels,
+					   const std::vector<int>& firsts,
+					   const std::vector<int>& counts,
+					   unsigned int levels,
+					   std::vector<MeshLODLevel>& chain);
+
+	// a chain built offline, Model loads <obj file>.lod when it's next to the obj
+	bool saveLODChain(const std::string& path, const std::vector<MeshLODLevel>& chain);
+	bool loadLODChain(const std::string& path, std::vector<MeshLODLevel>& chain);
+
+	// offline tool: parses the obj and saves its chain to <obj file>.lod
+	bool buildLODFile(const std::string& objFile, const std::string& mtlFile, unsigned int levels);
+}
+#endif
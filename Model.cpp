@@ -5,43 +5,111 @@
 #include "shaders.h"
 #include "Scene3D.h"
 #include "VBOCache.h"
+#include "MeshOptimizer.h"
+#include "RestoreManager.h"
 #include "OBJParser.h"
+#include "FrameAtlas.h"
+#include "MaterialAtlas.h"
+#include "CompressedTexture.h"
+#include "TextureLoader.h"
+#include "GLCapabilities.h"
+#include "ResidencyManager.h"
+#include "Impostor.h"
 #include <limits>
+#include <algorithm>
 
 using namespace cocos3d;
 
+static bool s_asyncTextureLoading = false;
+static unsigned int s_lodLevels = 0;
+static bool s_quantizedVertices = false;
+
+struct TriangleStats
+{
+	unsigned int frame;
+	unsigned int submitted, fullDetail;
+	unsigned int lastSubmitted, lastFullDetail;
+};
+
+static TriangleStats s_triangleStats = { 0, 0, 0, 0, 0 };
+
+static void countTriangles(unsigned int submitted, unsigned int fullDetail)
+{
+	unsigned int frame = CCDirector::sharedDirector()->getTotalFrames();
+
+	if (frame != s_triangleStats.frame)
+	{
+		bool previous = (frame == s_triangleStats.frame + 1);
+
+		s_triangleStats.lastSubmitted = previous ? s_triangleStats.submitted : 0;
+		s_triangleStats.lastFullDetail = previous ? s_triangleStats.fullDetail : 0;
+		s_triangleStats.submitted = s_triangleStats.fullDetail = 0;
+		s_triangleStats.frame = frame;
+	}
+
+	s_triangleStats.submitted += submitted;
+	s_triangleStats.fullDetail += fullDetail;
+}
+
+#define INVALID_SHADER_FEATURES 0xFFFFFFFF
+
 Model::Model()
 : Node3D()
-, m_opacity(1.0f)
-, m_lines(false)
-, m_pVBO(0)
-, m_tVBO(0)
-, m_nVBO(0)
-, m_lightsAmbience(NULL)
+, m_animationAtlas(NULL)
+, m_textureRequest(NULL)
+, m_currentTexture(-1)
+, m_textureDt(0.0f)
+, m_textureAt(0.0f)
+, m_textureToAlpha(false)
+, m_streamed(false)
+, m_resident(true)
+, m_hasBounds(false)
+, m_residency(NULL)
+, m_impostor(NULL)
+, m_impostorDistance(0)
+, m_impostorLights(0)
+, m_impostorDrawn(false)
+, m_quantize(false)
+, m_quantized(false)
+, m_program(NULL)
+, m_shaderFeatures(INVALID_SHADER_FEATURES)
 , m_lightsDiffuses(NULL)
+, m_lightsAmbience(NULL)
 , m_lightsPositions(NULL)
-, m_lightsIntensity(NULL)
+, m_lightsAttenuation(NULL)
+, m_selectedLightsVersion(0)
+, m_selectedLightsRadius(0)
+, m_lightsSelected(false)
+, m_customLights(false)
 , m_lightsEnabled(NULL)
-, m_defaultLightUsed(false)
-, m_lightsToSet(false)
-, m_drawOBB(false)
+, m_lightsIntensity(NULL)
+, m_pVBO(0)
+, m_tVBO(0)
+, m_nVBO(0)
+, m_edgesIBO(0)
+, m_lod(0)
+, m_lodScreenSize(MODEL_LOD_SCREEN_SIZE)
+, m_triangleCount(0)
+, m_normalLocation(-1)
 , m_culling(true)
+, m_cullBackFace(true)
 , m_shadowMapSet(false)
-, m_textured(false)
-, m_shineMode(NO_SHINE)
-, m_customLights(false)
+, m_lines(false)
+, m_drawOBB(false)
+, m_defaultLightUsed(false)
+, m_lightsToSet(false)
 , m_dirtyCheck(false)
-, m_currentTexture(-1)
-, m_textureDt(0.0f)
-, m_textureAt(0.0f)
-, m_textureToAlpha(false)
-, m_cullBackFace(true)
+, m_shineMode(NO_SHINE)
+, m_opacity(1.0f)
+, m_meshScale(1, 1, 1)
+, m_textured(false)
 , m_nframes(0)
 , m_currentFrame(0)
 {
 	m_lightsAmbience = new Vec3[Light::maxLights]();
 	m_lightsDiffuses = new Vec3[Light::maxLights]();
 	m_lightsPositions = new Vec3[Light::maxLights]();
+	m_lightsAttenuation = new Vec3[Light::maxLights]();
 	m_lightsIntensity = new float[Light::maxLights]();
 	m_lightsEnabled = new bool[Light::maxLights]();
 }
@@ -51,8 +119,12 @@ Model::~Model()
 	delete [] m_lightsAmbience;
 	delete [] m_lightsDiffuses;
 	delete [] m_lightsPositions;
+	delete [] m_lightsAttenuation;
 	delete [] m_lightsIntensity;
 	delete [] m_lightsEnabled;
+
+	if (m_residency != NULL)
+		m_residency->removeModel(this);
 	
 	if (m_animationTextures.size() > 0)
 	{
@@ -64,8 +136,16 @@ Model::~Model()
 		}
 	}
 
+	CC_SAFE_RELEASE(m_animationAtlas);
+	CC_SAFE_RELEASE(m_textureRequest);
+	CC_SAFE_RELEASE(m_impostor);
+
 	if (m_dTexture != NULL)
 		m_dTexture->release();
+
+#if CC_ENABLE_CACHE_TEXTURE_DATA
+	RestoreManager::sharedRestoreManager()->removeNode(this);
+#endif
 }
 
 Model* Model::createWithFiles(const std::string& id,
@@ -110,23 +190,65 @@ Model* Model::createWithBuffers(const std::string& id,
 	}
 }
 
+Model* Model::createStreamed(const std::string& id,
+							 const std::string& objFile,
+							 const std::string& mtlFile,
+							 float scale,
+							 const std::string& texture)
+{
+	Model *pRet = new Model();
+	if (pRet && pRet->initStreamed(id,objFile,mtlFile,scale,texture))
+	{
+		pRet->autorelease();
+		return pRet;
+	}
+	else
+	{
+		delete pRet;
+		pRet = NULL;
+		return NULL;
+	}
+}
+
 bool Model::initWithFiles(const std::string& id,
 						  const std::string& objFile, 
 						  const std::string& mtlFile, 
 						  float scale, 
 						  const std::string& texture)
 {
-	m_id = id;
+	m_id = m_meshId = id;
 	m_scale = scale;
+	m_quantize = s_quantizedVertices;
 	
+	MaterialAtlas::Entry atlasEntry;
+	bool atlased = (texture != "" && MaterialAtlas::sharedMaterialAtlas()->getEntry(texture, &atlasEntry));
+
+	if (atlased)
+	{
+		m_dTexture = NULL;
+	}
+	else
+	if (CompressedTexture::isCompressedFile(texture))
+	{
+		m_dTexture = CompressedTexture::textureForFile(texture);
+		CC_SAFE_RETAIN(m_dTexture);
+	}
+	else
 	if (texture != "")
+	{
 		m_dTexture = CCTextureCache::sharedTextureCache()->addImage(texture.c_str());
+	}
 	else
+	{
 		m_dTexture = NULL;
+	}
 
 	std::string fullPathObj = CCFileUtils::sharedFileUtils()->fullPathForFilename(objFile.c_str());
 	std::string fullPathMtl = CCFileUtils::sharedFileUtils()->fullPathForFilename(mtlFile.c_str());
 
+	//where its offline level of detail chain would be
+	m_objFile = fullPathObj;
+
 	OBJParser* parser = new OBJParser;
 
 	bool pRet = parser->readFile(fullPathObj, fullPathMtl, scale);
@@ -135,34 +257,15 @@ bool Model::initWithFiles(const std::string& id,
 	{
 		fillVectors(parser);
 
-		m_program = CCShaderCache::sharedShaderCache()->programForKey(PHONG_SHADER_KEY);
-
-		if (m_program == NULL)
-		{
-			m_program = new CCGLProgram();
-
-			if (m_dTexture == NULL || m_texels.size() == 0)
-			{
-				MESH_INIT_PHONG(m_program);
-				CCShaderCache::sharedShaderCache()->addProgram(m_program, PHONG_SHADER_KEY);
-			}
-			else
-			{
-				MESH_INIT_PHONG_TEXTURE(m_program);
-				CCShaderCache::sharedShaderCache()->addProgram(m_program, PHONG_SHADER_TEXTURE_KEY);
-				m_textured = true;
-			}
-		}
+		if (atlased)
+			useAtlasEntry(texture, atlasEntry);
 
-		setShaderProgram(m_program);
+		m_textured = (m_texels.size() > 0 && m_dTexture != NULL);
 
+		updateShaderProgram();
 		generateVBOs();
-		initShaderLocations();
 #if CC_ENABLE_CACHE_TEXTURE_DATA
-		CCNotificationCenter::sharedNotificationCenter()->addObserver(this,
-			callfuncO_selector(Model::listenBackToForeground),
-			EVENT_COME_TO_FOREGROUND,
-			NULL);
+		RestoreManager::sharedRestoreManager()->addNode(this);
 #endif
 	}
 	else
@@ -182,13 +285,36 @@ bool Model::initWithBuffers(const std::string& id,
 							const char* textureBuffer, 
 							unsigned long size)
 {
-	m_id = id;
+	m_id = m_meshId = id;
 	m_scale = scale;
+	m_quantize = s_quantizedVertices;
 
+	MaterialAtlas::Entry atlasEntry;
+	bool atlased = (textureName != "" && MaterialAtlas::sharedMaterialAtlas()->getEntry(textureName, &atlasEntry));
+
+	if (atlased)
+	{
+		m_dTexture = NULL;
+	}
+	else
+	if (CompressedTexture::isCompressedFile(textureName) && textureBuffer != NULL)
+	{
+		//uploaded as it is, mip levels included
+		m_dTexture = CompressedTexture::textureForData(textureName, (const unsigned char*)textureBuffer, size);
+		CC_SAFE_RETAIN(m_dTexture);
+	}
+	else
 	if (textureName != "")
 	{
 		m_dTexture = CCTextureCache::sharedTextureCache()->textureForKey(textureName.c_str());
 
+		if (m_dTexture == NULL && s_asyncTextureLoading && textureBuffer != NULL)
+		{
+			//decoded and mipmapped off the gl thread, the model waits for it before drawing
+			m_textureRequest = TextureLoader::sharedTextureLoader()->loadAsync(textureName, textureBuffer, size);
+			m_textureRequest->retain();
+		}
+		else
 		if (m_dTexture == NULL)
 		{
 		
@@ -203,17 +329,14 @@ bool Model::initWithBuffers(const std::string& id,
 
 				m_dTexture->retain();
 
-				std::string glExts = std::string((const char*)glGetString(GL_EXTENSIONS));
+				GLfloat maxAnisotropy = GLCapabilities::sharedGLCapabilities()->getMaxAnisotropy();
 
-				if (glExts.find("GL_EXT_texture_filter_anisotropic") != std::string::npos)
+				if (maxAnisotropy > 0)
 				{
 #if (CC_TARGET_PLATFORM == CC_PLATFORM_IOS)
 					m_dTexture->setAntiAliasTexParameters();
 #endif
-					GLfloat maxLevel;
-
-					glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &maxLevel);
-					glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, maxLevel);
+					glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, maxAnisotropy);
 				}
 			}
 		}
@@ -230,39 +353,16 @@ bool Model::initWithBuffers(const std::string& id,
     if (pRet)
     {
 		fillVectors(parser);
-		
-		m_textured = (m_texels.size() > 0 && m_dTexture != NULL);
 
-        m_program = 
-			m_textured ? CCShaderCache::sharedShaderCache()->programForKey(PHONG_SHADER_TEXTURE_KEY)
-						: CCShaderCache::sharedShaderCache()->programForKey(PHONG_SHADER_KEY);
-
-        if (m_program == NULL)
-        {
-            m_program = new CCGLProgram();
-            
-			if (!m_textured)
-			{
-				MESH_INIT_PHONG(m_program);
-				CCShaderCache::sharedShaderCache()->addProgram(m_program, PHONG_SHADER_KEY);
-			}
-			else
-			{
-				MESH_INIT_PHONG_TEXTURE(m_program);
-				CCShaderCache::sharedShaderCache()->addProgram(m_program, PHONG_SHADER_TEXTURE_KEY);
-			}
-        }
-
-
-		setShaderProgram(m_program);
+		if (atlased)
+			useAtlasEntry(textureName, atlasEntry);
+		
+		m_textured = (m_texels.size() > 0 && (m_dTexture != NULL || m_textureRequest != NULL));
 
+		updateShaderProgram();
 		generateVBOs();
-		initShaderLocations();
 #if CC_ENABLE_CACHE_TEXTURE_DATA
-		CCNotificationCenter::sharedNotificationCenter()->addObserver(this,
-			callfuncO_selector(Model::listenBackToForeground),
-			EVENT_COME_TO_FOREGROUND,
-			NULL);
+		RestoreManager::sharedRestoreManager()->addNode(this);
 #endif
     }
 	else
@@ -273,35 +373,113 @@ bool Model::initWithBuffers(const std::string& id,
 	return pRet && Node3D::init();
 }
 
-void Model::listenBackToForeground(CCObject *obj)
+bool Model::initStreamed(const std::string& id,
+						 const std::string& objFile,
+						 const std::string& mtlFile,
+						 float scale,
+						 const std::string& texture)
 {
-	m_program = new CCGLProgram();
+	m_id = m_meshId = id;
+	m_scale = scale;
+	m_quantize = s_quantizedVertices;
+	m_dTexture = NULL;
 
-	if (m_textured && !m_textureToAlpha)
-	{
-		MESH_INIT_PHONG_TEXTURE(m_program);
-		CCShaderCache::sharedShaderCache()->addProgram(m_program, PHONG_SHADER_TEXTURE_KEY);
-	}
+	m_objFile = CCFileUtils::sharedFileUtils()->fullPathForFilename(objFile.c_str());
+	m_mtlFile = CCFileUtils::sharedFileUtils()->fullPathForFilename(mtlFile.c_str());
+	m_textureFile = texture;
+
+	m_streamed = true;
+	m_resident = false;
+
+	//no bounds until the mesh is parsed the first time
+	m_radius = 0;
+	kmVec3Fill(&(m_aabb.min), 0, 0, 0);
+	kmVec3Fill(&(m_aabb.max), 0, 0, 0);
+
+	//drawn from the start, that's how it finds the layer streaming it
+	updateShaderProgram();
+
+	return Node3D::init();
+}
+
+void Model::onExit()
+{
+	if (m_residency != NULL)
+		m_residency->removeModel(this);
+
+	Node3D::onExit();
+}
+
+void Model::restoreGLState()
+{
+	//already rebuilt by the RestoreManager
+	m_program = phongProgramForFeatures(m_shaderFeatures);
+
+	setShaderProgram(m_program);
+	generateVBOs();
+
+	m_program->use();
+
+	m_shaderLocations.clear();
+	initShaderLocations();
+
+	m_lightsToSet = true;
+
+	//rendered again the next time it's drawn
+	if (m_impostor != NULL)
+		m_impostor->restoreGLState();
+}
+
+unsigned int Model::shaderFeatures()
+{
+	unsigned int features = 0;
+
+	if (m_shineMode == SHINE_SPECULAR)
+		features |= PHONG_SHINE_SPECULAR;
 	else
-	if (m_textureToAlpha)
+	if (m_shineMode == SHINE_LAMBERTIAN)
+		features |= PHONG_SHINE_LAMBERTIAN;
+
+	if (m_textured)
 	{
-		MESH_INIT_PHONG_TEXTURE_TO_ALPHA(m_program);
-		CCShaderCache::sharedShaderCache()->addProgram(m_program, PHONG_SHADER_TEXTURE_TO_ALPHA_KEY);
+		features |= PHONG_TEXTURE;
+
+		if (m_textureToAlpha)
+			features |= PHONG_TEXTURE_TO_ALPHA;
+
+		if (m_animationAtlas != NULL)
+			features |= PHONG_TEXTURE_ATLAS;
 	}
+
+	//lights are only known on the first draw, until then assume all of them
+	if (m_shaderFeatures == INVALID_SHADER_FEATURES)
+		features |= PHONG_LIGHTS(Light::maxLights);
 	else
-	{
-		MESH_INIT_PHONG(m_program);
-		CCShaderCache::sharedShaderCache()->addProgram(m_program, PHONG_SHADER_KEY);
-	}
+		features |= PHONG_LIGHTS(lightCount());
 
-	if (VBOCache::sharedVBOCache()->cacheIsInvalid())
-		VBOCache::sharedVBOCache()->purgeCache();
+	if (getShadowMap() != NULL)
+		features |= PHONG_SHADOWS;
 
-	setShaderProgram(m_program);
-	generateVBOs();
+	if (m_quantized)
+		features |= PHONG_QUANTIZED;
+
+	return features;
+}
+
+void Model::updateShaderProgram()
+{
+	unsigned int features = shaderFeatures();
+
+	if (features == m_shaderFeatures)
+		return;
+
+	m_shaderFeatures = features;
+	m_program = phongProgramForFeatures(features);
 
+	setShaderProgram(m_program);
 	m_program->use();
 
+	m_shaderLocations.clear();
 	initShaderLocations();
 
 	m_lightsToSet = true;
@@ -320,32 +498,211 @@ void Model::fillVectors(MeshParser* parser)
 	m_aabb = parser->getAABB();
 	m_radius = parser->getRadius();
 
+	m_triangleCount = 0;
+
+	for (auto iter = m_counts.begin(); iter != m_counts.end(); iter++)
+		m_triangleCount += *iter / 3;
+
 	delete parser;
 }
 
+void Model::useAtlasEntry(const std::string& texture, const MaterialAtlas::Entry& entry)
+{
+	bool repeats = false;
+
+	for (auto iter = m_texels.begin(); iter != m_texels.end(); iter++)
+	{
+		repeats = repeats || iter->x < 0 || iter->x > 1 || iter->y < 0 || iter->y > 1;
+
+		iter->x = iter->x * entry.scaleU + entry.offsetU;
+		iter->y = iter->y * entry.scaleV + entry.offsetV;
+	}
+
+	if (repeats)
+		CCLOG("cocos3d: %s repeats %s, it bleeds into its atlas neighbours", m_id.c_str(), texture.c_str());
+
+	//the texels are moved into the page, the buffers can't be shared with the same mesh unpacked
+	m_meshId += "@" + texture;
+
+	m_dTexture = entry.page;
+	m_dTexture->retain();
+}
+
 void Model::generateVBOs()
 {
 	VBOCache* cache = VBOCache::sharedVBOCache();
 
-	if (!cache->getVBO(m_id, &m_pVBO, &m_nVBO, &m_tVBO))
-		cache->addDataToVBOs(m_id, m_vertices, m_normals, m_texels);
+	if (!cache->getVBO(m_meshId, &m_pVBO, &m_nVBO, &m_tVBO))
+	{
+		if (m_quantize)
+		{
+			VertexQuantization quantization;
+			QuantizedVertices vertices;
+
+			computeQuantization(m_vertices, m_texels, quantization);
+			quantizeVertices(m_vertices, m_normals, m_texels, quantization, vertices);
+
+			cache->addQuantizedDataToVBOs(m_meshId, vertices, quantization);
+		}
+		else
+		{
+			cache->addDataToVBOs(m_meshId, m_vertices, m_normals, m_texels);
+		}
+	}
+
+	//drawn in the format of the cached mesh, whichever model uploaded it
+	m_quantized = cache->getQuantization(m_meshId, &m_quantization);
+
+	if (m_quantized)
+		dequantizationMatrix(m_quantization, &m_matrixDequantize);
+
+	m_edgesIBO = 0;
+
+	generateLODs();
+
+	if (m_lines)
+		generateEdges();
 
 #if !CC_ENABLE_CACHE_TEXTURE_DATA
+	//lines turned on later draw the triangles' sides, unless another model with the
+	//mesh built its edges
 	m_vertices.clear();
 	m_normals.clear();
 #endif
 }
 
+void Model::generateLODs()
+{
+	VBOCache* cache = VBOCache::sharedVBOCache();
+
+	m_lod = 0;
+
+	if (cache->getLODs(m_meshId, &m_lods))
+		return;
+
+	//the texels of an offline chain aren't moved into an atlas page
+	std::string lodFile = m_objFile + ".lod";
+	bool offline = (m_lodChain.empty() && m_objFile != "" && m_meshId == m_id
+					&& CCFileUtils::sharedFileUtils()->isFileExist(lodFile));
+
+	if (offline && loadLODChain(lodFile, m_lodChain))
+	{
+		//a level is drawn a group at a time like the mesh
+		for (auto iter = m_lodChain.begin(); iter != m_lodChain.end(); iter++)
+		{
+			if (iter->counts.size() != m_counts.size())
+			{
+				CCLOG("cocos3d: %s doesn't have the groups of %s", lodFile.c_str(), m_objFile.c_str());
+				m_lodChain.clear();
+				break;
+			}
+		}
+	}
+
+	if (m_lodChain.empty() && s_lodLevels > 0 && !m_vertices.empty())
+		buildLODChain(m_vertices, m_texels, m_firsts, m_counts, s_lodLevels, m_lodChain);
+
+	cache->addLODs(m_meshId, m_lodChain);
+	cache->getLODs(m_meshId, &m_lods);
+
+#if !CC_ENABLE_CACHE_TEXTURE_DATA
+	//uploaded for good, nothing to restore them for
+	std::vector<MeshLODLevel>().swap(m_lodChain);
+#endif
+}
+
+unsigned int Model::lodForSize(float size)
+{
+	//the triangles keeping the density the full mesh has at the screen size
+	float ratio = size / m_lodScreenSize;
+	float wanted = m_triangleCount * ratio * ratio;
+
+	unsigned int level = 0;
+
+	while (level < m_lods.size() && m_lods[level].triangles >= wanted)
+		level++;
+
+	return level;
+}
+
+void Model::selectLOD()
+{
+	//the wireframe edges are the full mesh's
+	if (m_lods.empty() || m_lines)
+	{
+		m_lod = 0;
+		return;
+	}
+
+	const kmMat4& projection = ((Layer3D*)m_pParent)->get3DCamera()->getProjectionMatrix();
+
+	float radius = getRadius();
+	float depth = -m_matrixMV.mat[14];
+	float height = CCDirector::sharedDirector()->getWinSizeInPixels().height;
+
+	//projected diameter in pixels
+	float size;
+
+	if (projection.mat[11] == 0)
+		size = radius * projection.mat[5] * height;
+	else
+	if (depth > radius)
+		size = radius * projection.mat[5] / depth * height;
+	else
+		size = m_lodScreenSize;
+
+	unsigned int level = lodForSize(size);
+
+	//coarser only once it's clearly smaller, so it doesn't flicker on the threshold
+	if (level > m_lod)
+		level = MAX(m_lod, lodForSize(size / MODEL_LOD_HYSTERESIS));
+
+	m_lod = level;
+}
+
+void Model::generateEdges()
+{
+	VBOCache* cache = VBOCache::sharedVBOCache();
+
+	if (cache->getEdges(m_meshId, &m_edgesIBO, &m_edgeFirsts, &m_edgeCounts))
+		return;
+
+	if (m_vertices.empty())
+		return;
+
+	std::vector<unsigned int> triangles, edges;
+	std::vector<int> firsts, counts, edgeFirsts, edgeCounts;
+
+	edgeTriangles(triangles, firsts, counts);
+	buildEdgeIndices(triangles, firsts, counts, edges, edgeFirsts, edgeCounts);
+
+	if (cache->addEdges(m_meshId, edges, edgeFirsts, edgeCounts))
+		cache->getEdges(m_meshId, &m_edgesIBO, &m_edgeFirsts, &m_edgeCounts);
+}
+
+void Model::edgeTriangles(std::vector<unsigned int>& triangles, std::vector<int>& firsts, std::vector<int>& counts)
+{
+	//vertices at the same position are one, so the edges between faces come out once
+	weldVertices(m_vertices, triangles);
+
+	firsts = m_firsts;
+	counts = m_counts;
+}
+
 void Model::initShaderLocations()
 {
 #define SETUP_LOCATION(name) m_shaderLocations[name] = getShaderProgram()->getUniformLocationForName(name);
 
 	//lights
+#if (CC_TARGET_PLATFORM == CC_PLATFORM_WP8)
+	//only the precompiled programs loop over every slot, the permutations stop at NUM_LIGHTS
 	SETUP_LOCATION("uLightEnabled");
+#endif
 	SETUP_LOCATION("uLightAmbience");
 	SETUP_LOCATION("uLightDiffuse");
 	SETUP_LOCATION("uLightPosition");
 	SETUP_LOCATION("uLightIntensity");
+	SETUP_LOCATION("uLightAttenuation");
 
 	//matrices
 	SETUP_LOCATION("CC_MVPMatrix");
@@ -373,10 +730,22 @@ void Model::initShaderLocations()
 	{
 		SETUP_LOCATION("uTexture");
 		glUniform1i(m_shaderLocations["uTexture"], textureId++);
+
+		if (m_animationAtlas != NULL)
+			SETUP_LOCATION("uTexCoordTransform");
 	}
 
 	glUniform1i(m_shaderLocations["uShadowMap"], textureId);
 	glUniform1i(m_shaderLocations["uShadowMapEnabled"], (GLint)false);
+
+	if (m_textureToAlpha)
+		SETUP_LOCATION("uAccTime");
+
+	if (m_quantized)
+		SETUP_LOCATION("uTexelRange");
+
+	//bound to kCCVertexAttrib_Normals, except for the precompiled programs
+	m_normalLocation = glGetAttribLocation(getShaderProgram()->getProgram(), "a_normal");
 }
 
 void Model::setScale(float scale)
@@ -389,11 +758,25 @@ void Model::clearLights()
 	memset(m_lightsAmbience,0,sizeof(Vec3)*Light::maxLights);
 	memset(m_lightsDiffuses, 0, sizeof(Vec3)*Light::maxLights);
 	memset(m_lightsPositions, 0, sizeof(Vec3)*Light::maxLights);
+	std::fill(m_lightsAttenuation, m_lightsAttenuation + Light::maxLights, Vec3(0, 0, 0));
 	memset(m_lightsEnabled, 0, sizeof(bool)*Light::maxLights);
 	memset(m_lightsIntensity, 0, sizeof(float)*Light::maxLights);
 }
 
-void Model::setupLights()
+int Model::lightCount()
+{
+	int count = 0;
+
+	for (int i = 0; i < Light::maxLights; i++)
+	{
+		if (m_lightsEnabled[i])
+			count++;
+	}
+
+	return count;
+}
+
+void Model::updateLights()
 {
 	Layer3D* parent = (Layer3D*)m_pParent;
 
@@ -415,6 +798,7 @@ void Model::setupLights()
 		m_lightsDiffuses[0] = diffuse;
 		m_lightsIntensity[0] = 1.0f;
 		m_lightsPositions[0] = position;
+		m_lightsAttenuation[0] = Vec3(1, 0, 0);
 		m_lightsEnabled[0] = true;
 		
 		Vec3 ambient2(0, 0, 0.7f);
@@ -425,6 +809,7 @@ void Model::setupLights()
 		m_lightsDiffuses[1] = diffuse2;
 		m_lightsIntensity[1] = 0.3f;
 		m_lightsPositions[1] = position2;
+		m_lightsAttenuation[1] = Vec3(1, 0, 0);
 		m_lightsEnabled[1] = true;
 
 		m_defaultLightUsed = true;
@@ -434,47 +819,82 @@ void Model::setupLights()
 		parent->cleanDirtyLights();
 	}
 	else
-	if (parent->lightsDirty() && !m_customLights)
+	if (parent->hasLights() && !m_customLights)
 	{
+		const Vec3& center = get3DPosition();
+		float radius = getRadius();
+
+		//only the most influential lights around this model reach the shader, picked
+		//again when the model or the lights moved
+		if (!m_lightsSelected
+			|| m_selectedLightsVersion != parent->getLightsVersion()
+			|| m_selectedLightsCenter.x != center.x
+			|| m_selectedLightsCenter.y != center.y
+			|| m_selectedLightsCenter.z != center.z
+			|| m_selectedLightsRadius != radius)
+		{
+			parent->getLightsForNode(this, Light::maxLights, m_selectedLights);
+
+			m_selectedLightsVersion = parent->getLightsVersion();
+			m_selectedLightsCenter = center;
+			m_selectedLightsRadius = radius;
+			m_lightsSelected = true;
+		}
+
 		m_defaultLightUsed = false;
 
 		m_lightsToSet = true;
 
-		auto lights = parent->getLights();
+		//colors and intensities change without moving the lights, they're copied every draw
+		auto& lights = m_selectedLights;
 
 		clearLights();
 
+		//the shader lights the first lightCount() slots, the disabled lights take none
 		int i = 0;
 
-		for (auto iter = lights.begin(); i < Light::maxLights; i++)
+		for (auto iter = lights.begin(); iter != lights.end() && i < Light::maxLights; iter++)
 		{
-			if (i < (int)lights.size() && iter != lights.end())
-			{
-				Light* light = *iter;
+			Light* light = *iter;
 
-				m_lightsAmbience[i] = light->getAmbient(); 
-				m_lightsDiffuses[i] = light->getDiffuse();
-				m_lightsIntensity[i] = light->getIntensity();
+			if (!light->isEnabled())
+				continue;
 
-				m_lightsPositions[i].x = light->get3DPosition().x ;
-				m_lightsPositions[i].y = light->get3DPosition().y;
-				m_lightsPositions[i].z = light->get3DPosition().z;
+			m_lightsAmbience[i] = light->getAmbient(); 
+			m_lightsDiffuses[i] = light->getDiffuse();
+			m_lightsIntensity[i] = light->getIntensity();
 
-				if (light->isEnabled())
-					m_lightsEnabled[i] = true;
+			m_lightsPositions[i].x = light->get3DPosition().x ;
+			m_lightsPositions[i].y = light->get3DPosition().y;
+			m_lightsPositions[i].z = light->get3DPosition().z;
 
-				iter++;
-			}
+			//the falloff the light was selected by, so it fades out before its range
+			m_lightsAttenuation[i] = light->getAttenuation();
+
+			m_lightsEnabled[i] = true;
+
+			i++;
 		}
  	}
+}
 
+void Model::setupLights()
+{
 	if (m_lightsToSet || true)
 	{
-		glUniform1iv(m_shaderLocations["uLightEnabled"], Light::maxLights, (GLint*)m_lightsEnabled);
+#if (CC_TARGET_PLATFORM == CC_PLATFORM_WP8)
+		GLint enabled[Light::maxLights];
+
+		for (int i = 0; i < Light::maxLights; i++)
+			enabled[i] = m_lightsEnabled[i];
+
+		glUniform1iv(m_shaderLocations["uLightEnabled"], Light::maxLights, enabled);
+#endif
 		glUniform3fv(m_shaderLocations["uLightAmbience"], Light::maxLights, (GLfloat*)m_lightsAmbience);
 		glUniform3fv(m_shaderLocations["uLightDiffuse"], Light::maxLights, (GLfloat*)m_lightsDiffuses);
 		glUniform3fv(m_shaderLocations["uLightPosition"], Light::maxLights, (GLfloat*)m_lightsPositions);
 		glUniform1fv(m_shaderLocations["uLightIntensity"],  Light::maxLights, (GLfloat*)m_lightsIntensity);
+		glUniform3fv(m_shaderLocations["uLightAttenuation"], Light::maxLights, (GLfloat*)m_lightsAttenuation);
 	}
 
 	m_lightsToSet = false;
@@ -482,45 +902,95 @@ void Model::setupLights()
 
 void Model::setupAttribs()
 {
+	GLuint pVBO = m_pVBO, nVBO = m_nVBO, tVBO = m_tVBO;
+
+	if (m_lod > 0)
+	{
+		pVBO = m_lods[m_lod - 1].vertex;
+		nVBO = m_lods[m_lod - 1].normal;
+		tVBO = m_lods[m_lod - 1].texel;
+	}
+
+	//whatever drew before may have left only some of them on
+	unsigned int attribs = kCCVertexAttribFlag_Position;
+
+	if (m_textured)
+		attribs |= kCCVertexAttribFlag_TexCoords;
+
+	//a precompiled program may have the normals where cocos keeps track of them
+	if (m_normalLocation >= 0 && m_normalLocation < kCCVertexAttrib_MAX)
+		attribs |= 1 << m_normalLocation;
+
+	ccGLEnableVertexAttribs(attribs);
+
+	if (m_normalLocation >= kCCVertexAttrib_MAX)
+		glEnableVertexAttribArray(m_normalLocation);
+
+	//unsigned normalized shorts, always in buffers (see QuantizedVertices)
+	if (m_quantized)
+	{
+		if (m_textured)
+		{
+			glBindBuffer(GL_ARRAY_BUFFER, tVBO);
+			glVertexAttribPointer(kCCVertexAttrib_TexCoords, 2, GL_UNSIGNED_SHORT, GL_TRUE, 0, 0);
+		}
+
+		glBindBuffer(GL_ARRAY_BUFFER, nVBO);
+		glVertexAttribPointer(m_normalLocation, 2, GL_UNSIGNED_SHORT, GL_TRUE, 0, 0);
+
+		glBindBuffer(GL_ARRAY_BUFFER, pVBO);
+		glVertexAttribPointer(kCCVertexAttrib_Position, 3, GL_UNSIGNED_SHORT, GL_TRUE, QUANTIZED_POSITION_COMPONENTS * sizeof(GLushort), 0);
+
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		return;
+	}
+
 	//setup texels or vertices for textures
 	if (m_textured)
 	{
-		if (m_tVBO == 0)
+		if (tVBO == 0)
 		{
 			glVertexAttribPointer(kCCVertexAttrib_TexCoords, 2, GL_FLOAT, GL_FALSE, 0, &(m_texels[0]));
 		}
 		else
 		{
-			glBindBuffer(GL_ARRAY_BUFFER, m_tVBO);
+			glBindBuffer(GL_ARRAY_BUFFER, tVBO);
 			glVertexAttribPointer(kCCVertexAttrib_TexCoords, 2, GL_FLOAT, GL_FALSE, 0, 0);
 			glBindBuffer(GL_ARRAY_BUFFER, 0);
 		}
 	}
 
-	if (m_nVBO == 0)
+	if (nVBO == 0)
 	{
-		glVertexAttribPointer(glGetAttribLocation(getShaderProgram()->getProgram(), "a_normal"), 3, GL_FLOAT, GL_FALSE, 0, &(m_normals[0]));
+		glVertexAttribPointer(m_normalLocation, 3, GL_FLOAT, GL_FALSE, 0, &(m_normals[0]));
 	}
 	else
 	{
-		glBindBuffer(GL_ARRAY_BUFFER, m_nVBO);
-		glVertexAttribPointer(glGetAttribLocation(getShaderProgram()->getProgram(), "a_normal"), 3, GL_FLOAT, GL_FALSE, 0, 0);
+		glBindBuffer(GL_ARRAY_BUFFER, nVBO);
+		glVertexAttribPointer(m_normalLocation, 3, GL_FLOAT, GL_FALSE, 0, 0);
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
 	}
 	
 	//vertices as shader attributes
-	if (m_pVBO == 0)
+	if (pVBO == 0)
 	{
 		glVertexAttribPointer(kCCVertexAttrib_Position, 3, GL_FLOAT, GL_FALSE, 0, &(m_vertices[0]));
 	}
 	else
 	{
-		glBindBuffer(GL_ARRAY_BUFFER, m_pVBO);
+		glBindBuffer(GL_ARRAY_BUFFER, pVBO);
 		glVertexAttribPointer(kCCVertexAttrib_Position, 3, GL_FLOAT, GL_FALSE, 0, 0);
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
 	}
 }
 
+void Model::disableAttribs()
+{
+	//cocos doesn't know about this one, an array left on would still be read by its draws
+	if (m_normalLocation >= kCCVertexAttrib_MAX)
+		glDisableVertexAttribArray(m_normalLocation);
+}
+
 void Model::transformAABB(const kmAABB& box)
 {
 	kmVec3 v[8];
@@ -601,7 +1071,7 @@ void CGAffineToGL(const CCAffineTransform *t, GLfloat *m)
 	m[1] = t->b; m[5] = t->d; m[13] = t->ty;
 }
 
-void Model::setupMatrices()
+void Model::updateMatrices()
 {
 	Layer3D* parent = dynamic_cast<Layer3D*>(m_pParent);
 
@@ -621,13 +1091,14 @@ void Model::setupMatrices()
 		kmMat4RotationQuaternion(&rotation, &quat);
 		kmMat4Multiply(&translation,&translation,&rotation);
 		kmMat4Multiply(&m_matrixM, &m_matrixM, &translation);
-		kmMat4Scaling(&scale, m_scale, m_scale, m_scale);
+		kmMat4Scaling(&scale, m_scale*m_meshScale.x, m_scale*m_meshScale.y, m_scale*m_meshScale.z);
 		kmMat4Multiply(&m_matrixM, &m_matrixM, &scale);
 	
 		const kmMat4 matrixP = parent->get3DCamera()->getProjectionMatrix();	
 		
 		//model view matrix
-		kmMat4Multiply(&m_matrixMV, &(parent->get3DCamera()->getViewMatrix()), &m_matrixM);
+		m_matrixV = parent->get3DCamera()->getViewMatrix();
+		kmMat4Multiply(&m_matrixMV, &m_matrixV, &m_matrixM);
 
 		//normal matrix
 		kmMat4Inverse(&m_matrixNormal, &m_matrixM);
@@ -638,17 +1109,47 @@ void Model::setupMatrices()
 
 		transformAABB(m_aabb);
 	}
+}
+
+void Model::setupMatrices()
+{
+	Layer3D* parent = dynamic_cast<Layer3D*>(m_pParent);
+
+	CC_ASSERT(parent != NULL);
 
 	//kmMat4 transform4x4;
 	//CCAffineTransform tmpAffine = parent->getParent()->nodeToParentTransform();
 	//CGAffineToGL(&tmpAffine, transform4x4.mat);
 	//kmMat4Multiply(&m_matrixMVP, &m_matrixMVP, &transform4x4);
 
+	const kmMat4* matrixM = &m_matrixM;
+	const kmMat4* matrixMV = &m_matrixMV;
+	const kmMat4* matrixMVP = &m_matrixMVP;
+
+	kmMat4 dequantizedM, dequantizedMV, dequantizedMVP;
+
+	//positions come in the box of the mesh, the normals don't need it
+	if (m_quantized)
+	{
+		kmMat4Multiply(&dequantizedM, &m_matrixM, &m_matrixDequantize);
+		kmMat4Multiply(&dequantizedMV, &m_matrixMV, &m_matrixDequantize);
+		kmMat4Multiply(&dequantizedMVP, &m_matrixMVP, &m_matrixDequantize);
+
+		matrixM = &dequantizedM;
+		matrixMV = &dequantizedMV;
+		matrixMVP = &dequantizedMVP;
+
+		const Vec2& scale = m_quantization.texelScale;
+		const Vec2& offset = m_quantization.texelOffset;
+
+		glUniform4f(m_shaderLocations["uTexelRange"], scale.x, scale.y, offset.x, offset.y);
+	}
+
 	//pass matrices to shader
-	glUniformMatrix4fv(m_shaderLocations["CC_MVPMatrix"], 1, 0, m_matrixMVP.mat);
-	glUniformMatrix4fv(m_shaderLocations["CC_MVMatrix"], 1, 0, m_matrixMV.mat);
-	glUniformMatrix4fv(m_shaderLocations["CC_MMatrix"], 1, 0, m_matrixM.mat);
-	glUniformMatrix4fv(m_shaderLocations["CC_VMatrix"], 1, 0, parent->get3DCamera()->getViewMatrix().mat);
+	glUniformMatrix4fv(m_shaderLocations["CC_MVPMatrix"], 1, 0, matrixMVP->mat);
+	glUniformMatrix4fv(m_shaderLocations["CC_MVMatrix"], 1, 0, matrixMV->mat);
+	glUniformMatrix4fv(m_shaderLocations["CC_MMatrix"], 1, 0, matrixM->mat);
+	glUniformMatrix4fv(m_shaderLocations["CC_VMatrix"], 1, 0, m_matrixV.mat);
 	glUniformMatrix4fv(m_shaderLocations["CC_NormalMatrix"], 1, 0, m_matrixNormal.mat);
 	glUniform1i(m_shaderLocations["mode"], m_shineMode);
 	glUniform1f(m_shaderLocations["alpha"], m_opacity);
@@ -702,6 +1203,14 @@ void Model::setupTextures()
 	{
 		glActiveTexture(GL_TEXTURE0 + textureId++);
 		
+		if (m_animationAtlas != NULL)
+		{
+			const FrameAtlas::Frame& frame = m_animationAtlas->getFrame(m_currentTexture);
+
+			glBindTexture(GL_TEXTURE_2D, m_animationAtlas->getTexture()->getName());
+			glUniform4f(m_shaderLocations["uTexCoordTransform"], frame.scaleU, frame.scaleV, frame.offsetU, frame.offsetV);
+		}
+		else
 		if (m_currentTexture == -1)
 			glBindTexture(GL_TEXTURE_2D, m_dTexture->getName());
 		else
@@ -709,13 +1218,10 @@ void Model::setupTextures()
 
 		if (m_textureToAlpha)
 			setupTextureToAlpha();
-
-		//FIXME!!! Don't return. Set the shadow map as well!	
-		return;
 	}
 
-	Scene3D* scene = (Scene3D*)m_pParent->getParent();
-	CCTexture2D* shadowMap = scene->getCache()->getTexture("shadow_map");
+	//on the unit after the texture (see initShaderLocations)
+	CCTexture2D* shadowMap = getShadowMap();
 
 	if (shadowMap != NULL)
 	{
@@ -723,6 +1229,10 @@ void Model::setupTextures()
 		glActiveTexture(GL_TEXTURE0 + textureId);
 		glBindTexture(GL_TEXTURE_2D, shadowMap->getName());
 
+		//cocos binds its textures on whatever unit was left active
+		if (textureId > 0)
+			glActiveTexture(GL_TEXTURE0);
+
 		m_shadowMapSet = true;
 	}
 	else
@@ -731,8 +1241,43 @@ void Model::setupTextures()
 	}
 }
 
+CCTexture2D* Model::getShadowMap()
+{
+	if (m_pParent == NULL)
+		return NULL;
+
+	Scene3D* scene = dynamic_cast<Scene3D*>(m_pParent->getParent());
+
+	if (scene == NULL)
+		return NULL;
+
+	return scene->getCache()->getTexture("shadow_map");
+}
+
 void Model::draw3D()
 {
+	if (m_streamed && m_residency == NULL)
+	{
+		Layer3D* parent = dynamic_cast<Layer3D*>(m_pParent);
+
+		if (parent != NULL)
+			parent->getResidency()->addModel(this);
+	}
+
+	if (!m_resident)
+	{
+		drawPlaceholder();
+		return;
+	}
+
+	if (!textureLoaded())
+	{
+		if (m_streamed)
+			drawPlaceholder();
+
+		return;
+	}
+
 	if (!m_dirtyCheck)
 		m_dirty = true;
 	
@@ -744,8 +1289,7 @@ void Model::draw3D()
 		m_textureAt = 0;
 	}
 	 
-	setupMatrices();
-	setupShadow();
+	updateMatrices();
 
 	bool toRender = true;
 
@@ -755,6 +1299,32 @@ void Model::draw3D()
 	if (!toRender)
 		return;
 
+	if (drawImpostor())
+	{
+		countTriangles(2, m_triangleCount);
+	}
+	else
+	{
+		selectLOD();
+		drawMesh();
+
+		countTriangles((m_lod > 0) ? m_lods[m_lod - 1].triangles : m_triangleCount, m_triangleCount);
+	}
+
+	if (m_drawOBB)
+		renderOOBB();
+}
+
+void Model::drawMesh()
+{
+	const std::vector<int>& firsts = (m_lod > 0) ? m_lods[m_lod - 1].firsts : m_firsts;
+	const std::vector<int>& counts = (m_lod > 0) ? m_lods[m_lod - 1].counts : m_counts;
+
+	updateLights();
+	updateShaderProgram();
+
+	setupMatrices();
+	setupShadow();
 	setupLights();
 	setupTextures();
 
@@ -770,10 +1340,18 @@ void Model::draw3D()
 		setupMaterial(m_diffuses[i],m_speculars[i]);		
 		setupAttribs();
 
+		if (m_lines && m_edgesIBO != 0)
+		{
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_edgesIBO);
+			glDrawElements(GL_LINES, m_edgeCounts[i], GL_UNSIGNED_SHORT, (GLvoid*)(m_edgeFirsts[i] * sizeof(GLushort)));
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		}
+		else
 		if (m_lines)
 			glDrawArrays(GL_LINES, m_firsts[i], m_counts[i]);
 		else
-			glDrawArrays(GL_TRIANGLES, m_firsts[i], m_counts[i]);
+		if (counts[i] > 0)
+			glDrawArrays(GL_TRIANGLES, firsts[i], counts[i]);
 
 		CC_INCREMENT_GL_DRAWS(1);
     }
@@ -781,72 +1359,125 @@ void Model::draw3D()
 	if (m_cullBackFace)
 		glDisable(GL_CULL_FACE);
 
+	disableAttribs();
+
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
 	CHECK_GL_ERROR_DEBUG();	
 
-	if (m_drawOBB)
-		renderOOBB();
-	
 	glBindTexture(GL_TEXTURE_2D, NULL);
 }
 
-void Model::setFrustumCulling(bool culling)
+void Model::drawView(const kmMat4& view, const kmMat4& projection)
 {
-	m_culling = culling;
+	m_matrixV = view;
+	kmMat4Multiply(&m_matrixMV, &view, &m_matrixM);
+	kmMat4Multiply(&m_matrixMVP, &projection, &m_matrixMV);
+
+	//the views are rendered at full detail
+	unsigned int lod = m_lod;
+	m_lod = 0;
+
+	drawMesh();
+
+	m_lod = lod;
 }
 
-void Model::renderOOBB()
+void Model::setImpostorDistance(float distance)
 {
-	CCGLProgram* program = CCShaderCache::sharedShaderCache()->programForKey(kCCShader_PositionColor);
-	program->setUniformsForBuiltins();
-	program->use();
+	m_impostorDistance = distance;
 
-	static GLint loc = -1;
+	if (m_impostorDistance <= 0)
+		CC_SAFE_RELEASE_NULL(m_impostor);
+}
 
-	if (loc == -1)
-		loc = program->getUniformLocationForName("CC_MVPMatrix");
-	
-	program->setUniformLocationWithMatrix4fv(loc, m_matrixMVP.mat, 1);
-	
-	Vec3 points[24];
-	
-	points[0].x = m_aabb.min.x; points[0].y = m_aabb.min.y; points[0].z = m_aabb.max.z;
-	points[1].x = m_aabb.min.x; points[1].y = m_aabb.max.y; points[1].z = m_aabb.max.z;
-	points[2].x = m_aabb.min.x; points[2].y = m_aabb.max.y; points[2].z = m_aabb.max.z;
-	points[3].x = m_aabb.max.x; points[3].y = m_aabb.max.y; points[3].z = m_aabb.max.z;
-	points[4].x = m_aabb.max.x; points[4].y = m_aabb.max.y; points[4].z = m_aabb.max.z;
-	points[5].x = m_aabb.max.x; points[5].y = m_aabb.min.y; points[5].z = m_aabb.max.z;
-	points[6].x = m_aabb.max.x; points[6].y = m_aabb.min.y; points[6].z = m_aabb.max.z;
-	points[7].x = m_aabb.min.x; points[7].y = m_aabb.min.y; points[7].z = m_aabb.max.z;
-
-	points[8].x = m_aabb.min.x; points[8].y = m_aabb.min.y; points[8].z = m_aabb.min.z;
-	points[9].x = m_aabb.min.x; points[9].y = m_aabb.max.y; points[9].z = m_aabb.min.z;
-	points[10].x = m_aabb.min.x; points[10].y = m_aabb.max.y; points[10].z = m_aabb.min.z;
-	points[11].x = m_aabb.max.x; points[11].y = m_aabb.max.y; points[11].z = m_aabb.min.z;
-	points[12].x = m_aabb.max.x; points[12].y = m_aabb.max.y; points[12].z = m_aabb.min.z;
-	points[13].x = m_aabb.max.x; points[13].y = m_aabb.min.y; points[13].z = m_aabb.min.z;
-	points[14].x = m_aabb.max.x; points[14].y = m_aabb.min.y; points[14].z = m_aabb.min.z;
-	points[15].x = m_aabb.min.x; points[15].y = m_aabb.min.y; points[15].z = m_aabb.min.z;
-
-	points[16].x = m_aabb.min.x; points[16].y = m_aabb.min.y; points[16].z = m_aabb.min.z;
-	points[17].x = m_aabb.min.x; points[17].y = m_aabb.min.y; points[17].z = m_aabb.max.z;
-	points[18].x = m_aabb.min.x; points[18].y = m_aabb.max.y; points[18].z = m_aabb.min.z;
-	points[19].x = m_aabb.min.x; points[19].y = m_aabb.max.y; points[19].z = m_aabb.max.z;
-	
-	points[20].x = m_aabb.max.x; points[20].y = m_aabb.min.y; points[20].z = m_aabb.min.z;
-	points[21].x = m_aabb.max.x; points[21].y = m_aabb.min.y; points[21].z = m_aabb.max.z;
-	
-	points[22].x = m_aabb.max.x; points[22].y = m_aabb.max.y; points[22].z = m_aabb.min.z;
-	points[23].x = m_aabb.max.x; points[23].y = m_aabb.max.y; points[23].z = m_aabb.max.z;
+void Model::impostorBounds(kmVec3* center, float* radius)
+{
+	kmVec3 size;
+	kmVec3Subtract(&size, &m_aabb.max, &m_aabb.min);
+
+	kmVec3 local;
+	kmVec3Add(&local, &m_aabb.min, &m_aabb.max);
+	kmVec3Scale(&local, &local, 0.5f);
+
+	//the same sphere whichever way the model is turned
+	kmVec3TransformCoord(center, &local, &m_matrixM);
+	*radius = kmVec3Length(&size) * 0.5f * m_scale * MAX(m_meshScale.x, MAX(m_meshScale.y, m_meshScale.z));
+}
+
+bool Model::drawImpostor()
+{
+	m_impostorDrawn = false;
+
+	if (m_impostorDistance <= 0 || m_lines)
+		return false;
+
+	Layer3D* parent = (Layer3D*)m_pParent;
+
+	const Vec3& eye = parent->get3DCamera()->get3DPosition();
+	const Vec3& position = get3DPosition();
+
+	kmVec3 toEye = { eye.x - position.x, eye.y - position.y, eye.z - position.z };
+
+	if (kmVec3Length(&toEye) < m_impostorDistance)
+		return false;
+
+	if (m_impostor == NULL)
+	{
+		m_impostor = Impostor::create();
+		CC_SAFE_RETAIN(m_impostor);
+	}
+
+	if (m_impostor == NULL || m_impostor->hasFailed())
+		return false;
+
+	kmVec3 center;
+	float radius;
+	impostorBounds(&center, &radius);
+
+	//lit once, until the lights change
+	if (!m_impostor->isCaptured() || m_impostorLights != parent->getLightsVersion())
+	{
+		m_impostorLights = parent->getLightsVersion();
+
+		bool captured = m_impostor->capture(this, center, radius);
+
+		//the camera's matrices back for the quad, or for the mesh
+		m_dirty = true;
+		updateMatrices();
+
+		if (!captured)
+			return false;
+	}
+
+	//the views were taken in model space, so is the camera looked for
+	kmMat4 inverse;
+	kmMat4Inverse(&inverse, &m_matrixM);
+
+	kmVec3 direction;
+	kmVec3TransformNormal(&direction, &toEye, &inverse);
 
-	glVertexAttribPointer(kCCVertexAttrib_Position, 3, GL_FLOAT, GL_FALSE, 0, points);
- 	glDrawArrays(GL_LINES, 0, 24);
+	const kmMat4& view = parent->get3DCamera()->getViewMatrix();
+	const kmMat4& projection = parent->get3DCamera()->getProjectionMatrix();
+
+	m_impostor->draw(view, projection, center, radius, m_impostor->viewForDirection(direction), m_opacity);
+
+	m_impostorDrawn = true;
+
+	return true;
+}
+
+void Model::setFrustumCulling(bool culling)
+{
+	m_culling = culling;
+}
 
-	//ccColor4F color = { 1.0f, 0.5f, 0.0f, 1.0f };
-	//ccDrawSolidRect(CCPoint(m_bbox.min.x,m_bbox.min.y),CCPoint(m_bbox.max.x, m_bbox.max.y),color);
+void Model::renderOOBB()
+{
+	Layer3D* parent = dynamic_cast<Layer3D*>(m_pParent);
 
-	CC_INCREMENT_GL_DRAWS(1);
+	//drawn along with every other debug line once the layer is visited
+	parent->getDebugDraw()->addBox(m_aabb, m_matrixM, ccc4(255, 128, 0, 255));
 }
 
 void Model::setupMaterial(const Vec3& diffuses, const Vec3& speculars)
@@ -883,6 +1514,9 @@ void Model::setDrawOBB(bool draw)
 void Model::renderLines(bool lines)
 {
 	m_lines = lines;
+
+	if (m_lines && m_edgesIBO == 0)
+		generateEdges();
 }
 
 void Model::setShineMode(ShineMode mode, float exponent)
@@ -910,10 +1544,132 @@ void Model::addCustomLights(const std::list<Light*>& lights)
 		m_lightsDiffuses[i] = diffuse;
 		m_lightsIntensity[i] = (*iter)->getIntensity();
 		m_lightsPositions[i] = position;
+		m_lightsAttenuation[i] = (*iter)->getAttenuation();
 		m_lightsEnabled[i] = true;
 	}
 }
 
+bool Model::textureLoaded()
+{
+	if (m_textureRequest == NULL)
+		return true;
+
+	if (!m_textureRequest->isDone())
+		return false;
+
+	m_dTexture = m_textureRequest->getTexture();
+	CC_SAFE_RETAIN(m_dTexture);
+
+	//couldn't be decoded, drawn untextured
+	if (m_dTexture == NULL)
+		m_textured = false;
+
+	m_textureRequest->release();
+	m_textureRequest = NULL;
+
+	return true;
+}
+
+void Model::setAsyncTextureLoading(bool async)
+{
+	s_asyncTextureLoading = async;
+}
+
+void Model::setLODGeneration(unsigned int levels)
+{
+	s_lodLevels = levels;
+}
+
+void Model::setQuantizedVertices(bool quantized)
+{
+#if (CC_TARGET_PLATFORM == CC_PLATFORM_WP8)
+	//only the precompiled programs there, none of them decodes it
+	CC_UNUSED_PARAM(quantized);
+#else
+	s_quantizedVertices = quantized;
+#endif
+}
+
+void Model::getTriangleStats(unsigned int* submitted, unsigned int* fullDetail)
+{
+	//stats of a frame are complete once the next one starts
+	countTriangles(0, 0);
+
+	*submitted = s_triangleStats.lastSubmitted;
+	*fullDetail = s_triangleStats.lastFullDetail;
+}
+
+void Model::loadTexture()
+{
+	if (m_textureFile == "" || m_dTexture != NULL || m_textureRequest != NULL)
+		return;
+
+	//the loader decodes through CCImage, which can't read a ktx, it goes up as it is
+	if (CompressedTexture::isCompressedFile(m_textureFile))
+	{
+		m_dTexture = CompressedTexture::textureForFile(m_textureFile);
+		CC_SAFE_RETAIN(m_dTexture);
+		return;
+	}
+
+	m_textureRequest = TextureLoader::sharedTextureLoader()->loadFileAsync(m_textureFile);
+	m_textureRequest->retain();
+}
+
+void Model::makeResident(MeshParser* parser)
+{
+	if (parser != NULL)
+	{
+		fillVectors(parser);
+
+		m_textured = (m_texels.size() > 0 && (m_dTexture != NULL || m_textureRequest != NULL));
+		m_hasBounds = true;
+	}
+
+	generateVBOs();
+	m_resident = true;
+
+#if CC_ENABLE_CACHE_TEXTURE_DATA
+	RestoreManager::sharedRestoreManager()->addNode(this);
+#endif
+}
+
+void Model::evict()
+{
+	CC_SAFE_RELEASE_NULL(m_textureRequest);
+	CC_SAFE_RELEASE_NULL(m_dTexture);
+
+	//materials and bounds are kept, they're small and say where to stream it back
+	std::vector<Vec3>().swap(m_vertices);
+	std::vector<Vec3>().swap(m_normals);
+	std::vector<Vec2>().swap(m_texels);
+
+	m_pVBO = m_nVBO = m_tVBO = m_edgesIBO = 0;
+	m_lods.clear();
+	m_lod = 0;
+	m_resident = false;
+
+#if CC_ENABLE_CACHE_TEXTURE_DATA
+	RestoreManager::sharedRestoreManager()->removeNode(this);
+#endif
+}
+
+void Model::drawPlaceholder()
+{
+	if (!m_dirtyCheck)
+		m_dirty = true;
+
+	//the bounding box is kept current for the visibility the streaming relies on
+	updateMatrices();
+
+	if (!m_hasBounds)
+		return;
+
+	Layer3D* parent = dynamic_cast<Layer3D*>(m_pParent);
+
+	parent->getDebugDraw()->addBox(m_aabb, m_matrixM, ccc4(128, 128, 128, 255));
+}
+
 void Model::backFaceCulling(bool culling)
 {
 	m_cullBackFace = culling;
@@ -933,9 +1689,32 @@ void Model::addAnimationTextures(const std::vector<CCTexture2D*>& textures, floa
 	}
 }
 
+void Model::addAnimationFrames(const std::vector<std::string>& files, float time)
+{
+	setAnimationAtlas(FrameAtlas::createWithFiles(files), time);
+}
+
+void Model::setAnimationAtlas(FrameAtlas* atlas, float time)
+{
+	if (atlas == NULL || atlas->getFrameCount() == 0)
+		return;
+
+	CC_SAFE_RETAIN(atlas);
+	CC_SAFE_RELEASE(m_animationAtlas);
+
+	m_animationAtlas = atlas;
+	m_textureDt = time;
+
+	//the atlas replaces the default texture, frames go from 0 to count - 1
+	m_currentTexture = TEXTURE_0;
+	m_textured = (m_texels.size() > 0);
+
+	updateShaderProgram();
+}
+
 void Model::setCurrentTexture(int position)
 {
-	if (position < (int)TEXTURE_0 || position >= (int)m_animationTextures.size())
+	if (position < (int)TEXTURE_0 || position >= animationFrameCount())
 		return;
 
 	m_currentTexture = position;
@@ -945,8 +1724,16 @@ void Model::nextTexture()
 {
 	m_currentTexture++;
 	
-	if (m_currentTexture == m_animationTextures.size())
-		m_currentTexture = -1;
+	if (m_currentTexture == animationFrameCount())
+		m_currentTexture = (m_animationAtlas != NULL) ? TEXTURE_0 : DEFAULT_TEXTURE;
+}
+
+int Model::animationFrameCount()
+{
+	if (m_animationAtlas != NULL)
+		return (int)m_animationAtlas->getFrameCount();
+
+	return (int)m_animationTextures.size();
 }
 
 void Model::setTextureToAlpha()
@@ -956,23 +1743,7 @@ void Model::setTextureToAlpha()
 
 	m_textureToAlpha = true;
 
-	m_program = CCShaderCache::sharedShaderCache()->programForKey(PHONG_SHADER_TEXTURE_TO_ALPHA_KEY);
-
-	if (m_program == NULL)
-	{
-		m_program = new CCGLProgram();
-
-		MESH_INIT_PHONG_TEXTURE_TO_ALPHA(m_program);
-		CCShaderCache::sharedShaderCache()->addProgram(m_program, PHONG_SHADER_TEXTURE_TO_ALPHA_KEY);
-	}
-
-	setShaderProgram(m_program);
-	m_program->use();
-	
-	m_shaderLocations.clear();
-	initShaderLocations();
-
-	m_shaderLocations["uAccTime"] = glGetUniformLocation(m_program->getProgram(), "uAccTime");
+	updateShaderProgram();
 }
 
 void Model::setupTextureToAlpha()
@@ -4,6 +4,10 @@
 #include <vector>
 #include "Node3D.h"
 #include "Camera.h"
+#include "MaterialAtlas.h"
+#include "MeshSimplifier.h"
+#include "VBOCache.h"
+#include "MeshQuantizer.h"
 
 using namespace std;
 
@@ -37,7 +41,16 @@ namespace cocos3d
 		float m_fStartAngleZ;
 	};
 
+	// projected size in pixels from which a model is drawn at full detail
+	#define MODEL_LOD_SCREEN_SIZE 512.0f
+	// a coarser level is picked once the model is this much smaller than it needs to be
+	#define MODEL_LOD_HYSTERESIS 0.8f
+
 	class Light;
+	class FrameAtlas;
+	class TextureRequest;
+	class ResidencyManager;
+	class Impostor;
 
 	class Model : public Node3D, public CCRGBAProtocol
 	{
@@ -88,6 +101,25 @@ namespace cocos3d
 									 const char* textureBuffer = NULL, 
 									 unsigned long size = 0);
 
+		// nothing is loaded until the layer's ResidencyManager finds it close enough to
+		// the camera, and it can be evicted again when far, until then its box is drawn
+		static Model* createStreamed(const std::string& id,
+									 const std::string& objFile,
+									 const std::string& mtlFile,
+									 float scale = 1.0f,
+									 const std::string& texture = "");
+
+		virtual bool initStreamed(const std::string& id,
+								  const std::string& objFile,
+								  const std::string& mtlFile,
+								  float scale = 1.0f,
+								  const std::string& texture = "");
+
+		bool isStreamed(){ return m_streamed; }
+		bool isResident(){ return m_resident; }
+
+		virtual void onExit();
+
 		
 		virtual void draw3D();
 
@@ -118,34 +150,95 @@ namespace cocos3d
 		virtual void addCustomLights(const std::list<Light*>& lights);
 		
 		void addAnimationTextures(const std::vector<CCTexture2D*>& textures, float time = 0);
+
+		// frames packed in one texture, switching frames doesn't bind anything, the
+		// same atlas can be set on many models
+		void addAnimationFrames(const std::vector<std::string>& files, float time = 0);
+		void setAnimationAtlas(FrameAtlas* atlas, float time = 0);
 		void setCurrentTexture(int position);
 		void nextTexture();
 
 		void setTextureToAlpha();
 
+		// textures of the models created from buffers after this are decoded by
+		// TextureLoader, a model isn't drawn until its texture is uploaded
+		static void setAsyncTextureLoading(bool async);
+
+		// levels of detail made at load for the meshes without a <obj file>.lod next to
+		// them (see buildLODFile), 0 makes none
+		static void setLODGeneration(unsigned int levels);
+
+		// meshes of the models created after this are uploaded in 16 bytes a vertex
+		// instead of 32 (see QuantizedVertices) and decoded by the vertex shader, a mesh
+		// keeps the format it was first uploaded in
+		static void setQuantizedVertices(bool quantized);
+		bool isQuantized(){ return m_quantized; }
+
+		// under this projected size the level drawn keeps about the triangles per pixel
+		// the full mesh has at it
+		void setLODScreenSize(float pixels){ m_lodScreenSize = pixels; }
+		unsigned int getLODCount(){ return (unsigned int)m_lods.size() + 1; }
+		unsigned int getCurrentLOD(){ return m_lod; }
+
+		// triangles every model drew in the last frame, and what they'd be at full detail
+		static void getTriangleStats(unsigned int* submitted, unsigned int* fullDetail);
+
+		// farther than this from the camera the model is drawn as a quad with its
+		// views rendered beforehand (see Impostor), 0 never does
+		void setImpostorDistance(float distance);
+		float getImpostorDistance(){ return m_impostorDistance; }
+		bool isImpostorDrawn(){ return m_impostorDrawn; }
+
 		void setFrustumCulling(bool culling);
 		bool isOutOfCamera(Frustum::Planes plane);
 		void setDrawOBB(bool draw);
 		void renderLines(bool lines);
 
-		void listenBackToForeground(CCObject *obj);
+		virtual void restoreGLState();
+		unsigned int getShaderFeatures(){ return m_shaderFeatures; }
 
 		virtual void setId(const std::string& id){}
 		const string& getId(){ return m_id; }
+		const string& getMeshId(){ return m_meshId; }
 	protected:
 		Model();
 
 		void fillVectors(MeshParser* parser);
-		void generateVBOs();
-		void initShaderLocations();
+		void useAtlasEntry(const std::string& texture, const MaterialAtlas::Entry& entry);
+		virtual void generateVBOs();
+		void generateLODs();
+		void selectLOD();
+		unsigned int lodForSize(float size);
+		void drawMesh();
+		void drawView(const kmMat4& view, const kmMat4& projection);
+		bool drawImpostor();
+		void impostorBounds(kmVec3* center, float* radius);
+		void generateEdges();
+		virtual void edgeTriangles(std::vector<unsigned int>& triangles, std::vector<int>& firsts, std::vector<int>& counts);
+		virtual void initShaderLocations();
+		virtual unsigned int shaderFeatures();
+		void updateShaderProgram();
+		void updateMatrices();
+		void updateLights();
+		int lightCount();
+		CCTexture2D* getShadowMap();
 		void setupMatrices();
 		void setupLights();
 		void setupTextures();
 		void setupShadow();
 		void setupMaterial(const Vec3& diffuse, const Vec3& specular);
 		void setupTextureToAlpha();
+		int animationFrameCount();
+		bool textureLoaded();
+
+		// called by the ResidencyManager, the parser is NULL when the mesh is already cached
+		void loadTexture();
+		void makeResident(MeshParser* parser);
+		void evict();
+		void drawPlaceholder();
 
 		virtual void setupAttribs();
+		void disableAttribs();
 
 		void transformAABB(const kmAABB& box);
 		void renderOOBB();
@@ -154,17 +247,40 @@ namespace cocos3d
 
 		CCTexture2D* m_dTexture;
 		std::vector<CCTexture2D*> m_animationTextures;
+		FrameAtlas* m_animationAtlas;
+		TextureRequest* m_textureRequest;
 		int m_currentTexture;
 		float m_textureDt;
 		float m_textureAt;
 
 		bool m_textureToAlpha;
 
+		std::string m_objFile, m_mtlFile, m_textureFile;
+		bool m_streamed, m_resident, m_hasBounds;
+		ResidencyManager* m_residency;
+
+		Impostor* m_impostor;
+		float m_impostorDistance;
+		unsigned int m_impostorLights;
+		bool m_impostorDrawn;
+
+		bool m_quantize, m_quantized;
+		VertexQuantization m_quantization;
+		kmMat4 m_matrixDequantize;
+
 		CCGLProgram* m_program;
+		unsigned int m_shaderFeatures;
 
 		Vec3 *m_lightsDiffuses,
 					*m_lightsAmbience,
-					*m_lightsPositions;
+					*m_lightsPositions,
+					*m_lightsAttenuation;
+
+		std::vector<Light*> m_selectedLights;
+		unsigned int m_selectedLightsVersion;
+		Vec3 m_selectedLightsCenter;
+		float m_selectedLightsRadius;
+		bool m_lightsSelected;
 
 		bool m_customLights;
 		bool* m_lightsEnabled;
@@ -172,14 +288,26 @@ namespace cocos3d
 		
 		GLuint m_pVBO,
 			   m_tVBO,
-			   m_nVBO;
+			   m_nVBO,
+			   m_edgesIBO;
+
+		std::vector<MeshLODLevel> m_lodChain;
+		std::vector<VBOCache::LODSet> m_lods;
+		unsigned int m_lod;
+		float m_lodScreenSize;
+		unsigned int m_triangleCount;
+
+		std::vector<int> m_edgeFirsts;
+		std::vector<int> m_edgeCounts;
 
 		kmMat4 m_matrixM,
+			   m_matrixV,
 			   m_matrixMV,
 			   m_matrixMVP,
 			   m_matrixNormal;
 
 		map<string,GLint> m_shaderLocations;
+		GLint m_normalLocation;
 
 		bool m_culling,
 			 m_cullBackFace,
@@ -195,6 +323,8 @@ namespace cocos3d
 		float m_exponent;
 
 		string m_id;
+		string m_meshId;
+		Vec3 m_meshScale;
 		bool m_textured;
 		
 		kmAABB m_aabb;
@@ -211,6 +341,9 @@ namespace cocos3d
 		std::vector<Vec3> m_speculars;
 		std::vector<int> m_firsts;
 		std::vector<int> m_counts;
+
+		friend class ResidencyManager;
+		friend class Impostor;
 	};
 }
 #endif
\ No newline at end of file
@@ -66,6 +66,9 @@ namespace cocos3d
 
 		virtual void draw();
 		virtual void draw3D(){}
+
+		// called by the RestoreManager after a context loss
+		virtual void restoreGLState(){}
 		
 	protected:
 		CCPoint m_position;
@@ -0,0 +1,318 @@
+#include "ProgramBinaryCache.h"
+#include "GLCapabilities.h"
+#include <stdio.h>
+#include <vector>
+#include <chrono>
+
+#if (CC_TARGET_PLATFORM == CC_PLATFORM_ANDROID)
+#include <EGL/egl.h>
+#include <GLES2/gl2ext.h>
+#endif
+
+using namespace cocos3d;
+
+#define PROGRAM_BINARY_MAGIC 0x33434350 // "PCC3"
+#define PROGRAM_BINARY_VERSION 1
+#define PROGRAM_BINARY_PREFIX "cc3_program_"
+
+// GL_OES_get_program_binary on Android, GL_ARB_get_program_binary on desktop.
+// iOS (ES2) and WP8 (precompiled shaders) have no program binaries.
+#if (CC_TARGET_PLATFORM == CC_PLATFORM_ANDROID)
+#define PROGRAM_BINARY_SUPPORTED 1
+#define PROGRAM_BINARY_LENGTH GL_PROGRAM_BINARY_LENGTH_OES
+static PFNGLGETPROGRAMBINARYOESPROC getProgramBinary = NULL;
+static PFNGLPROGRAMBINARYOESPROC programBinary = NULL;
+#elif (CC_TARGET_PLATFORM == CC_PLATFORM_WIN32 || CC_TARGET_PLATFORM == CC_PLATFORM_LINUX)
+#define PROGRAM_BINARY_SUPPORTED 1
+#define PROGRAM_BINARY_LENGTH GL_PROGRAM_BINARY_LENGTH
+static PFNGLGETPROGRAMBINARYPROC getProgramBinary = NULL;
+static PFNGLPROGRAMBINARYPROC programBinary = NULL;
+#else
+#define PROGRAM_BINARY_SUPPORTED 0
+#endif
+
+struct ProgramBinaryHeader
+{
+	unsigned int magic;
+	unsigned int version;
+	unsigned long long sourceHash;
+	unsigned long long driverHash;
+	unsigned int format;
+	unsigned int length;
+};
+
+static unsigned long long fnv1a(const void* data, size_t length, unsigned long long hash = 14695981039346656037ULL)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+
+	for (size_t i = 0; i < length; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+static unsigned long long fnv1a(const std::string& value, unsigned long long hash = 14695981039346656037ULL)
+{
+	return fnv1a(value.c_str(), value.size(), hash);
+}
+
+static double elapsedMs(const std::chrono::steady_clock::time_point& start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+ProgramBinaryCache::ProgramBinaryCache()
+: m_enabled(true)
+, m_supported(-1)
+, m_driverHash(0)
+, m_rejected(0)
+{
+	resetStats();
+}
+
+ProgramBinaryCache* ProgramBinaryCache::sharedProgramBinaryCache()
+{
+	static ProgramBinaryCache* cache = nullptr;
+
+	if (cache == nullptr)
+	{
+		cache = new ProgramBinaryCache();
+		cache->autorelease();
+		cache->retain();
+	}
+
+	return cache;
+}
+
+bool ProgramBinaryCache::isSupported()
+{
+#if PROGRAM_BINARY_SUPPORTED
+	//needs a context, so it's resolved on first use
+	if (m_supported == -1)
+	{
+#if (CC_TARGET_PLATFORM == CC_PLATFORM_ANDROID)
+		if (GLCapabilities::sharedGLCapabilities()->hasExtension("GL_OES_get_program_binary"))
+		{
+			getProgramBinary = (PFNGLGETPROGRAMBINARYOESPROC)eglGetProcAddress("glGetProgramBinaryOES");
+			programBinary = (PFNGLPROGRAMBINARYOESPROC)eglGetProcAddress("glProgramBinaryOES");
+		}
+#else
+		if (GLEW_ARB_get_program_binary)
+		{
+			getProgramBinary = glGetProgramBinary;
+			programBinary = glProgramBinary;
+		}
+#endif
+		GLint formats = 0;
+
+		if (getProgramBinary != NULL && programBinary != NULL)
+			formats = GLCapabilities::sharedGLCapabilities()->getProgramBinaryFormatCount();
+
+		m_supported = (formats > 0) ? 1 : 0;
+	}
+
+	return m_supported == 1;
+#else
+	return false;
+#endif
+}
+
+unsigned long long ProgramBinaryCache::driverHash()
+{
+	if (m_driverHash == 0)
+	{
+		GLCapabilities* capabilities = GLCapabilities::sharedGLCapabilities();
+
+		unsigned long long hash = fnv1a(PROGRAM_BINARY_PREFIX);
+
+		hash = fnv1a(capabilities->getVendor(), hash);
+		hash = fnv1a(capabilities->getRenderer(), hash);
+		hash = fnv1a(capabilities->getVersion(), hash);
+
+		m_driverHash = hash;
+	}
+
+	return m_driverHash;
+}
+
+std::string ProgramBinaryCache::pathForKey(const std::string& key)
+{
+	return CCFileUtils::sharedFileUtils()->getWritablePath() + PROGRAM_BINARY_PREFIX + key + ".bin";
+}
+
+CCGLProgram* ProgramBinaryCache::createProgram(const std::string& key,
+											   const std::string& vertex,
+											   const std::string& fragment,
+											   const ProgramAttributes& attributes)
+{
+	bool useBinaries = m_enabled && isSupported();
+	unsigned long long sourceHash = fnv1a(fragment, fnv1a(vertex));
+
+	//attribute bindings are part of the linked program
+	for (auto iter = attributes.begin(); iter != attributes.end(); iter++)
+	{
+		sourceHash = fnv1a(iter->first, sourceHash);
+		sourceHash = fnv1a(&iter->second, sizeof(iter->second), sourceHash);
+	}
+
+	if (useBinaries)
+	{
+		CCGLProgram* program = loadBinary(key, sourceHash);
+
+		if (program != NULL)
+			return program;
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	CCGLProgram* program = new CCGLProgram();
+	program->initWithVertexShaderByteArray(vertex.c_str(), fragment.c_str());
+
+	for (auto iter = attributes.begin(); iter != attributes.end(); iter++)
+		program->addAttribute(iter->first.c_str(), iter->second);
+
+#if (CC_TARGET_PLATFORM == CC_PLATFORM_WIN32 || CC_TARGET_PLATFORM == CC_PLATFORM_LINUX)
+	if (useBinaries)
+		glProgramParameteri(program->getProgram(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+#endif
+
+	program->link();
+	program->updateUniforms();
+
+	m_cold.count++;
+	m_cold.ms += elapsedMs(start);
+
+	if (useBinaries)
+		saveBinary(program, key, sourceHash);
+
+	return program;
+}
+
+CCGLProgram* ProgramBinaryCache::loadBinary(const std::string& key, unsigned long long sourceHash)
+{
+#if PROGRAM_BINARY_SUPPORTED
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	FILE* file = fopen(pathForKey(key).c_str(), "rb");
+
+	if (file == NULL)
+		return NULL;
+
+	ProgramBinaryHeader header;
+	std::vector<unsigned char> binary;
+
+	bool valid = (fread(&header, sizeof(header), 1, file) == 1)
+		&& header.magic == PROGRAM_BINARY_MAGIC
+		&& header.version == PROGRAM_BINARY_VERSION
+		&& header.sourceHash == sourceHash
+		&& header.driverHash == driverHash()
+		&& header.length > 0;
+
+	if (valid)
+	{
+		binary.resize(header.length);
+		valid = (fread(&binary[0], 1, header.length, file) == header.length);
+	}
+
+	fclose(file);
+
+	if (!valid)
+	{
+		m_rejected++;
+		return NULL;
+	}
+
+	//an empty program object, the binary replaces the shaders
+	CCGLProgram* program = new CCGLProgram();
+	program->initWithVertexShaderByteArray(NULL, NULL);
+
+	programBinary(program->getProgram(), (GLenum)header.format, &binary[0], (GLsizei)header.length);
+
+	GLint status = GL_FALSE;
+	glGetProgramiv(program->getProgram(), GL_LINK_STATUS, &status);
+
+	if (status != GL_TRUE)
+	{
+		//the driver was updated or doesn't like it anymore
+		CCLOG("cocos3d: program binary %s rejected, compiling it again", key.c_str());
+
+		program->release();
+		m_rejected++;
+
+		return NULL;
+	}
+
+	program->updateUniforms();
+
+	m_warm.count++;
+	m_warm.ms += elapsedMs(start);
+
+	return program;
+#else
+	return NULL;
+#endif
+}
+
+void ProgramBinaryCache::saveBinary(CCGLProgram* program, const std::string& key, unsigned long long sourceHash)
+{
+#if PROGRAM_BINARY_SUPPORTED
+	GLint length = 0;
+	glGetProgramiv(program->getProgram(), PROGRAM_BINARY_LENGTH, &length);
+
+	if (length <= 0)
+		return;
+
+	std::vector<unsigned char> binary(length);
+	GLenum format = 0;
+	GLsizei written = 0;
+
+	getProgramBinary(program->getProgram(), length, &written, &format, &binary[0]);
+
+	if (written <= 0)
+		return;
+
+	ProgramBinaryHeader header = {
+		PROGRAM_BINARY_MAGIC,
+		PROGRAM_BINARY_VERSION,
+		sourceHash,
+		driverHash(),
+		(unsigned int)format,
+		(unsigned int)written
+	};
+
+	FILE* file = fopen(pathForKey(key).c_str(), "wb");
+
+	if (file == NULL)
+		return;
+
+	bool saved = (fwrite(&header, sizeof(header), 1, file) == 1)
+		&& (fwrite(&binary[0], 1, written, file) == (size_t)written);
+
+	fclose(file);
+
+	//never leave a truncated binary behind
+	if (!saved)
+		remove(pathForKey(key).c_str());
+#endif
+}
+
+void ProgramBinaryCache::removeBinary(const std::string& key)
+{
+	remove(pathForKey(key).c_str());
+}
+
+void ProgramBinaryCache::dumpStats()
+{
+	CCLOG("cocos3d: programs cold %u (%.2f ms), warm %u (%.2f ms), rejected binaries %u",
+		m_cold.count, m_cold.ms, m_warm.count, m_warm.ms, m_rejected);
+}
+
+void ProgramBinaryCache::resetStats()
+{
+	m_cold.count = m_warm.count = 0;
+	m_cold.ms = m_warm.ms = 0;
+	m_rejected = 0;
+}
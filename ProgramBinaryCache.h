@@ -0,0 +1,62 @@
+#ifndef __PROGRAM_BINARY_CACHE_H__
+#define __PROGRAM_BINARY_CACHE_H__
+#include "cocos2d.h"
+#include <string>
+#include <map>
+
+using namespace std;
+using namespace cocos2d;
+
+namespace cocos3d
+{
+	typedef std::map<std::string, GLuint> ProgramAttributes;
+
+	// Keeps linked programs on disk (writable path) with glGetProgramBinary, so the
+	// next startup or context loss doesn't compile the GLSL again. A binary is only
+	// used when it was built from the same sources by the same driver, otherwise
+	// the program is compiled from source and the binary is written again.
+	class ProgramBinaryCache : public CCObject
+	{
+	public:
+		ProgramBinaryCache();
+
+		static ProgramBinaryCache* sharedProgramBinaryCache();
+
+		// returns a new linked program (retained, like new CCGLProgram())
+		CCGLProgram* createProgram(const std::string& key,
+								   const std::string& vertex,
+								   const std::string& fragment,
+								   const ProgramAttributes& attributes);
+
+		void setEnabled(bool enabled){ m_enabled = enabled; }
+		bool isEnabled(){ return m_enabled; }
+		bool isSupported();
+
+		void removeBinary(const std::string& key);
+
+		// cold: compiled from source, warm: loaded from a binary
+		void dumpStats();
+		void resetStats();
+
+	private:
+		struct Stats
+		{
+			unsigned int count;
+			double ms;
+		};
+
+		CCGLProgram* loadBinary(const std::string& key, unsigned long long sourceHash);
+		void saveBinary(CCGLProgram* program, const std::string& key, unsigned long long sourceHash);
+
+		std::string pathForKey(const std::string& key);
+		unsigned long long driverHash();
+
+		bool m_enabled;
+		int m_supported;
+		unsigned long long m_driverHash;
+
+		Stats m_cold, m_warm;
+		unsigned int m_rejected;
+	};
+}
+#endif
@@ -1,47 +1,274 @@
 #include "RenderCache.h"
+#include "CompressedTexture.h"
 
 using namespace cocos3d;
 
+RenderCache::RenderCache()
+: m_budget(0)
+, m_usage(0)
+, m_evictions(0)
+, m_reloads(0)
+{
+	for (int i = 0; i < kRenderResourceTypeCount; i++)
+	{
+		m_typeBudgets[i] = 0;
+		m_typeUsage[i] = 0;
+	}
+}
+
 RenderCache::~RenderCache()
 {
-	for (auto iter = m_textures.begin();
-		 iter != m_textures.end();
+	for (auto iter = m_entries.begin();
+		 iter != m_entries.end();
 		 iter++)
 	{
-		iter->second->release();
+		if (iter->second.object != NULL)
+			iter->second.object->release();
 	}
-    
-    m_textures.clear();
+
+	m_entries.clear();
+	m_used.clear();
 }
 
-void RenderCache::addTexture(const string& key, CCTexture2D* texture)
+void RenderCache::add(const string& key, RenderResourceType type, CCObject* object, unsigned int bytes, RenderResourceLoader* loader)
 {
-	auto find = m_textures.find(key);
+	//retained first, the key may already hold this very object
+	object->retain();
+
+	auto found = m_entries.find(key);
+
+	if (found != m_entries.end())
+	{
+		Entry& entry = found->second;
+
+		if (entry.object != NULL)
+		{
+			m_usage -= entry.bytes;
+			m_typeUsage[entry.type] -= entry.bytes;
+			entry.object->release();
+		}
+
+		m_used.erase(entry.used);
+	}
+
+	Entry& entry = m_entries[key];
 
-	if (find != m_textures.end())
-		texture->release();
+	//a replaced resource keeps its references
+	if (found == m_entries.end())
+		entry.references = 0;
 
-	m_textures[key] = texture;
-	texture->retain();
+	entry.type = type;
+	entry.object = object;
+	entry.bytes = bytes;
+	entry.loader = loader;
+	entry.used = m_used.insert(m_used.begin(), key);
+
+	m_usage += bytes;
+	m_typeUsage[type] += bytes;
+
+	trim(&entry);
 }
 
-void RenderCache::removeTexture(const string& key)
+void RenderCache::remove(const string& key)
 {
-	auto found = m_textures.find(key);
+	auto found = m_entries.find(key);
+
+	if (found == m_entries.end())
+		return;
 
-	if (found != m_textures.end())
+	Entry& entry = found->second;
+
+	if (entry.object != NULL)
 	{
-		m_textures[key]->release();
-		m_textures.erase(found);
+		m_usage -= entry.bytes;
+		m_typeUsage[entry.type] -= entry.bytes;
+		entry.object->release();
 	}
+
+	m_used.erase(entry.used);
+	m_entries.erase(found);
+}
+
+CCObject* RenderCache::get(const string& key)
+{
+	Entry* entry = touch(key);
+
+	return (entry != NULL) ? entry->object : NULL;
+}
+
+CCObject* RenderCache::retainResource(const string& key)
+{
+	Entry* entry = touch(key);
+
+	if (entry == NULL || entry->object == NULL)
+		return NULL;
+
+	entry->references++;
+
+	return entry->object;
+}
+
+void RenderCache::releaseResource(const string& key)
+{
+	auto found = m_entries.find(key);
+
+	if (found == m_entries.end() || found->second.references == 0)
+		return;
+
+	found->second.references--;
+
+	//it may have been held over the budget
+	if (found->second.references == 0)
+		trim(NULL);
+}
+
+unsigned int RenderCache::getReferences(const string& key)
+{
+	auto found = m_entries.find(key);
+
+	return (found != m_entries.end()) ? found->second.references : 0;
+}
+
+void RenderCache::addTexture(const string& key, CCTexture2D* texture, RenderResourceLoader* loader)
+{
+	add(key, kRenderResourceTexture, texture, textureBytes(texture), loader);
+}
+
+void RenderCache::removeTexture(const string& key)
+{
+	remove(key);
 }
 
 CCTexture2D* RenderCache::getTexture(const string& key)
 {
-	auto found = m_textures.find(key);
+	auto found = m_entries.find(key);
+
+	if (found == m_entries.end() || found->second.type != kRenderResourceTexture)
+		return NULL;
+
+	return dynamic_cast<CCTexture2D*>(get(key));
+}
+
+void RenderCache::setBudget(unsigned int bytes)
+{
+	m_budget = bytes;
+	trim(NULL);
+}
+
+void RenderCache::setBudget(RenderResourceType type, unsigned int bytes)
+{
+	m_typeBudgets[type] = bytes;
+	trim(NULL);
+}
+
+void RenderCache::trim()
+{
+	trim(NULL);
+}
+
+unsigned int RenderCache::textureBytes(CCTexture2D* texture)
+{
+	//its levels may be a fraction of what its pixel format says
+	CompressedTexture* compressed = dynamic_cast<CompressedTexture*>(texture);
+
+	if (compressed != NULL)
+		return compressed->getUploadedBytes();
+
+	unsigned int bytes = texture->getPixelsWide() * texture->getPixelsHigh() * texture->bitsPerPixelForFormat() / 8;
+
+	if (texture->hasMipmaps())
+		bytes += bytes / 3;
+
+	return bytes;
+}
+
+RenderCache::Entry* RenderCache::touch(const string& key)
+{
+	auto found = m_entries.find(key);
+
+	if (found == m_entries.end())
+		return NULL;
 
-	if (found != m_textures.end())
-		return m_textures[key];
+	Entry& entry = found->second;
 
-	return NULL;
+	m_used.splice(m_used.begin(), m_used, entry.used);
+
+	if (entry.object == NULL && !reload(key, entry))
+		return NULL;
+
+	return &entry;
+}
+
+bool RenderCache::reload(const string& key, Entry& entry)
+{
+	if (entry.loader == NULL)
+		return false;
+
+	unsigned int bytes = 0;
+	CCObject* object = entry.loader->reloadResource(key, entry.type, &bytes);
+
+	if (object == NULL)
+	{
+		CCLOG("cocos3d: can't reload %s", key.c_str());
+		return false;
+	}
+
+	object->retain();
+
+	entry.object = object;
+	entry.bytes = bytes;
+
+	m_usage += bytes;
+	m_typeUsage[entry.type] += bytes;
+	m_reloads++;
+
+	//room for it comes from the others, not from itself
+	trim(&entry);
+
+	return true;
+}
+
+void RenderCache::evict(Entry& entry)
+{
+	m_usage -= entry.bytes;
+	m_typeUsage[entry.type] -= entry.bytes;
+
+	entry.object->release();
+	entry.object = NULL;
+	entry.bytes = 0;
+
+	m_evictions++;
+}
+
+bool RenderCache::overBudget(RenderResourceType type)
+{
+	return (m_budget > 0 && m_usage > m_budget) ||
+		   (m_typeBudgets[type] > 0 && m_typeUsage[type] > m_typeBudgets[type]);
+}
+
+void RenderCache::trim(const Entry* keep)
+{
+	if (m_budget == 0)
+	{
+		bool typeBudgets = false;
+
+		for (int i = 0; i < kRenderResourceTypeCount; i++)
+			typeBudgets = typeBudgets || m_typeBudgets[i] > 0;
+
+		if (!typeBudgets)
+			return;
+	}
+
+	//least recently used first
+	for (auto iter = m_used.rbegin(); iter != m_used.rend(); iter++)
+	{
+		Entry& entry = m_entries[*iter];
+
+		//only what can come back goes
+		if (&entry == keep || entry.object == NULL || entry.references > 0 || entry.loader == NULL)
+			continue;
+
+		if (overBudget(entry.type))
+			evict(entry);
+	}
 }
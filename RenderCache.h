@@ -3,23 +3,111 @@
 #include "cocos2d.h"
 #include <string>
 #include <map>
+#include <list>
 
 using namespace std;
 using namespace cocos2d;
 
 namespace cocos3d
 {
+	enum RenderResourceType
+	{
+		kRenderResourceTexture,
+		kRenderResourceMesh,
+		kRenderResourceProgram,
+		kRenderResourceTarget,
+		kRenderResourceTypeCount
+	};
+
+	// Builds an evicted resource again the next time it's asked for, the cache
+	// doesn't own its loaders.
+	class RenderResourceLoader
+	{
+	public:
+		virtual ~RenderResourceLoader(){}
+
+		// NULL if it can't, bytes is what the new resource takes on the gpu
+		virtual CCObject* reloadResource(const std::string& key, RenderResourceType type, unsigned int* bytes) = 0;
+	};
+
+	// Resources of a scene by key, with the bytes each one takes. Over the budget the
+	// least recently used ones nobody holds a reference to are evicted, and those with
+	// a loader come back on the next get. Resources without one stay until removed.
 	class RenderCache : public CCObject
 	{
 	public:
+		RenderCache();
 		~RenderCache();
 
-		void addTexture(const string& key, CCTexture2D* texture);
+		// retains the object, replacing what the key held
+		void add(const string& key, RenderResourceType type, CCObject* object, unsigned int bytes, RenderResourceLoader* loader = NULL);
+		void remove(const string& key);
+
+		// NULL if there's no such key or it was evicted and couldn't be reloaded. Not
+		// retained and not pinned: the next add, get or trim may evict it, use it right
+		// away or hold it through retainResource
+		CCObject* get(const string& key);
+
+		// referenced resources are never evicted, every retain needs its release
+		CCObject* retainResource(const string& key);
+		void releaseResource(const string& key);
+		unsigned int getReferences(const string& key);
+
+		void addTexture(const string& key, CCTexture2D* texture, RenderResourceLoader* loader = NULL);
 		void removeTexture(const string& key);
 
+		// like get, only good until the cache is used again, NULL while the key holds
+		// something else than the texture, like the request still decoding it
 		CCTexture2D* getTexture(const string& key);
+
+		// 0 is no budget, for everything or for one type
+		void setBudget(unsigned int bytes);
+		void setBudget(RenderResourceType type, unsigned int bytes);
+		unsigned int getBudget(){ return m_budget; }
+		unsigned int getBudget(RenderResourceType type){ return m_typeBudgets[type]; }
+
+		unsigned int getUsage(){ return m_usage; }
+		unsigned int getUsage(RenderResourceType type){ return m_typeUsage[type]; }
+
+		unsigned int getEvictionCount(){ return m_evictions; }
+		unsigned int getReloadCount(){ return m_reloads; }
+
+		// evicts until the budgets hold, or nothing more can go
+		void trim();
+
+		// level 0 plus a third for the mip chain, what was uploaded for a CompressedTexture
+		static unsigned int textureBytes(CCTexture2D* texture);
+
 	protected:
-		map<string,CCTexture2D*> m_textures;
+		struct Entry
+		{
+			RenderResourceType type;
+			CCObject* object;
+			unsigned int bytes;
+			unsigned int references;
+			RenderResourceLoader* loader;
+			std::list<std::string>::iterator used;
+		};
+
+		Entry* touch(const string& key);
+		bool reload(const string& key, Entry& entry);
+		void evict(Entry& entry);
+		void trim(const Entry* keep);
+
+		bool overBudget(RenderResourceType type);
+
+		map<string,Entry> m_entries;
+
+		// most recently used first
+		std::list<std::string> m_used;
+
+		unsigned int m_budget;
+		unsigned int m_typeBudgets[kRenderResourceTypeCount];
+		unsigned int m_usage;
+		unsigned int m_typeUsage[kRenderResourceTypeCount];
+
+		unsigned int m_evictions;
+		unsigned int m_reloads;
 	};
 }
 #endif
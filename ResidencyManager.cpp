@@ -0,0 +1,435 @@
+#include "ResidencyManager.h"
+#include "Model.h"
+#include "Camera.h"
+#include "OBJParser.h"
+#include "VBOCache.h"
+#include "TextureLoader.h"
+#include "CompressedTexture.h"
+#include <algorithm>
+
+using namespace cocos3d;
+
+static float distanceTo(const Vec3& from, const Vec3& to)
+{
+	float dx = to.x - from.x;
+	float dy = to.y - from.y;
+	float dz = to.z - from.z;
+
+	return sqrtf(dx*dx + dy*dy + dz*dz);
+}
+
+static unsigned int meshBytes(OBJParser* parser, bool quantized)
+{
+	if (parser == NULL)
+		return 0;
+
+	//see QuantizedVertices
+	if (quantized)
+		return (unsigned int)(parser->positions().size() * QUANTIZED_POSITION_COMPONENTS * sizeof(GLushort) +
+							  parser->normals().size() * 2 * sizeof(GLushort) +
+							  parser->texels().size() * 2 * sizeof(GLushort));
+
+	return (unsigned int)(parser->positions().size() * sizeof(Vec3) +
+						  parser->normals().size() * sizeof(Vec3) +
+						  parser->texels().size() * sizeof(Vec2));
+}
+
+ResidencyManager::ResidencyManager()
+: m_quit(false)
+, m_loadDistance(RESIDENCY_LOAD_DISTANCE)
+, m_unloadDistance(0)
+, m_memoryCeiling(RESIDENCY_MEMORY_CEILING)
+, m_lookAhead(RESIDENCY_LOOK_AHEAD)
+, m_uploadBudget(RESIDENCY_UPLOAD_BUDGET)
+, m_residentCount(0)
+, m_evictions(0)
+, m_hasLastEye(false)
+{
+	//until the layer is in a Scene3D
+	m_cache = new RenderCache();
+}
+
+ResidencyManager::~ResidencyManager()
+{
+	stopWorker();
+
+	std::deque<Job*> jobs(m_queued);
+	jobs.insert(jobs.end(), m_parsed.begin(), m_parsed.end());
+	jobs.insert(jobs.end(), m_uploads.begin(), m_uploads.end());
+
+	for (auto iter = jobs.begin(); iter != jobs.end(); iter++)
+	{
+		delete (*iter)->parser;
+		delete *iter;
+	}
+
+	//the models outliving the layer are left as they are, just not streamed anymore
+	for (auto iter = m_models.begin(); iter != m_models.end(); iter++)
+		(*iter)->m_residency = NULL;
+
+	m_cache->release();
+}
+
+ResidencyManager* ResidencyManager::create()
+{
+	ResidencyManager* pRet = new ResidencyManager();
+	pRet->autorelease();
+
+	return pRet;
+}
+
+void ResidencyManager::addModel(Model* model)
+{
+	if (model->m_residency == this)
+		return;
+
+	model->m_residency = this;
+	m_models.push_back(model);
+}
+
+void ResidencyManager::removeModel(Model* model)
+{
+	auto found = std::find(m_models.begin(), m_models.end(), model);
+
+	if (found == m_models.end())
+		return;
+
+	m_models.erase(found);
+	m_failed.erase(model);
+
+	auto loading = m_loading.find(model);
+
+	if (loading != m_loading.end())
+	{
+		//the worker may still have it, it's dropped once it comes back
+		loading->second->cancelled = true;
+		m_loading.erase(loading);
+
+		model->evict();
+		releaseTexture(model);
+	}
+	else
+	if (model->m_resident)
+	{
+		evict(model);
+	}
+
+	model->m_residency = NULL;
+}
+
+void ResidencyManager::setCache(RenderCache* cache)
+{
+	if (cache == m_cache || m_residentCount > 0 || !m_loading.empty())
+		return;
+
+	cache->retain();
+	m_cache->release();
+	m_cache = cache;
+}
+
+unsigned int ResidencyManager::getResidentBytes()
+{
+	return m_cache->getUsage(kRenderResourceMesh) + m_cache->getUsage(kRenderResourceTexture);
+}
+
+void ResidencyManager::update(Camera* camera, float dt)
+{
+	if (m_models.empty() && m_uploads.empty())
+		return;
+
+	finishLoads();
+
+	const Vec3& eye = camera->get3DPosition();
+	Vec3 ahead = eye;
+
+	//where the camera will be if it keeps going
+	if (m_hasLastEye && dt > 0)
+	{
+		ahead.x += (eye.x - m_lastEye.x) / dt * m_lookAhead;
+		ahead.y += (eye.y - m_lastEye.y) / dt * m_lookAhead;
+		ahead.z += (eye.z - m_lastEye.z) / dt * m_lookAhead;
+	}
+
+	m_lastEye = eye;
+	m_hasLastEye = true;
+
+	Frustum frustum(camera);
+
+	std::vector<Candidate> loads, residents;
+
+	for (auto iter = m_models.begin(); iter != m_models.end(); iter++)
+	{
+		Model* model = *iter;
+
+		if (m_failed.find(model) != m_failed.end())
+			continue;
+
+		const Vec3& center = model->get3DPosition();
+		float distance = MAX(MIN(distanceTo(eye, center), distanceTo(ahead, center)) - model->getRadius(), 0.0f);
+
+		kmAABB box = model->getBoundingBox();
+
+		if (frustum.isBoxInFrustumPerPoint(box))
+			distance *= RESIDENCY_VISIBLE_BIAS;
+
+		Candidate candidate = { model, distance };
+
+		if (model->m_resident)
+		{
+			//a texture's size is only known once it's uploaded, it replaces its request
+			if (model->m_dTexture != NULL && m_cache->getTexture(model->m_textureFile) == NULL)
+				m_cache->addTexture(model->m_textureFile, model->m_dTexture);
+
+			residents.push_back(candidate);
+		}
+		else
+		if (distance < m_loadDistance && m_loading.find(model) == m_loading.end())
+		{
+			loads.push_back(candidate);
+		}
+	}
+
+	//closest first
+	std::sort(loads.begin(), loads.end());
+
+	for (auto iter = loads.begin(); iter != loads.end() && m_loading.size() < RESIDENCY_MAX_LOADS; iter++)
+		startLoad(iter->model);
+
+	//farthest first
+	std::sort(residents.rbegin(), residents.rend());
+
+	unsigned int residentBytes = getResidentBytes();
+
+	for (auto iter = residents.begin(); iter != residents.end(); iter++)
+	{
+		bool unload = (m_unloadDistance > 0 && iter->distance > m_unloadDistance);
+
+		//never what would be loaded right back
+		bool overCeiling = (m_memoryCeiling > 0 && residentBytes > m_memoryCeiling && iter->distance >= m_loadDistance);
+
+		if (unload || overCeiling)
+		{
+			evict(iter->model);
+			residentBytes = getResidentBytes();
+		}
+	}
+}
+
+void ResidencyManager::startLoad(Model* model)
+{
+	acquireTexture(model);
+
+#if !CC_ENABLE_CACHE_TEXTURE_DATA
+	//the buffers are still there for another model, and this one has its materials,
+	//with context restores every model keeps its own copy of the mesh so it's parsed
+	if (m_cache->getReferences(model->m_meshId) > 0 && model->m_hasBounds)
+	{
+		makeResident(model, NULL);
+		return;
+	}
+#endif
+
+	Job* job = new Job();
+	job->model = model;
+	job->meshId = model->m_meshId;
+	job->objFile = model->m_objFile;
+	job->mtlFile = model->m_mtlFile;
+	job->scale = model->m_scale;
+	job->parser = NULL;
+	job->cancelled = false;
+
+	m_loading[model] = job;
+
+	startWorker();
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_queued.push_back(job);
+	}
+
+	m_condition.notify_one();
+}
+
+void ResidencyManager::finishLoads()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		m_uploads.insert(m_uploads.end(), m_parsed.begin(), m_parsed.end());
+		m_parsed.clear();
+	}
+
+	unsigned int uploaded = 0;
+
+	while (!m_uploads.empty())
+	{
+		Job* job = m_uploads.front();
+
+		if (job->cancelled)
+		{
+			delete job->parser;
+			delete job;
+
+			m_uploads.pop_front();
+			continue;
+		}
+
+		unsigned int bytes = meshBytes(job->parser, job->model->m_quantize);
+
+		if (uploaded > 0 && uploaded + bytes > m_uploadBudget)
+			break;
+
+		m_uploads.pop_front();
+		m_loading.erase(job->model);
+
+		if (job->parser != NULL)
+		{
+			makeResident(job->model, job->parser);
+			uploaded += bytes;
+		}
+		else
+		{
+			//not tried again, it would fail every frame
+			CCLOG("cocos3d: can't stream %s", job->objFile.c_str());
+			m_failed.insert(job->model);
+
+			job->model->evict();
+			releaseTexture(job->model);
+		}
+
+		delete job;
+	}
+}
+
+void ResidencyManager::makeResident(Model* model, OBJParser* parser)
+{
+	//the buffers are VBOCache's, the entry is what keeps them there
+	if (m_cache->getReferences(model->m_meshId) == 0)
+	{
+		CCObject* mesh = new CCObject();
+		m_cache->add(model->m_meshId, kRenderResourceMesh, mesh, meshBytes(parser, model->m_quantize));
+		mesh->release();
+	}
+
+	m_cache->retainResource(model->m_meshId);
+
+	//the parser goes with it
+	model->makeResident(parser);
+
+	m_residentCount++;
+}
+
+void ResidencyManager::evict(Model* model)
+{
+	//the model lets go of its own references first
+	model->evict();
+
+	if (releaseResource(model->m_meshId))
+		VBOCache::sharedVBOCache()->removeVBO(model->m_meshId);
+
+	releaseTexture(model);
+
+	m_residentCount--;
+	m_evictions++;
+}
+
+void ResidencyManager::acquireTexture(Model* model)
+{
+	if (model->m_textureFile.empty())
+		return;
+
+	model->loadTexture();
+
+	//a texture still decoding is held as its request, with no bytes yet
+	if (m_cache->getReferences(model->m_textureFile) == 0)
+	{
+		if (model->m_dTexture != NULL)
+			m_cache->addTexture(model->m_textureFile, model->m_dTexture);
+		else
+		if (model->m_textureRequest != NULL)
+			m_cache->add(model->m_textureFile, kRenderResourceTexture, model->m_textureRequest, 0);
+	}
+
+	m_cache->retainResource(model->m_textureFile);
+}
+
+void ResidencyManager::releaseTexture(Model* model)
+{
+	if (model->m_textureFile.empty() || !releaseResource(model->m_textureFile))
+		return;
+
+	if (CompressedTexture::isCompressedFile(model->m_textureFile))
+		CompressedTexture::removeTextureForFile(model->m_textureFile);
+	else
+		TextureLoader::sharedTextureLoader()->removeTextureForKey(model->m_textureFile);
+}
+
+bool ResidencyManager::releaseResource(const std::string& key)
+{
+	if (m_cache->getReferences(key) == 0)
+		return false;
+
+	m_cache->releaseResource(key);
+
+	if (m_cache->getReferences(key) > 0)
+		return false;
+
+	m_cache->remove(key);
+
+	return true;
+}
+
+void ResidencyManager::startWorker()
+{
+	if (m_worker.joinable())
+		return;
+
+	m_quit = false;
+	m_worker = std::thread(&ResidencyManager::work, this);
+}
+
+void ResidencyManager::stopWorker()
+{
+	if (!m_worker.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+
+	m_condition.notify_all();
+	m_worker.join();
+}
+
+void ResidencyManager::work()
+{
+	while (true)
+	{
+		Job* job = NULL;
+
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+
+			while (!m_quit && m_queued.empty())
+				m_condition.wait(lock);
+
+			if (m_quit)
+				return;
+
+			job = m_queued.front();
+			m_queued.pop_front();
+		}
+
+		//plain file streams, nothing of cocos2d is touched here
+		OBJParser* parser = new OBJParser;
+
+		if (parser->readFile(job->objFile, job->mtlFile, job->scale))
+			job->parser = parser;
+		else
+			delete parser;
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_parsed.push_back(job);
+	}
+}
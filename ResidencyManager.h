@@ -0,0 +1,149 @@
+#ifndef __RESIDENCY_MANAGER_H__
+#define __RESIDENCY_MANAGER_H__
+#include "cocos2d.h"
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "Node3D.h"
+#include "RenderCache.h"
+
+using namespace std;
+using namespace cocos2d;
+
+namespace cocos3d
+{
+	// models closer than this to the camera are loaded
+	#define RESIDENCY_LOAD_DISTANCE 2000.0f
+	// mesh and texture bytes of the cache over which the farthest models are evicted
+	#define RESIDENCY_MEMORY_CEILING (64 * 1024 * 1024)
+	// seconds of camera motion a model is loaded ahead of
+	#define RESIDENCY_LOOK_AHEAD 1.0f
+	// mesh bytes uploaded each frame, a bigger mesh still goes in a frame of its own
+	#define RESIDENCY_UPLOAD_BUDGET (512 * 1024)
+	// meshes parsed at the same time
+	#define RESIDENCY_MAX_LOADS 4
+	// a model in view counts as this much closer
+	#define RESIDENCY_VISIBLE_BIAS 0.5f
+
+	class Model;
+	class Camera;
+	class OBJParser;
+
+	// Keeps the streamed models of a layer resident by how close they are to the camera,
+	// now and where it's heading. Meshes are parsed on a worker thread and uploaded a few
+	// each frame, textures go through TextureLoader, or CompressedTexture for a ktx. Over
+	// the memory ceiling the farthest models out of load distance are evicted. A model
+	// that isn't resident draws its box.
+	// Meshes and textures are entries of a RenderCache, the scene's once the layer is in a
+	// Scene3D, referenced once by each model using the same id or file. They're removed
+	// and freed with the last of them, so they shouldn't be shared with models that
+	// aren't streamed. The entries have no loader: they're never unreferenced while they
+	// are in the cache, and bringing them back is the streaming's job.
+	class ResidencyManager : public CCObject
+	{
+	public:
+		ResidencyManager();
+		~ResidencyManager();
+
+		static ResidencyManager* create();
+
+		// models register themselves the first time they're drawn
+		void addModel(Model* model);
+		void removeModel(Model* model);
+
+		void setLoadDistance(float distance){ m_loadDistance = distance; }
+		// 0 only evicts over the ceiling, otherwise farther models always are
+		void setUnloadDistance(float distance){ m_unloadDistance = distance; }
+		// 0 is no ceiling
+		void setMemoryCeiling(unsigned int bytes){ m_memoryCeiling = bytes; }
+		void setLookAhead(float seconds){ m_lookAhead = seconds; }
+		void setUploadBudget(unsigned int bytes){ m_uploadBudget = bytes; }
+
+		// ignored while anything is loading or resident, the entries stay where they are
+		void setCache(RenderCache* cache);
+		RenderCache* getCache(){ return m_cache; }
+
+		float getLoadDistance(){ return m_loadDistance; }
+		float getUnloadDistance(){ return m_unloadDistance; }
+		unsigned int getMemoryCeiling(){ return m_memoryCeiling; }
+
+		// every mesh and texture of the cache, not only the streamed ones
+		unsigned int getResidentBytes();
+		unsigned int getResidentCount(){ return m_residentCount; }
+		unsigned int getLoadingCount(){ return (unsigned int)m_loading.size(); }
+		unsigned int getEvictionCount(){ return m_evictions; }
+
+		// once a frame, before the models are drawn
+		void update(Camera* camera, float dt);
+
+	private:
+		struct Job
+		{
+			Model* model;
+			std::string meshId;
+			std::string objFile, mtlFile;
+			float scale;
+
+			OBJParser* parser;
+			bool cancelled;
+		};
+
+		struct Candidate
+		{
+			Model* model;
+			float distance;
+
+			bool operator<(const Candidate& other) const { return distance < other.distance; }
+		};
+
+		void startLoad(Model* model);
+		void finishLoads();
+		void makeResident(Model* model, OBJParser* parser);
+		void evict(Model* model);
+		void acquireTexture(Model* model);
+		void releaseTexture(Model* model);
+
+		// true when it was the last reference, the entry is removed then
+		bool releaseResource(const std::string& key);
+
+		void startWorker();
+		void stopWorker();
+		void work();
+
+		std::vector<Model*> m_models;
+		std::map<Model*,Job*> m_loading;
+		std::set<Model*> m_failed;
+
+		RenderCache* m_cache;
+
+		std::thread m_worker;
+		bool m_quit;
+
+		std::mutex m_mutex;
+		std::condition_variable m_condition;
+
+		std::deque<Job*> m_queued;
+		std::deque<Job*> m_parsed;
+
+		// gl thread only
+		std::deque<Job*> m_uploads;
+
+		float m_loadDistance;
+		float m_unloadDistance;
+		unsigned int m_memoryCeiling;
+		float m_lookAhead;
+		unsigned int m_uploadBudget;
+
+		unsigned int m_residentCount;
+		unsigned int m_evictions;
+
+		Vec3 m_lastEye;
+		bool m_hasLastEye;
+	};
+}
+#endif
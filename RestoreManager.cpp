@@ -0,0 +1,119 @@
+#include "RestoreManager.h"
+#include "Model.h"
+#include "VBOCache.h"
+#include "shaders.h"
+#include "GLCapabilities.h"
+#include <chrono>
+
+using namespace cocos3d;
+
+RestoreManager::RestoreManager()
+: m_lastRestoreMs(0)
+{
+#if CC_ENABLE_CACHE_TEXTURE_DATA
+	CCNotificationCenter::sharedNotificationCenter()->addObserver(this,
+		callfuncO_selector(RestoreManager::listenBackToForeground),
+		EVENT_COME_TO_FOREGROUND,
+		NULL);
+#endif
+}
+
+RestoreManager::~RestoreManager()
+{
+#if CC_ENABLE_CACHE_TEXTURE_DATA
+	CCNotificationCenter::sharedNotificationCenter()->removeObserver(this, EVENT_COME_TO_FOREGROUND);
+#endif
+}
+
+RestoreManager* RestoreManager::sharedRestoreManager()
+{
+	static RestoreManager* manager = nullptr;
+
+	if (manager == nullptr)
+	{
+		manager = new RestoreManager();
+		manager->autorelease();
+		manager->retain();
+	}
+
+	return manager;
+}
+
+void RestoreManager::addNode(Node3D* node)
+{
+	m_nodes.insert(node);
+}
+
+void RestoreManager::removeNode(Node3D* node)
+{
+	m_nodes.erase(node);
+}
+
+void RestoreManager::addListener(RestoreListener* listener)
+{
+	m_listeners.insert(listener);
+}
+
+void RestoreManager::removeListener(RestoreListener* listener)
+{
+	m_listeners.erase(listener);
+}
+
+void RestoreManager::listenBackToForeground(CCObject *obj)
+{
+	CC_UNUSED_PARAM(obj);
+
+	restore();
+}
+
+bool RestoreManager::claimProgram(const std::string& key)
+{
+	return m_claimedPrograms.insert(key).second;
+}
+
+void RestoreManager::restore()
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	//a new context, maybe not the same driver, before anything asks what it can do
+	GLCapabilities::sharedGLCapabilities()->invalidate();
+
+	//the old buffer names are gone with the context
+	VBOCache::sharedVBOCache()->purgeCache();
+
+	//a copy, one may go away while restoring another
+	std::set<RestoreListener*> listeners(m_listeners);
+
+	for (auto iter = listeners.begin(); iter != listeners.end(); iter++)
+		(*iter)->restoreGLState();
+
+	std::set<unsigned int> programs;
+	std::set<std::string> meshes;
+
+	for (auto iter = m_nodes.begin(); iter != m_nodes.end(); iter++)
+	{
+		Model* model = dynamic_cast<Model*>(*iter);
+
+		if (model != NULL)
+		{
+			programs.insert(model->getShaderFeatures());
+			meshes.insert(model->getMeshId());
+		}
+	}
+
+	for (auto iter = programs.begin(); iter != programs.end(); iter++)
+		reloadPhongProgramForFeatures(*iter);
+
+	m_claimedPrograms.clear();
+
+	//meshes shared by id are uploaded by the first model, the rest hit the cache
+	for (auto iter = m_nodes.begin(); iter != m_nodes.end(); iter++)
+		(*iter)->restoreGLState();
+
+	m_claimedPrograms.clear();
+
+	m_lastRestoreMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	CCLOG("cocos3d: restored %u programs, %u meshes for %u nodes in %.2f ms",
+		(unsigned int)programs.size(), (unsigned int)meshes.size(), (unsigned int)m_nodes.size(), m_lastRestoreMs);
+}
@@ -0,0 +1,58 @@
+#ifndef __RESTORE_MANAGER_H__
+#define __RESTORE_MANAGER_H__
+#include "cocos2d.h"
+#include <set>
+#include <string>
+
+using namespace std;
+using namespace cocos2d;
+
+namespace cocos3d
+{
+	class Node3D;
+
+	// GL objects that aren't nodes, a texture or a buffer of their own, restored
+	// before the programs and the nodes
+	class RestoreListener
+	{
+	public:
+		virtual ~RestoreListener(){}
+
+		virtual void restoreGLState() = 0;
+	};
+
+	// Restores the GL state of every registered node after a context loss. Each
+	// distinct program is rebuilt and each distinct mesh uploaded once, then the
+	// nodes pick them up from the shader and VBO caches and resolve their locations.
+	class RestoreManager : public CCObject
+	{
+	public:
+		RestoreManager();
+		~RestoreManager();
+
+		static RestoreManager* sharedRestoreManager();
+
+		void addNode(Node3D* node);
+		void removeNode(Node3D* node);
+
+		void addListener(RestoreListener* listener);
+		void removeListener(RestoreListener* listener);
+
+		void restore();
+
+		// true only for the first node asking for the program during a restore,
+		// that one rebuilds it and the others reuse it
+		bool claimProgram(const std::string& key);
+
+		void listenBackToForeground(CCObject *obj);
+
+		double getLastRestoreTime(){ return m_lastRestoreMs; }
+	private:
+		std::set<Node3D*> m_nodes;
+		std::set<RestoreListener*> m_listeners;
+		std::set<std::string> m_claimedPrograms;
+
+		double m_lastRestoreMs;
+	};
+}
+#endif
@@ -11,7 +11,8 @@ bool Scene3D::init()
 
 Scene3D::~Scene3D()
 {
-	delete m_cache;
+	//the layers' residency managers may still hold it
+	CC_SAFE_RELEASE(m_cache);
 }
 
 RenderCache* Scene3D::getCache()
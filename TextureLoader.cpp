@@ -0,0 +1,550 @@
+#include "TextureLoader.h"
+#include "GLCapabilities.h"
+#include <string.h>
+
+using namespace cocos3d;
+
+// a texture with the mip levels uploaded next to it
+class DecodedTexture : public CCTexture2D
+{
+public:
+	void setHasMipmaps(bool mipmaps){ m_bHasMipmaps = mipmaps; }
+
+	// the name died with the context, it may be another texture's by now
+	void forgetName(){ m_uName = 0; }
+};
+
+TextureRequest::TextureRequest(const std::string& key)
+: m_key(key)
+, m_done(false)
+, m_texture(NULL)
+{
+}
+
+TextureRequest::~TextureRequest()
+{
+	CC_SAFE_RELEASE(m_texture);
+
+	for (auto iter = m_callbacks.begin(); iter != m_callbacks.end(); iter++)
+		iter->first->release();
+}
+
+void TextureRequest::addCallback(CCObject* target, SEL_CallFuncO selector)
+{
+	if (m_done)
+	{
+		(target->*selector)(this);
+		return;
+	}
+
+	target->retain();
+	m_callbacks.push_back(std::make_pair(target, selector));
+}
+
+void TextureRequest::finish(CCTexture2D* texture)
+{
+	if (texture != m_texture)
+	{
+		CC_SAFE_RETAIN(texture);
+		CC_SAFE_RELEASE(m_texture);
+		m_texture = texture;
+	}
+
+	m_done = true;
+
+	std::vector<std::pair<CCObject*, SEL_CallFuncO> > callbacks;
+	callbacks.swap(m_callbacks);
+
+	for (auto iter = callbacks.begin(); iter != callbacks.end(); iter++)
+	{
+		(iter->first->*iter->second)(this);
+		iter->first->release();
+	}
+}
+
+void TextureRequest::restart()
+{
+	//until it's uploaded again the models holding the texture bind nothing
+	if (m_texture != NULL)
+		((DecodedTexture*)m_texture)->forgetName();
+
+	m_done = false;
+}
+
+TextureLoader::TextureLoader()
+: m_threadCount(0)
+, m_quit(false)
+, m_inFlight(0)
+, m_uploadBudget(TEXTURE_LOADER_UPLOAD_BUDGET)
+, m_scheduled(false)
+{
+#if CC_ENABLE_CACHE_TEXTURE_DATA
+	RestoreManager::sharedRestoreManager()->addListener(this);
+#endif
+}
+
+TextureLoader::~TextureLoader()
+{
+#if CC_ENABLE_CACHE_TEXTURE_DATA
+	RestoreManager::sharedRestoreManager()->removeListener(this);
+#endif
+
+	stopWorkers();
+
+	std::deque<Job*> jobs(m_queued);
+	jobs.insert(jobs.end(), m_decoded.begin(), m_decoded.end());
+
+	for (auto iter = jobs.begin(); iter != jobs.end(); iter++)
+	{
+		if ((*iter)->pixels != NULL)
+			delete (*iter)->pixels;
+
+		(*iter)->request->release();
+		delete *iter;
+	}
+
+	for (auto iter = m_freeBuffers.begin(); iter != m_freeBuffers.end(); iter++)
+		delete *iter;
+
+	for (auto iter = m_requests.begin(); iter != m_requests.end(); iter++)
+		iter->second->release();
+}
+
+TextureLoader* TextureLoader::sharedTextureLoader()
+{
+	static TextureLoader* loader = nullptr;
+
+	if (loader == nullptr)
+	{
+		loader = new TextureLoader();
+		loader->autorelease();
+		loader->retain();
+	}
+
+	return loader;
+}
+
+void TextureLoader::setThreadCount(unsigned int threads)
+{
+	if (threads == m_threadCount)
+		return;
+
+	stopWorkers();
+
+	m_threadCount = threads;
+
+	//the jobs still queued would wait for the next load otherwise
+	if (!m_queued.empty())
+		startWorkers();
+}
+
+TextureRequest* TextureLoader::loadAsync(const std::string& key, const char* data, unsigned long size, bool mipmaps)
+{
+	auto found = m_requests.find(key);
+
+	if (found != m_requests.end())
+		return found->second;
+
+	Job* job = new Job();
+	job->encoded.assign((const unsigned char*)data, (const unsigned char*)data + size);
+	job->mipmaps = mipmaps;
+
+	return enqueue(key, job);
+}
+
+TextureRequest* TextureLoader::loadFileAsync(const std::string& file, bool mipmaps)
+{
+	auto found = m_requests.find(file);
+
+	if (found != m_requests.end())
+		return found->second;
+
+	Job* job = new Job();
+	job->file = CCFileUtils::sharedFileUtils()->fullPathForFilename(file.c_str());
+	job->mipmaps = mipmaps;
+
+	return enqueue(file, job);
+}
+
+TextureRequest* TextureLoader::enqueue(const std::string& key, Job* job)
+{
+	TextureRequest* request = m_requests[key];
+
+	if (request == NULL)
+	{
+		request = new TextureRequest(key);
+		m_requests[key] = request;
+	}
+
+	//the job keeps it even if the key is removed before it's done
+	request->retain();
+
+	job->request = request;
+	job->pixels = NULL;
+	job->width = job->height = job->bpp = 0;
+
+#if CC_ENABLE_CACHE_TEXTURE_DATA
+	//to decode it again when the context is lost
+	Source& source = m_sources[key];
+	source.file = job->file;
+	source.encoded = job->encoded;
+	source.mipmaps = job->mipmaps;
+#endif
+
+	startWorkers();
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_queued.push_back(job);
+	}
+
+	m_condition.notify_one();
+	m_inFlight++;
+
+	if (!m_scheduled)
+	{
+		CCDirector::sharedDirector()->getScheduler()->scheduleSelector(schedule_selector(TextureLoader::uploadDecoded), this, 0, false);
+		m_scheduled = true;
+	}
+
+	return request;
+}
+
+CCTexture2D* TextureLoader::textureForKey(const std::string& key)
+{
+	auto found = m_requests.find(key);
+
+	if (found == m_requests.end())
+		return NULL;
+
+	return found->second->getTexture();
+}
+
+void TextureLoader::removeTextureForKey(const std::string& key)
+{
+	auto found = m_requests.find(key);
+
+	if (found == m_requests.end())
+		return;
+
+	found->second->release();
+
+	m_requests.erase(found);
+	m_sources.erase(key);
+}
+
+void TextureLoader::startWorkers()
+{
+	if (!m_workers.empty())
+		return;
+
+	unsigned int threads = m_threadCount;
+
+	//the gl thread has enough to do
+	if (threads == 0)
+		threads = MAX(2u, std::thread::hardware_concurrency()) - 1;
+
+	m_quit = false;
+
+	for (unsigned int i = 0; i < threads; i++)
+		m_workers.push_back(std::thread(&TextureLoader::work, this));
+}
+
+void TextureLoader::stopWorkers()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+
+	m_condition.notify_all();
+
+	for (auto iter = m_workers.begin(); iter != m_workers.end(); iter++)
+		iter->join();
+
+	m_workers.clear();
+}
+
+void TextureLoader::work()
+{
+	while (true)
+	{
+		Job* job = NULL;
+
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+
+			while (!m_quit && m_queued.empty())
+				m_condition.wait(lock);
+
+			if (m_quit)
+				return;
+
+			job = m_queued.front();
+			m_queued.pop_front();
+		}
+
+		decode(job);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_decoded.push_back(job);
+	}
+}
+
+// Worker thread: the image and a box filtered mip chain after it, in one pooled buffer.
+void TextureLoader::decode(Job* job)
+{
+	CCImage* image = new CCImage();
+
+	bool decoded = false;
+
+	if (!job->file.empty())
+		decoded = image->initWithImageFileThreadSafe(job->file.c_str());
+	else
+	if (!job->encoded.empty())
+		decoded = image->initWithImageData(&(job->encoded[0]), (int)job->encoded.size());
+
+	std::vector<unsigned char>().swap(job->encoded);
+
+	if (!decoded || image->getData() == NULL)
+	{
+		image->release();
+		return;
+	}
+
+	job->width = image->getWidth();
+	job->height = image->getHeight();
+	job->bpp = image->hasAlpha() ? 4 : 3;
+
+	//gles2 only mipmaps power of two textures
+	bool pot = (ccNextPOT(job->width) == job->width && ccNextPOT(job->height) == job->height);
+
+	unsigned int width = job->width, height = job->height;
+	size_t size = 0;
+
+	while (true)
+	{
+		job->levelOffsets.push_back(size);
+		size += width * height * job->bpp;
+
+		if (!job->mipmaps || !pot || (width == 1 && height == 1))
+			break;
+
+		width = MAX(width / 2, 1u);
+		height = MAX(height / 2, 1u);
+	}
+
+	job->pixels = acquireBuffer(size);
+
+	unsigned char* pixels = &(*job->pixels)[0];
+	memcpy(pixels, image->getData(), job->width * job->height * job->bpp);
+
+	image->release();
+
+	unsigned int bpp = job->bpp;
+	width = job->width;
+	height = job->height;
+
+	for (unsigned int level = 1; level < job->levelOffsets.size(); level++)
+	{
+		const unsigned char* src = pixels + job->levelOffsets[level - 1];
+		unsigned char* dst = pixels + job->levelOffsets[level];
+
+		unsigned int levelWidth = MAX(width / 2, 1u);
+		unsigned int levelHeight = MAX(height / 2, 1u);
+
+		for (unsigned int y = 0; y < levelHeight; y++)
+		{
+			unsigned int y0 = y * 2, y1 = MIN(y * 2 + 1, height - 1);
+
+			for (unsigned int x = 0; x < levelWidth; x++)
+			{
+				unsigned int x0 = x * 2, x1 = MIN(x * 2 + 1, width - 1);
+
+				for (unsigned int c = 0; c < bpp; c++)
+				{
+					unsigned int sum = src[(y0 * width + x0) * bpp + c] + src[(y0 * width + x1) * bpp + c]
+									 + src[(y1 * width + x0) * bpp + c] + src[(y1 * width + x1) * bpp + c];
+
+					dst[(y * levelWidth + x) * bpp + c] = (unsigned char)((sum + 2) / 4);
+				}
+			}
+		}
+
+		width = levelWidth;
+		height = levelHeight;
+	}
+}
+
+// Gl thread: returns the bytes it uploaded.
+unsigned int TextureLoader::upload(Job* job)
+{
+	if (job->pixels == NULL)
+	{
+		CCLOG("cocos3d: TextureLoader can't decode %s", job->request->getKey().c_str());
+
+		job->request->finish(NULL);
+		return 0;
+	}
+
+	//when the context was lost the same texture is uploaded again
+	DecodedTexture* texture = (DecodedTexture*)job->request->getTexture();
+
+	if (texture == NULL)
+	{
+		texture = new DecodedTexture();
+		texture->autorelease();
+	}
+
+	const unsigned char* pixels = &(*job->pixels)[0];
+	GLenum format = (job->bpp == 4) ? GL_RGBA : GL_RGB;
+
+	texture->initWithData(pixels,
+		(job->bpp == 4) ? kCCTexture2DPixelFormat_RGBA8888 : kCCTexture2DPixelFormat_RGB888,
+		job->width, job->height, CCSizeMake(job->width, job->height));
+
+	bool mipmaps = (job->levelOffsets.size() > 1);
+
+	if (mipmaps)
+	{
+		ccGLBindTexture2D(texture->getName());
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+		unsigned int width = job->width, height = job->height;
+
+		for (unsigned int level = 1; level < job->levelOffsets.size(); level++)
+		{
+			width = MAX(width / 2, 1u);
+			height = MAX(height / 2, 1u);
+
+			glTexImage2D(GL_TEXTURE_2D, level, format, width, height, 0, format, GL_UNSIGNED_BYTE, pixels + job->levelOffsets[level]);
+		}
+
+		texture->setHasMipmaps(true);
+
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+
+		GLfloat maxAnisotropy = GLCapabilities::sharedGLCapabilities()->getMaxAnisotropy();
+
+		if (maxAnisotropy > 0)
+			glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, maxAnisotropy);
+	}
+
+	CHECK_GL_ERROR_DEBUG();
+
+	unsigned int bytes = (unsigned int)job->pixels->size();
+
+	releaseBuffer(job->pixels);
+	job->pixels = NULL;
+
+	job->request->finish(texture);
+
+	return bytes;
+}
+
+void TextureLoader::uploadDecoded(float dt)
+{
+	CC_UNUSED_PARAM(dt);
+
+	unsigned int uploaded = 0;
+
+	while (uploaded < m_uploadBudget)
+	{
+		Job* job = NULL;
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			if (!m_decoded.empty())
+			{
+				job = m_decoded.front();
+
+				unsigned int bytes = (job->pixels != NULL) ? (unsigned int)job->pixels->size() : 0;
+
+				//one texture over the budget still goes up alone, or it never would
+				if (uploaded > 0 && uploaded + bytes > m_uploadBudget)
+					break;
+
+				m_decoded.pop_front();
+			}
+		}
+
+		if (job == NULL)
+			break;
+
+		uploaded += upload(job);
+
+		job->request->release();
+		delete job;
+
+		m_inFlight--;
+	}
+
+	if (m_inFlight == 0)
+	{
+		CCDirector::sharedDirector()->getScheduler()->unscheduleSelector(schedule_selector(TextureLoader::uploadDecoded), this);
+		m_scheduled = false;
+	}
+}
+
+void TextureLoader::restoreGLState()
+{
+	//decoded again and uploaded into the same textures, the models keep theirs but
+	//the requests are pending again until then
+	std::map<std::string, Source> sources(m_sources);
+
+	for (auto iter = sources.begin(); iter != sources.end(); iter++)
+	{
+		auto request = m_requests.find(iter->first);
+
+		if (request == m_requests.end() || !request->second->isDone() || request->second->getTexture() == NULL)
+			continue;
+
+		Job* job = new Job();
+		job->file = iter->second.file;
+		job->encoded = iter->second.encoded;
+		job->mipmaps = iter->second.mipmaps;
+
+		request->second->restart();
+		enqueue(iter->first, job);
+	}
+}
+
+std::vector<unsigned char>* TextureLoader::acquireBuffer(size_t size)
+{
+	std::vector<unsigned char>* buffer = NULL;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		for (auto iter = m_freeBuffers.begin(); iter != m_freeBuffers.end(); iter++)
+		{
+			if ((*iter)->capacity() >= size)
+			{
+				buffer = *iter;
+				m_freeBuffers.erase(iter);
+				break;
+			}
+		}
+	}
+
+	if (buffer == NULL)
+		buffer = new std::vector<unsigned char>();
+
+	buffer->resize(size);
+
+	return buffer;
+}
+
+void TextureLoader::releaseBuffer(std::vector<unsigned char>* buffer)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_freeBuffers.size() < TEXTURE_LOADER_POOLED_BUFFERS)
+	{
+		m_freeBuffers.push_back(buffer);
+		return;
+	}
+
+	delete buffer;
+}
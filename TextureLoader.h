@@ -0,0 +1,131 @@
+#ifndef __TEXTURE_LOADER_H__
+#define __TEXTURE_LOADER_H__
+#include "cocos2d.h"
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "RestoreManager.h"
+
+using namespace std;
+using namespace cocos2d;
+
+namespace cocos3d
+{
+	// bytes uploaded each frame, a bigger texture still goes in a frame of its own
+	#define TEXTURE_LOADER_UPLOAD_BUDGET (1024 * 1024)
+	// decoded pixel buffers kept for the next decodes
+	#define TEXTURE_LOADER_POOLED_BUFFERS 4
+
+	// The texture of an asynchronous load, done once it's on the gpu (or failed).
+	class TextureRequest : public CCObject
+	{
+	public:
+		TextureRequest(const std::string& key);
+		~TextureRequest();
+
+		const std::string& getKey(){ return m_key; }
+		bool isDone(){ return m_done; }
+
+		// NULL until it's done, and when the image couldn't be decoded
+		CCTexture2D* getTexture(){ return m_texture; }
+
+		// called on the gl thread once it's done, right away if it already is
+		void addCallback(CCObject* target, SEL_CallFuncO selector);
+
+	private:
+		friend class TextureLoader;
+
+		void finish(CCTexture2D* texture);
+		// not done anymore, its texture has no name until the next finish
+		void restart();
+
+		std::string m_key;
+		bool m_done;
+		CCTexture2D* m_texture;
+
+		std::vector<std::pair<CCObject*, SEL_CallFuncO> > m_callbacks;
+	};
+
+	// Decodes images on a pool of worker threads into pooled pixel buffers, mip levels
+	// included, and uploads them on the gl thread a few each frame, within a byte budget.
+	// Textures are cached by key, a second request for a key shares the first one.
+	class TextureLoader : public CCObject, public RestoreListener
+	{
+	public:
+		TextureLoader();
+		~TextureLoader();
+
+		static TextureLoader* sharedTextureLoader();
+
+		// 0 uses one thread per hardware core but the gl one, started on the first load
+		void setThreadCount(unsigned int threads);
+		void setUploadBudget(unsigned int bytes){ m_uploadBudget = bytes; }
+
+		// the encoded image is copied, the buffer can go right away
+		TextureRequest* loadAsync(const std::string& key, const char* data, unsigned long size, bool mipmaps = true);
+		TextureRequest* loadFileAsync(const std::string& file, bool mipmaps = true);
+
+		CCTexture2D* textureForKey(const std::string& key);
+		void removeTextureForKey(const std::string& key);
+
+		void uploadDecoded(float dt);
+
+		virtual void restoreGLState();
+
+	private:
+		struct Job
+		{
+			TextureRequest* request;
+
+			std::string file;
+			std::vector<unsigned char> encoded;
+			bool mipmaps;
+
+			std::vector<unsigned char>* pixels;
+			unsigned int width, height, bpp;
+			std::vector<size_t> levelOffsets;
+		};
+
+		struct Source
+		{
+			std::string file;
+			std::vector<unsigned char> encoded;
+			bool mipmaps;
+		};
+
+		TextureRequest* enqueue(const std::string& key, Job* job);
+
+		void startWorkers();
+		void stopWorkers();
+		void work();
+
+		void decode(Job* job);
+		unsigned int upload(Job* job);
+
+		std::vector<unsigned char>* acquireBuffer(size_t size);
+		void releaseBuffer(std::vector<unsigned char>* buffer);
+
+		std::vector<std::thread> m_workers;
+		unsigned int m_threadCount;
+		bool m_quit;
+
+		std::mutex m_mutex;
+		std::condition_variable m_condition;
+
+		std::deque<Job*> m_queued;
+		std::deque<Job*> m_decoded;
+		std::vector<std::vector<unsigned char>*> m_freeBuffers;
+
+		// gl thread only
+		std::map<std::string, TextureRequest*> m_requests;
+		std::map<std::string, Source> m_sources;
+		unsigned int m_inFlight;
+		unsigned int m_uploadBudget;
+		bool m_scheduled;
+	};
+}
+#endif
@@ -0,0 +1,197 @@
+#include "Triangulator.h"
+#include "poly2tri/poly2tri.h"
+#include <thread>
+#include <atomic>
+#include <unordered_map>
+#include <stdexcept>
+
+using namespace cocos3d;
+
+void TriangulationResult::getTriangles(unsigned int shape, std::vector<Vec3>& triangles) const
+{
+	triangles.clear();
+	triangles.reserve(indexCount[shape]);
+
+	for (unsigned int i = firstIndex[shape]; i < firstIndex[shape] + indexCount[shape]; i++)
+		triangles.push_back(vertices[indices[i]]);
+}
+
+Triangulator::Triangulator()
+: m_threadCount(0)
+{
+}
+
+Triangulator::~Triangulator()
+{
+	for (auto iter = m_arenas.begin(); iter != m_arenas.end(); iter++)
+		delete *iter;
+}
+
+Triangulator* Triangulator::sharedTriangulator()
+{
+	static Triangulator* triangulator = nullptr;
+
+	if (triangulator == nullptr)
+	{
+		triangulator = new Triangulator();
+		triangulator->autorelease();
+		triangulator->retain();
+	}
+
+	return triangulator;
+}
+
+void Triangulator::setThreadCount(unsigned int threads)
+{
+	m_threadCount = threads;
+
+	//the arenas of the threads we won't use anymore
+	while (threads > 0 && m_arenas.size() > threads)
+	{
+		delete m_arenas.back();
+		m_arenas.pop_back();
+	}
+}
+
+void Triangulator::triangulateShape(p2t::CDT& cdt, const TriangulationShape& shape, ShapeMesh& mesh)
+{
+	mesh.vertices.clear();
+	mesh.indices.clear();
+	mesh.succeeded = false;
+
+	if (shape.outline.size() < 3)
+		return;
+
+	//vertex i is the i-th point given: outline, then holes, then steiner points
+	std::vector<p2t::Point*> points;
+	std::vector<p2t::Point*> polyline;
+
+	for (auto iter = shape.outline.begin(); iter != shape.outline.end(); iter++)
+		polyline.push_back(cdt.NewPoint(iter->x, iter->y));
+
+	cdt.AddPolyline(polyline);
+	points.insert(points.end(), polyline.begin(), polyline.end());
+
+	for (auto hole = shape.holes.begin(); hole != shape.holes.end(); hole++)
+	{
+		if (hole->size() < 3)
+			continue;
+
+		polyline.clear();
+
+		for (auto iter = hole->begin(); iter != hole->end(); iter++)
+			polyline.push_back(cdt.NewPoint(iter->x, iter->y));
+
+		cdt.AddHole(polyline);
+		points.insert(points.end(), polyline.begin(), polyline.end());
+	}
+
+	for (auto iter = shape.steiner.begin(); iter != shape.steiner.end(); iter++)
+	{
+		points.push_back(cdt.NewPoint(iter->x, iter->y));
+		cdt.AddPoint(points.back());
+	}
+
+	try
+	{
+		cdt.Triangulate();
+	}
+	catch (const std::runtime_error&)
+	{
+		//poly2tri gives up on some degenerate inputs, the shape is just skipped
+		cdt.Clear();
+		return;
+	}
+
+	std::unordered_map<const p2t::Point*, unsigned int> indexOf;
+	indexOf.reserve(points.size());
+
+	mesh.vertices.reserve(points.size());
+
+	for (unsigned int i = 0; i < points.size(); i++)
+	{
+		indexOf[points[i]] = i;
+		mesh.vertices.push_back(Vec3((float)points[i]->x, (float)points[i]->y, 0.0f));
+	}
+
+	const std::vector<p2t::Triangle*>& triangles = cdt.GetTriangles();
+	mesh.indices.reserve(triangles.size() * 3);
+
+	for (auto iter = triangles.begin(); iter != triangles.end(); iter++)
+	{
+		for (int i = 0; i < 3; i++)
+			mesh.indices.push_back(indexOf[(*iter)->GetPoint(i)]);
+	}
+
+	mesh.succeeded = true;
+
+	cdt.Clear();
+}
+
+void Triangulator::triangulate(const std::vector<TriangulationShape>& shapes, TriangulationResult& result)
+{
+	result.vertices.clear();
+	result.indices.clear();
+	result.firstIndex.clear();
+	result.indexCount.clear();
+	result.succeeded.clear();
+
+	if (shapes.empty())
+		return;
+
+	unsigned int threads = m_threadCount;
+
+	if (threads == 0)
+		threads = MAX(1u, std::thread::hardware_concurrency());
+
+	threads = MIN(threads, (unsigned int)shapes.size());
+
+	while (m_arenas.size() < threads)
+		m_arenas.push_back(new p2t::CDT());
+
+	std::vector<ShapeMesh> meshes(shapes.size());
+	std::atomic<size_t> next(0);
+
+	//shapes are handed out one at a time, so a big one doesn't hold back a whole slice
+	auto work = [&](p2t::CDT* cdt)
+	{
+		for (size_t i = next++; i < shapes.size(); i = next++)
+			triangulateShape(*cdt, shapes[i], meshes[i]);
+	};
+
+	std::vector<std::thread> workers;
+
+	for (unsigned int i = 1; i < threads; i++)
+		workers.push_back(std::thread(work, m_arenas[i]));
+
+	work(m_arenas[0]);
+
+	for (auto iter = workers.begin(); iter != workers.end(); iter++)
+		iter->join();
+
+	//packed in shape order, whatever thread did each one
+	size_t vertexCount = 0, indexCount = 0;
+
+	for (auto iter = meshes.begin(); iter != meshes.end(); iter++)
+	{
+		vertexCount += iter->vertices.size();
+		indexCount += iter->indices.size();
+	}
+
+	result.vertices.reserve(vertexCount);
+	result.indices.reserve(indexCount);
+
+	for (auto iter = meshes.begin(); iter != meshes.end(); iter++)
+	{
+		unsigned int base = (unsigned int)result.vertices.size();
+
+		result.firstIndex.push_back((unsigned int)result.indices.size());
+		result.indexCount.push_back((unsigned int)iter->indices.size());
+		result.succeeded.push_back(iter->succeeded);
+
+		result.vertices.insert(result.vertices.end(), iter->vertices.begin(), iter->vertices.end());
+
+		for (auto index = iter->indices.begin(); index != iter->indices.end(); index++)
+			result.indices.push_back(base + *index);
+	}
+}
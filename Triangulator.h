@@ -0,0 +1,74 @@
+#ifndef __TRIANGULATOR_H__
+#define __TRIANGULATOR_H__
+#include "cocos2d.h"
+#include <vector>
+#include "Node3D.h"
+
+using namespace std;
+using namespace cocos2d;
+
+namespace p2t
+{
+	class CDT;
+}
+
+namespace cocos3d
+{
+	// one polygon to triangulate, the outline and holes must not repeat points
+	struct TriangulationShape
+	{
+		std::vector<Vec2> outline;
+		std::vector<std::vector<Vec2> > holes;
+		std::vector<Vec2> steiner;
+	};
+
+	// every shape of a batch packed in flat arrays, shape i owns
+	// indices [firstIndex[i], firstIndex[i] + indexCount[i])
+	// and its indices point in the shared vertices array
+	struct TriangulationResult
+	{
+		std::vector<Vec3> vertices;
+		std::vector<unsigned int> indices;
+
+		std::vector<unsigned int> firstIndex;
+		std::vector<unsigned int> indexCount;
+
+		// false for the shapes poly2tri couldn't triangulate, they have no indices
+		std::vector<bool> succeeded;
+
+		// unindexed triangles of one shape, the layout VBOCache::addDataToVBOs takes
+		void getTriangles(unsigned int shape, std::vector<Vec3>& triangles) const;
+	};
+
+	// Triangulates many independent shapes across worker threads. Each worker owns
+	// a poly2tri CDT whose pools are kept between batches, so a warm triangulator
+	// barely touches the heap. The result doesn't depend on the number of threads.
+	class Triangulator : public CCObject
+	{
+	public:
+		Triangulator();
+		~Triangulator();
+
+		static Triangulator* sharedTriangulator();
+
+		// 0 uses one thread per hardware core
+		void setThreadCount(unsigned int threads);
+		unsigned int getThreadCount(){ return m_threadCount; }
+
+		void triangulate(const std::vector<TriangulationShape>& shapes, TriangulationResult& result);
+
+	private:
+		struct ShapeMesh
+		{
+			std::vector<Vec3> vertices;
+			std::vector<unsigned int> indices;
+			bool succeeded;
+		};
+
+		static void triangulateShape(p2t::CDT& cdt, const TriangulationShape& shape, ShapeMesh& mesh);
+
+		unsigned int m_threadCount;
+		std::vector<p2t::CDT*> m_arenas;
+	};
+}
+#endif
@@ -79,6 +79,274 @@ void VBOCache::addDataToVBOs(const std::string& id,
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
+bool VBOCache::getEdges(const std::string& id, GLuint *ibo, std::vector<int>* firsts, std::vector<int>* counts)
+{
+	auto found = m_edges.find(id);
+
+	if (found == m_edges.end())
+		return false;
+
+	*ibo = found->second.ibo;
+	*firsts = found->second.firsts;
+	*counts = found->second.counts;
+
+	return true;
+}
+
+bool VBOCache::addEdges(const std::string& id,
+						const std::vector<unsigned int>& edges,
+						const std::vector<int>& firsts,
+						const std::vector<int>& counts)
+{
+	if (edges.empty() || m_edges.find(id) != m_edges.end())
+		return false;
+
+	std::vector<GLushort> shortEdges(edges.size());
+
+	for (unsigned int i = 0; i < edges.size(); i++)
+	{
+		//gles2 only has short indices, such a mesh keeps the old wireframe
+		if (edges[i] > 0xFFFF)
+			return false;
+
+		shortEdges[i] = (GLushort)edges[i];
+	}
+
+	EdgeSet set;
+	set.firsts = firsts;
+	set.counts = counts;
+
+	glGenBuffers(1, &set.ibo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, set.ibo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortEdges.size()*sizeof(GLushort), &(shortEdges[0]), GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	m_edges[id] = set;
+
+	return true;
+}
+
+void VBOCache::addQuantizedDataToVBOs(const std::string& id,
+									  const QuantizedVertices& vertices,
+									  const VertexQuantization& quantization)
+{
+	if (m_vbos.find(id) == m_vbos.end())
+		return;
+
+	VBOSet vbos = m_vbos[id];
+
+	glBindBuffer(GL_ARRAY_BUFFER, vbos.vertex);
+	glBufferData(GL_ARRAY_BUFFER, vertices.positions.size()*sizeof(GLushort), &(vertices.positions[0]), GL_STATIC_DRAW);
+
+	if (vertices.texels.size() > 0)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, vbos.texel);
+		glBufferData(GL_ARRAY_BUFFER, vertices.texels.size()*sizeof(GLushort), &(vertices.texels[0]), GL_STATIC_DRAW);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, vbos.normal);
+	glBufferData(GL_ARRAY_BUFFER, vertices.normals.size()*sizeof(GLushort), &(vertices.normals[0]), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	m_quantizations[id] = quantization;
+}
+
+bool VBOCache::getQuantization(const std::string& id, VertexQuantization* quantization)
+{
+	auto found = m_quantizations.find(id);
+
+	if (found == m_quantizations.end())
+		return false;
+
+	*quantization = found->second;
+
+	return true;
+}
+
+void VBOCache::addLODs(const std::string& id, const std::vector<MeshLODLevel>& levels)
+{
+	if (m_lods.find(id) != m_lods.end())
+		return;
+
+	std::vector<LODSet>& lods = m_lods[id];
+
+	//the levels are drawn the same way as the mesh, in its range
+	VertexQuantization quantization;
+	bool quantized = getQuantization(id, &quantization);
+
+	for (auto iter = levels.begin(); iter != levels.end(); iter++)
+	{
+		if (iter->positions.empty())
+			continue;
+
+		LODSet set = { 0, 0, 0, iter->firsts, iter->counts, (unsigned int)iter->positions.size() / 3 };
+
+		glGenBuffers(1, &set.vertex);
+		glGenBuffers(1, &set.normal);
+
+		if (iter->texels.size() > 0)
+			glGenBuffers(1, &set.texel);
+
+		if (quantized)
+		{
+			QuantizedVertices vertices;
+			quantizeVertices(iter->positions, iter->normals, iter->texels, quantization, vertices);
+
+			glBindBuffer(GL_ARRAY_BUFFER, set.vertex);
+			glBufferData(GL_ARRAY_BUFFER, vertices.positions.size()*sizeof(GLushort), &(vertices.positions[0]), GL_STATIC_DRAW);
+
+			glBindBuffer(GL_ARRAY_BUFFER, set.normal);
+			glBufferData(GL_ARRAY_BUFFER, vertices.normals.size()*sizeof(GLushort), &(vertices.normals[0]), GL_STATIC_DRAW);
+
+			if (set.texel != 0)
+			{
+				glBindBuffer(GL_ARRAY_BUFFER, set.texel);
+				glBufferData(GL_ARRAY_BUFFER, vertices.texels.size()*sizeof(GLushort), &(vertices.texels[0]), GL_STATIC_DRAW);
+			}
+		}
+		else
+		{
+			glBindBuffer(GL_ARRAY_BUFFER, set.vertex);
+			glBufferData(GL_ARRAY_BUFFER, iter->positions.size()*sizeof(Vec3), &(iter->positions[0]), GL_STATIC_DRAW);
+
+			glBindBuffer(GL_ARRAY_BUFFER, set.normal);
+			glBufferData(GL_ARRAY_BUFFER, iter->normals.size()*sizeof(Vec3), &(iter->normals[0]), GL_STATIC_DRAW);
+
+			if (set.texel != 0)
+			{
+				glBindBuffer(GL_ARRAY_BUFFER, set.texel);
+				glBufferData(GL_ARRAY_BUFFER, iter->texels.size()*sizeof(Vec2), &(iter->texels[0]), GL_STATIC_DRAW);
+			}
+		}
+
+		lods.push_back(set);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+bool VBOCache::getLODs(const std::string& id, std::vector<LODSet>* lods)
+{
+	auto found = m_lods.find(id);
+
+	if (found == m_lods.end())
+		return false;
+
+	*lods = found->second;
+
+	return true;
+}
+
+static void deleteLODs(std::vector<VBOCache::LODSet>& lods)
+{
+	for (auto iter = lods.begin(); iter != lods.end(); iter++)
+	{
+		glDeleteBuffers(1, &iter->vertex);
+		glDeleteBuffers(1, &iter->normal);
+
+		if (iter->texel != 0)
+			glDeleteBuffers(1, &iter->texel);
+	}
+}
+
+void VBOCache::removeVBO(const std::string& id)
+{
+	m_quantizations.erase(id);
+
+	auto lods = m_lods.find(id);
+
+	if (lods != m_lods.end())
+	{
+		deleteLODs(lods->second);
+		m_lods.erase(lods);
+	}
+
+	auto indices = m_indexBuffers.find(id);
+
+	if (indices != m_indexBuffers.end())
+	{
+		if (indices->second != 0)
+			glDeleteBuffers(1, &indices->second);
+
+		m_indexBuffers.erase(indices);
+	}
+
+	auto edges = m_edges.find(id);
+
+	if (edges != m_edges.end())
+	{
+		glDeleteBuffers(1, &edges->second.ibo);
+		m_edges.erase(edges);
+	}
+
+	auto found = m_vbos.find(id);
+
+	if (found == m_vbos.end())
+		return;
+
+	VBOSet& set = found->second;
+
+	if (set.vertex != 0)
+		glDeleteBuffers(1, &set.vertex);
+
+	if (set.normal != 0)
+		glDeleteBuffers(1, &set.normal);
+
+	if (set.texel != 0)
+		glDeleteBuffers(1, &set.texel);
+
+	m_vbos.erase(found);
+}
+
+GLuint VBOCache::getFramesVBO(const std::string& id, const std::vector<std::vector<Vec2> >& frames)
+{
+	auto found = m_framesVBOs.find(id);
+
+	if (found != m_framesVBOs.end())
+		return found->second;
+
+	std::vector<Vec2> texels;
+
+	for (auto iter = frames.begin(); iter != frames.end(); iter++)
+		texels.insert(texels.end(), iter->begin(), iter->end());
+
+	GLuint vbo = 0;
+
+	if (texels.size() > 0)
+	{
+		glGenBuffers(1, &vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+		glBufferData(GL_ARRAY_BUFFER, texels.size()*sizeof(Vec2), &(texels[0]), GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	m_framesVBOs[id] = vbo;
+
+	return vbo;
+}
+
+GLuint VBOCache::getIndexBuffer(const std::string& id, const std::vector<GLushort>& indices)
+{
+	auto found = m_indexBuffers.find(id);
+
+	if (found != m_indexBuffers.end())
+		return found->second;
+
+	GLuint ibo = 0;
+
+	if (indices.size() > 0)
+	{
+		glGenBuffers(1, &ibo);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size()*sizeof(GLushort), &(indices[0]), GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	}
+
+	m_indexBuffers[id] = ibo;
+
+	return ibo;
+}
+
 void VBOCache::purgeCache()
 {
 	m_cacheInvalidated = false;
@@ -98,6 +366,33 @@ void VBOCache::purgeCache()
 	}
 
 	m_vbos.clear();
+
+	for (auto iter = m_edges.begin(); iter != m_edges.end(); iter++)
+		glDeleteBuffers(1, &iter->second.ibo);
+
+	m_edges.clear();
+
+	for (auto iter = m_framesVBOs.begin(); iter != m_framesVBOs.end(); iter++)
+	{
+		if (iter->second != 0)
+			glDeleteBuffers(1, &iter->second);
+	}
+
+	m_framesVBOs.clear();
+
+	for (auto iter = m_indexBuffers.begin(); iter != m_indexBuffers.end(); iter++)
+	{
+		if (iter->second != 0)
+			glDeleteBuffers(1, &iter->second);
+	}
+
+	m_indexBuffers.clear();
+
+	for (auto iter = m_lods.begin(); iter != m_lods.end(); iter++)
+		deleteLODs(iter->second);
+
+	m_lods.clear();
+	m_quantizations.clear();
 }
 
 void VBOCache::listenBackToForeground(CCObject *obj)
@@ -4,6 +4,8 @@
 #include <string>
 #include <map>
 #include "Node3D.h"
+#include "MeshSimplifier.h"
+#include "MeshQuantizer.h"
 
 using namespace std;
 using namespace cocos2d;
@@ -27,6 +29,41 @@ namespace cocos3d
 							const std::vector<Vec2>& texels,
 							bool overwrite = false);
 
+		// the compact format, the buffers hold unsigned shorts (see QuantizedVertices) and
+		// the quantization is kept for every model drawing the mesh, its levels included
+		void addQuantizedDataToVBOs(const std::string& id,
+									const QuantizedVertices& vertices,
+									const VertexQuantization& quantization);
+		bool getQuantization(const std::string& id, VertexQuantization* quantization);
+
+		// unique edges of a mesh for wireframe, drawn with GL_LINES and short indices,
+		// firsts and counts are the edges of each material group
+		bool getEdges(const std::string& id, GLuint *ibo, std::vector<int>* firsts, std::vector<int>* counts);
+		bool addEdges(const std::string& id,
+					  const std::vector<unsigned int>& edges,
+					  const std::vector<int>& firsts,
+					  const std::vector<int>& counts);
+
+		void removeVBO(const std::string& id);
+
+		// one static buffer with the texels of every frame, frame i starts at vertex i*texelsPerFrame
+		GLuint getFramesVBO(const std::string& id, const std::vector<std::vector<Vec2> >& frames);
+
+		// simplified levels of a mesh, coarser one after the other, the mesh itself isn't one
+		struct LODSet
+		{
+			GLuint vertex, normal, texel;
+			std::vector<int> firsts, counts;
+			unsigned int triangles;
+		};
+
+		// an empty chain is kept too, so the mesh isn't simplified again
+		void addLODs(const std::string& id, const std::vector<MeshLODLevel>& levels);
+		bool getLODs(const std::string& id, std::vector<LODSet>* lods);
+
+		// static index buffer of a mesh, created from the indices the first time
+		GLuint getIndexBuffer(const std::string& id, const std::vector<GLushort>& indices);
+
 		void purgeCache();
 
 		void listenBackToForeground(CCObject *obj);
@@ -38,7 +75,18 @@ namespace cocos3d
 			GLuint vertex, normal, texel, interleaved;
 		};
 
+		struct EdgeSet
+		{
+			GLuint ibo;
+			std::vector<int> firsts, counts;
+		};
+
 		map<std::string,VBOSet> m_vbos;
+		map<std::string,EdgeSet> m_edges;
+		map<std::string,GLuint> m_framesVBOs;
+		map<std::string,GLuint> m_indexBuffers;
+		map<std::string,std::vector<LODSet> > m_lods;
+		map<std::string,VertexQuantization> m_quantizations;
 
 		bool m_cacheInvalidated;
 	};
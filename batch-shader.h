@@ -0,0 +1,38 @@
+#include "cocos2d.h"
+
+static const GLchar* glslBillboardBatchVert =
+"attribute vec3 a_position;																		\n"
+"attribute vec3 a_corner;																		\n"
+"attribute vec2 a_texCoord;																		\n"
+"attribute vec4 a_color;																		\n"
+"																								\n"
+"uniform float uScale;																			\n"
+"																								\n"
+"varying vec4 v_color;																			\n"
+"varying vec2 v_texCoord;																		\n"
+"																								\n"
+"void main()																					\n"
+"{																								\n"
+"	vec4 center = CC_MVMatrix * vec4(a_position, 1.0);											\n"
+"																								\n"
+"	float s = sin(a_corner.z);																	\n"
+"	float c = cos(a_corner.z);																	\n"
+"	vec2 corner = vec2(a_corner.x * c - a_corner.y * s, a_corner.x * s + a_corner.y * c) * uScale;\n"
+"																								\n"
+"	gl_Position = CC_PMatrix * (center + vec4(corner, 0.0, 0.0));								\n"
+"																								\n"
+"	v_color = a_color;																			\n"
+"	v_texCoord = a_texCoord;																	\n"
+"}																								\n";
+
+static const GLchar* glslBillboardBatchFrag =
+"precision mediump float;																		\n"
+"varying vec4 v_color;																			\n"
+"varying vec2 v_texCoord;																		\n"
+"																								\n"
+"uniform sampler2D uTexture;																	\n"
+"																								\n"
+"void main()																					\n"
+"{																								\n"
+"	gl_FragColor = v_color * texture2D(uTexture, v_texCoord);									\n"
+"}																								\n";
@@ -0,0 +1,37 @@
+#include "cocos2d.h"
+
+static const GLchar* glslImpostorVert =
+"attribute vec3 a_position;																		\n"
+"attribute vec2 a_texCoord;																		\n"
+"																								\n"
+"uniform vec3 uCenter;																			\n"
+"uniform float uSize;																			\n"
+"uniform vec4 uFrame;																			\n"
+"																								\n"
+"varying vec2 v_texCoord;																		\n"
+"																								\n"
+"void main()																					\n"
+"{																								\n"
+"	vec4 center = CC_MVMatrix * vec4(uCenter, 1.0);												\n"
+"																								\n"
+"	gl_Position = CC_PMatrix * (center + vec4(a_position.xy * uSize, 0.0, 0.0));				\n"
+"																								\n"
+"	v_texCoord = uFrame.xy + a_texCoord * uFrame.zw;											\n"
+"}																								\n";
+
+static const GLchar* glslImpostorFrag =
+"precision mediump float;																		\n"
+"varying vec2 v_texCoord;																		\n"
+"																								\n"
+"uniform sampler2D uTexture;																	\n"
+"uniform float uAlpha;																			\n"
+"																								\n"
+"void main()																					\n"
+"{																								\n"
+"	vec4 color = texture2D(uTexture, v_texCoord);												\n"
+"																								\n"
+"	if (color.a < 0.5)																			\n"
+"		discard;																				\n"
+"																								\n"
+"	gl_FragColor = vec4(color.rgb, color.a * uAlpha);											\n"
+"}																								\n";
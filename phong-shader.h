@@ -480,4 +480,226 @@ static const GLchar* glslPhongVertTextureAnimated =
 "	gl_Position = CC_MVPMatrix * vec4(a_position, 1.0);																								\n"
 "}																																					\n";
 
-static const GLchar* glslPhongFragTextureAnimated = glslPhongFragTexture;
\ No newline at end of file
+static const GLchar* glslPhongFragTextureAnimated = glslPhongFragTexture;
+
+static const GLchar* glslPhongPermutationVert =
+"// Features are switched on by the #defines injected in front of this source,																\n"
+"// see phongPermutationDefines in shaders.h																								\n"
+"#define MAX_LIGHTS 4																														\n"
+"#ifndef NUM_LIGHTS																															\n"
+"#define NUM_LIGHTS MAX_LIGHTS																												\n"
+"#endif																																		\n"
+"attribute vec3 a_position;																													\n"
+"#ifdef QUANTIZED																															\n"
+"attribute vec2 a_normal;																													\n"
+"#else																																		\n"
+"attribute vec3 a_normal;																													\n"
+"#endif																																		\n"
+"#ifdef TEXTURED																															\n"
+"attribute vec2 a_texCoord;																													\n"
+"#endif																																		\n"
+"#ifdef ANIMATED_HULL																														\n"
+"attribute vec3 a_links;																													\n"
+"#endif																																		\n"
+"																																			\n"
+"uniform mat4 CC_MMatrix;																													\n"
+"uniform mat4 CC_NormalMatrix;																												\n"
+"uniform vec3 uDiffuse;																														\n"
+"uniform vec3 uSpecular;																													\n"
+"#if NUM_LIGHTS > 0																															\n"
+"uniform vec3 uLightAmbience[MAX_LIGHTS];																									\n"
+"uniform vec3 uLightDiffuse[MAX_LIGHTS];																									\n"
+"uniform float uLightIntensity[MAX_LIGHTS];																									\n"
+"uniform vec3 uLightPosition[MAX_LIGHTS];																									\n"
+"uniform vec3 uLightAttenuation[MAX_LIGHTS];																									\n"
+"#endif																																		\n"
+"																																			\n"
+"uniform float alpha;																														\n"
+"																																			\n"
+"#ifdef TEXTURE_ATLAS																														\n"
+"uniform vec4 uTexCoordTransform;																											\n"
+"#endif																																		\n"
+"																																			\n"
+"#ifdef QUANTIZED																															\n"
+"// texels are unorm16 in the range of the mesh, positions in its box (see CC_MVMatrix)														\n"
+"uniform vec4 uTexelRange;																													\n"
+"																																			\n"
+"// octahedral normal, both components unorm16																								\n"
+"vec3 decodeNormal(vec2 encoded)																											\n"
+"{																																			\n"
+"	vec2 e = encoded * 2.0 - 1.0;																											\n"
+"	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));																							\n"
+"																																			\n"
+"	if (n.z < 0.0)																															\n"
+"		n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);													\n"
+"																																			\n"
+"	return normalize(n);																													\n"
+"}																																			\n"
+"#endif																																		\n"
+"																																			\n"
+"#ifdef SHADOWS																																\n"
+"uniform mat4 uShadowProjectionMatrix;																										\n"
+"varying vec4 v_projectorCoord;																												\n"
+"#endif																																		\n"
+"																																			\n"
+"varying vec4 v_color;																														\n"
+"#ifdef TEXTURED																															\n"
+"varying vec2 v_texCoord;																													\n"
+"#endif																																		\n"
+"																																			\n"
+"void main()																																\n"
+"{																																			\n"
+"	highp vec3 frontColor = vec3(0.0);																										\n"
+"																																			\n"
+"#if NUM_LIGHTS > 0																															\n"
+"	vec3 defaultAmbience = vec3(0.05);																										\n"
+"#ifdef QUANTIZED																															\n"
+"	vec3 newNormal = decodeNormal(a_normal);																								\n"
+"#else																																		\n"
+"	vec3 newNormal = a_normal;																												\n"
+"#endif																																		\n"
+"																																			\n"
+"#ifdef ANIMATED_HULL																														\n"
+"	newNormal -= a_links*sin(CC_Time.x);																									\n"
+"#endif																																		\n"
+"																																			\n"
+"	// all following gemetric computations are performed in the																				\n"
+"	// camera coordinate system (aka eye coordinates)																						\n"
+"																																			\n"
+"	highp vec3 normal = normalize(vec3(CC_NormalMatrix * vec4(newNormal, 0.0)));															\n"
+"	vec4 vertPos4 = CC_MVMatrix * vec4(a_position, 1.0);																					\n"
+"	highp vec3 vertPos = vec3(vertPos4) / vertPos4.w;																						\n"
+"																																			\n"
+"#if defined(SHINE_SPECULAR) || defined(SHINE_LAMBERTIAN)																					\n"
+"	highp vec3 viewDir = normalize(vertPos);																								\n"
+"#endif																																		\n"
+"																																			\n"
+"	// the lights are in the space of the layer, their falloff is by distance in it															\n"
+"	highp vec3 worldPos = vec3(CC_MMatrix * vec4(a_position, 1.0));																			\n"
+"																																			\n"
+"	for (int i = 0; i < NUM_LIGHTS; i++)																									\n"
+"	{																																		\n"
+"		highp vec3 lightDir = normalize(-uLightPosition[i] - vertPos);																		\n"
+"		float lambertian = max(dot(lightDir, normal), 0.0);																					\n"
+"		float specular = 0.0;																												\n"
+"		highp float distance = length(uLightPosition[i] - worldPos);																		\n"
+"		float falloff = dot(uLightAttenuation[i], vec3(1.0, distance, distance * distance));												\n"
+"		float attenuation = (falloff > 0.0) ? 1.0 / falloff : 1.0;																			\n"
+"																																			\n"
+"#if defined(SHINE_SPECULAR) || defined(SHINE_LAMBERTIAN)																					\n"
+"		if (lambertian > 0.0)																												\n"
+"		{																																	\n"
+"			highp vec3 reflectDir = reflect(-lightDir, normal);																				\n"
+"			float specAngle = max(dot(reflectDir, viewDir), 0.0);																			\n"
+"																																			\n"
+"#ifdef SHINE_SPECULAR																														\n"
+"			specular = pow(specAngle, 30.0);																								\n"
+"#else																																		\n"
+"			specular = pow(specAngle, 4.0) * lambertian;																					\n"
+"#endif																																		\n"
+"		}																																	\n"
+"#endif																																		\n"
+"																																			\n"
+"		frontColor += vec3(defaultAmbience*uLightAmbience[i] + lambertian*uDiffuse*uLightDiffuse[i] + specular*uSpecular) * uLightIntensity[i] * attenuation;\n"
+"	}																																		\n"
+"#endif																																		\n"
+"																																			\n"
+"#ifdef ANIMATED_HULL																														\n"
+"	vec3 new_pos = a_position + a_links*sin(CC_Time.x);																						\n"
+"	vec3 step = uDiffuse*vec3(new_pos.z / abs(a_links.z));																					\n"
+"																																			\n"
+"	v_color = vec4(clamp(step, frontColor, uDiffuse + 0.3), alpha);																			\n"
+"#ifdef TEXTURED																															\n"
+"	vec4 position = vec4(a_position, 1.0);																									\n"
+"#else																																		\n"
+"	vec4 position = vec4(new_pos, 1.0);																										\n"
+"#endif																																		\n"
+"#else																																		\n"
+"	v_color = vec4(frontColor, alpha);																										\n"
+"																																			\n"
+"	vec4 position = vec4(a_position, 1.0);																									\n"
+"#endif																																		\n"
+"																																			\n"
+"#ifdef TEXTURED																															\n"
+"#ifdef QUANTIZED																															\n"
+"	vec2 texCoord = a_texCoord * uTexelRange.xy + uTexelRange.zw;																			\n"
+"#else																																		\n"
+"	vec2 texCoord = a_texCoord;																												\n"
+"#endif																																		\n"
+"																																			\n"
+"#ifdef TEXTURE_ATLAS																														\n"
+"	v_texCoord = texCoord * uTexCoordTransform.xy + uTexCoordTransform.zw;																	\n"
+"#else																																		\n"
+"	v_texCoord = texCoord;																													\n"
+"#endif																																		\n"
+"#endif																																		\n"
+"																																			\n"
+"#ifdef SHADOWS																																\n"
+"	v_projectorCoord = uShadowProjectionMatrix * (CC_MMatrix * position);																	\n"
+"#endif																																		\n"
+"																																			\n"
+"	gl_Position = CC_MVPMatrix * position;																									\n"
+"}																																			\n";
+
+static const GLchar* glslPhongPermutationFrag =
+"precision mediump float;																		\n"
+"varying vec4 v_color;																			\n"
+"																								\n"
+"#ifdef TEXTURED																				\n"
+"uniform sampler2D uTexture;																	\n"
+"varying vec2 v_texCoord;																		\n"
+"#endif																							\n"
+"																								\n"
+"#ifdef TEXTURE_TO_ALPHA																		\n"
+"uniform float uAccTime;																		\n"
+"#endif																							\n"
+"																								\n"
+"#ifdef SHADOWS																					\n"
+"uniform sampler2D uShadowMap;																	\n"
+"varying vec4 v_projectorCoord;																	\n"
+"#endif																							\n"
+"																								\n"
+"void main()																					\n"
+"{																								\n"
+"	vec4 projTexColor = vec4(1.0);																\n"
+"																								\n"
+"#ifdef SHADOWS																					\n"
+"	vec4 rcoord = v_projectorCoord;																\n"
+"																								\n"
+#if (CC_TARGET_PLATFORM != CC_PLATFORM_IOS)
+"	if (greaterThan(v_projectorCoord, vec4(1.0)).x)												\n"
+"		rcoord = vec4(1.0);																		\n"
+"																								\n"
+"	if (lessThan(v_projectorCoord, vec4(0.0)).x)												\n"
+"		rcoord = vec4(0.0);																		\n"
+#endif
+"																								\n"
+"	vec4 shadow = texture2DProj(uShadowMap, v_projectorCoord);									\n"
+"																								\n"
+"	if (shadow.r != 1.0 && rcoord.z > 0.0)														\n"
+"	{																							\n"
+"		projTexColor = v_color * 0.8;															\n"
+"		projTexColor.a = 0.9;																	\n"
+"	}																							\n"
+"#endif																							\n"
+"																								\n"
+"#if defined(TEXTURED) && defined(ANIMATED_HULL)												\n"
+"	vec4 color = mix(v_color, projTexColor, texture2D(uTexture, v_texCoord));					\n"
+"#elif defined(TEXTURED)																		\n"
+"	vec4 color = v_color * projTexColor * texture2D(uTexture, v_texCoord);						\n"
+"#else																							\n"
+"	vec4 color = v_color * projTexColor;														\n"
+"#endif																							\n"
+"																								\n"
+"#ifdef TEXTURE_TO_ALPHA																		\n"
+#if (CC_TARGET_PLATFORM != CC_PLATFORM_IOS)
+"	if (v_texCoord.y >= pow(sin(uAccTime), 2.0))												\n"
+"		discard;																				\n"
+#else
+"	if (v_texCoord.y >= sin(uAccTime)*sin(uAccTime))											\n"
+"		color = vec4(0.0);																		\n"
+#endif
+"#endif																							\n"
+"																								\n"
+"	gl_FragColor = color;																		\n"
+"}																								\n";
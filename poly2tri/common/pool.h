@@ -0,0 +1,106 @@
+/*
+ * Poly2Tri Copyright (c) 2009-2010, Poly2Tri Contributors
+ * http://code.google.com/p/poly2tri/
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * * Neither the name of Poly2Tri nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without specific
+ *   prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <vector>
+#include <new>
+#include <utility>
+#include <cstddef>
+
+namespace p2t {
+
+/**
+ * Block allocator for the objects of one triangulation. Objects never move,
+ * so pointers and indices both stay valid until Clear(), which destroys them
+ * at once and keeps the blocks for the next triangulation.
+ */
+template <class T, size_t BlockSize = 256>
+class Pool {
+public:
+
+Pool() : size_(0)
+{
+}
+
+~Pool()
+{
+  Clear();
+  for (size_t i = 0; i < blocks_.size(); i++) {
+    ::operator delete(blocks_[i]);
+  }
+}
+
+template <class... Args>
+T* New(Args&&... args)
+{
+  if (size_ == blocks_.size() * BlockSize) {
+    blocks_.push_back(static_cast<T*>(::operator new(sizeof(T) * BlockSize)));
+  }
+  T* item = blocks_[size_ / BlockSize] + size_ % BlockSize;
+  new (item) T(std::forward<Args>(args)...);
+  size_++;
+  return item;
+}
+
+T& operator[](size_t index)
+{
+  return blocks_[index / BlockSize][index % BlockSize];
+}
+
+size_t size() const
+{
+  return size_;
+}
+
+void Clear()
+{
+  for (size_t i = 0; i < size_; i++) {
+    (*this)[i].~T();
+  }
+  size_ = 0;
+}
+
+private:
+
+Pool(const Pool&);
+Pool& operator=(const Pool&);
+
+std::vector<T*> blocks_;
+size_t size_;
+
+};
+
+}
+
+#endif
@@ -38,6 +38,27 @@ CDT::CDT(const std::vector<Point*>& polyline)
   sweep_ = new Sweep;
 }
 
+CDT::CDT()
+{
+  sweep_context_ = new SweepContext();
+  sweep_ = new Sweep;
+}
+
+void CDT::AddPolyline(const std::vector<Point*>& polyline)
+{
+  sweep_context_->AddPolyline(polyline);
+}
+
+void CDT::Clear()
+{
+  sweep_context_->Clear();
+}
+
+Point* CDT::NewPoint(double x, double y)
+{
+  return sweep_context_->NewPoint(x, y);
+}
+
 void CDT::AddHole(const std::vector<Point*>& polyline)
 {
   sweep_context_->AddHole(polyline);
@@ -52,12 +73,12 @@ void CDT::Triangulate()
   sweep_->Triangulate(*sweep_context_);
 }
 
-std::vector<p2t::Triangle*> CDT::GetTriangles()
+std::vector<p2t::Triangle*>& CDT::GetTriangles()
 {
   return sweep_context_->GetTriangles();
 }
 
-std::list<p2t::Triangle*> CDT::GetMap()
+std::vector<p2t::Triangle*>& CDT::GetMap()
 {
   return sweep_context_->GetMap();
 }
@@ -55,11 +55,34 @@ public:
    */
   CDT(const std::vector<Point*>& polyline);
 
+  /**
+   * Constructor - empty, for a CDT reused with Clear() and AddPolyline()
+   */
+  CDT();
+
    /**
    * Destructor - clean up memory
    */
   ~CDT();
 
+  /**
+   * Add the outer polyline after a Clear()
+   *
+   * @param polyline
+   */
+  void AddPolyline(const std::vector<Point*>& polyline);
+
+  /**
+   * Free the last triangulation in one go, the memory is kept for the next one.
+   * Points given by the caller keep the edges of this one, give new ones next time
+   */
+  void Clear();
+
+  /**
+   * Point owned by the CDT, valid until Clear() or destruction
+   */
+  Point* NewPoint(double x, double y);
+
   /**
    * Add a hole
    *
@@ -82,12 +105,12 @@ public:
   /**
    * Get CDT triangles
    */
-  std::vector<Triangle*> GetTriangles();
+  std::vector<Triangle*>& GetTriangles();
 
   /**
    * Get triangle map
    */
-  std::list<Triangle*> GetMap();
+  std::vector<Triangle*>& GetMap();
 
   private:
 
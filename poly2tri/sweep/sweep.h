@@ -60,11 +60,6 @@ public:
    */
   void Triangulate(SweepContext& tcx);
 
-  /**
-   * Destructor - clean up memory
-   */
-  ~Sweep();
-
 private:
 
   /**
@@ -276,8 +271,6 @@ private:
 
   void FinalizationPolygon(SweepContext& tcx);
 
-  std::vector<Node*> nodes_;
-
 };
 
 }
@@ -34,15 +34,66 @@
 
 namespace p2t {
 
-SweepContext::SweepContext(const std::vector<Point*>& polyline) : points_(polyline),
-  front_(0),
+SweepContext::SweepContext() : front_(0),
   head_(0),
-  tail_(0),
-  af_head_(0),
-  af_middle_(0),
-  af_tail_(0)
+  tail_(0)
 {
-  InitEdges(points_);
+}
+
+SweepContext::SweepContext(const std::vector<Point*>& polyline) : front_(0),
+  head_(0),
+  tail_(0)
+{
+  AddPolyline(polyline);
+}
+
+void SweepContext::AddPolyline(const std::vector<Point*>& polyline)
+{
+  InitEdges(polyline);
+  points_.insert(points_.end(), polyline.begin(), polyline.end());
+}
+
+void SweepContext::Clear()
+{
+  // Points given by the caller are never touched, they may be gone already. Those
+  // from NewPoint go with point_pool_ below, edge lists and all
+  delete front_;
+  front_ = NULL;
+  head_ = NULL;
+  tail_ = NULL;
+
+  basin.Clear();
+  edge_event.Clear();
+
+  edge_list.clear();
+  triangles_.clear();
+  map_.clear();
+  points_.clear();
+
+  node_pool_.Clear();
+  triangle_pool_.Clear();
+  edge_pool_.Clear();
+  point_pool_.Clear();
+}
+
+Point* SweepContext::NewPoint(double x, double y)
+{
+  return point_pool_.New(x, y);
+}
+
+Triangle* SweepContext::NewTriangle(Point& a, Point& b, Point& c)
+{
+  return triangle_pool_.New(a, b, c);
+}
+
+Node* SweepContext::NewNode(Point& p)
+{
+  return node_pool_.New(p);
+}
+
+Node* SweepContext::NewNode(Point& p, Triangle& t)
+{
+  return node_pool_.New(p, t);
 }
 
 void SweepContext::AddHole(const std::vector<Point*>& polyline)
@@ -62,7 +113,7 @@ std::vector<Triangle*> &SweepContext::GetTriangles()
   return triangles_;
 }
 
-std::list<Triangle*> &SweepContext::GetMap()
+std::vector<Triangle*> &SweepContext::GetMap()
 {
   return map_;
 }
@@ -87,8 +138,8 @@ void SweepContext::InitTriangulation()
 
   double dx = kAlpha * (xmax - xmin);
   double dy = kAlpha * (ymax - ymin);
-  head_ = new Point(xmax + dx, ymin - dy);
-  tail_ = new Point(xmin - dx, ymin - dy);
+  head_ = NewPoint(xmax + dx, ymin - dy);
+  tail_ = NewPoint(xmin - dx, ymin - dy);
 
   // Sort points along y-axis
   std::sort(points_.begin(), points_.end(), cmp);
@@ -100,7 +151,7 @@ void SweepContext::InitEdges(const std::vector<Point*>& polyline)
   size_t num_points = polyline.size();
   for (size_t i = 0; i < num_points; i++) {
     size_t j = i < num_points - 1 ? i + 1 : 0;
-    edge_list.push_back(new Edge(*polyline[i], *polyline[j]));
+    edge_list.push_back(edge_pool_.New(*polyline[i], *polyline[j]));
   }
 }
 
@@ -120,31 +171,24 @@ Node& SweepContext::LocateNode(const Point& point)
   return *front_->LocateNode(point.x);
 }
 
-void SweepContext::CreateAdvancingFront(const std::vector<Node*>& nodes)
+void SweepContext::CreateAdvancingFront()
 {
-
-  (void) nodes;
   // Initial triangle
-  Triangle* triangle = new Triangle(*points_[0], *tail_, *head_);
+  Triangle* triangle = NewTriangle(*points_[0], *tail_, *head_);
 
   map_.push_back(triangle);
 
-  af_head_ = new Node(*triangle->GetPoint(1), *triangle);
-  af_middle_ = new Node(*triangle->GetPoint(0), *triangle);
-  af_tail_ = new Node(*triangle->GetPoint(2));
-  front_ = new AdvancingFront(*af_head_, *af_tail_);
+  Node* af_head = NewNode(*triangle->GetPoint(1), *triangle);
+  Node* af_middle = NewNode(*triangle->GetPoint(0), *triangle);
+  Node* af_tail = NewNode(*triangle->GetPoint(2));
+  front_ = new AdvancingFront(*af_head, *af_tail);
 
   // TODO: More intuitive if head is middles next and not previous?
   //       so swap head and tail
-  af_head_->next = af_middle_;
-  af_middle_->next = af_tail_;
-  af_middle_->prev = af_head_;
-  af_tail_->prev = af_middle_;
-}
-
-void SweepContext::RemoveNode(Node* node)
-{
-  delete node;
+  af_head->next = af_middle;
+  af_middle->next = af_tail;
+  af_middle->prev = af_head;
+  af_tail->prev = af_middle;
 }
 
 void SweepContext::MapTriangleToNodes(Triangle& t)
@@ -158,11 +202,6 @@ void SweepContext::MapTriangleToNodes(Triangle& t)
   }
 }
 
-void SweepContext::RemoveFromMap(Triangle* triangle)
-{
-  map_.remove(triangle);
-}
-
 void SweepContext::MeshClean(Triangle& triangle)
 {
   std::vector<Triangle *> triangles;
@@ -185,27 +224,7 @@ void SweepContext::MeshClean(Triangle& triangle)
 
 SweepContext::~SweepContext()
 {
-
-    // Clean up memory
-
-    delete head_;
-    delete tail_;
-    delete front_;
-    delete af_head_;
-    delete af_middle_;
-    delete af_tail_;
-
-    typedef std::list<Triangle*> type_list;
-
-    for(type_list::iterator iter = map_.begin(); iter != map_.end(); ++iter) {
-        Triangle* ptr = *iter;
-        delete ptr;
-    }
-
-     for(unsigned int i = 0; i < edge_list.size(); i++) {
-        delete edge_list[i];
-    }
-
+  Clear();
 }
 
 }
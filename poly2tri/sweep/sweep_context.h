@@ -32,9 +32,9 @@
 #ifndef SWEEP_CONTEXT_H
 #define SWEEP_CONTEXT_H
 
-#include <list>
 #include <vector>
 #include <cstddef>
+#include "../common/pool.h"
 
 namespace p2t {
 
@@ -52,10 +52,24 @@ class SweepContext {
 public:
 
 /// Constructor
+SweepContext();
 SweepContext(const std::vector<Point*>& polyline);
 /// Destructor
 ~SweepContext();
 
+/// Add the outer polyline, after a Clear() when the context is reused
+void AddPolyline(const std::vector<Point*>& polyline);
+
+/// Forget the last triangulation, the pools keep their memory for the next one.
+/// Points given by the caller keep the edges of this one, give new ones next time
+void Clear();
+
+/// Point owned by the context, freed with the triangulation
+Point* NewPoint(double x, double y);
+Triangle* NewTriangle(Point& a, Point& b, Point& c);
+Node* NewNode(Point& p);
+Node* NewNode(Point& p, Triangle& t);
+
 void set_head(Point* p1);
 
 Point* head() const;
@@ -68,9 +82,7 @@ size_t point_count() const;
 
 Node& LocateNode(const Point& point);
 
-void RemoveNode(Node* node);
-
-void CreateAdvancingFront(const std::vector<Node*>& nodes);
+void CreateAdvancingFront();
 
 /// Try to map a node to all sides of this triangle that don't have a neighbor
 void MapTriangleToNodes(Triangle& t);
@@ -81,8 +93,6 @@ Point* GetPoint(size_t index);
 
 Point* GetPoints();
 
-void RemoveFromMap(Triangle* triangle);
-
 void AddHole(const std::vector<Point*>& polyline);
 
 void AddPoint(Point* point);
@@ -92,7 +102,7 @@ AdvancingFront* front() const;
 void MeshClean(Triangle& triangle);
 
 std::vector<Triangle*> &GetTriangles();
-std::list<Triangle*> &GetMap();
+std::vector<Triangle*> &GetMap();
 
 std::vector<Edge*> edge_list;
 
@@ -124,6 +134,12 @@ struct EdgeEvent {
   EdgeEvent() : constrained_edge(NULL), right(false)
   {
   }
+
+  void Clear()
+  {
+    constrained_edge = NULL;
+    right = false;
+  }
 };
 
 Basin basin;
@@ -134,9 +150,14 @@ private:
 friend class Sweep;
 
 std::vector<Triangle*> triangles_;
-std::list<Triangle*> map_;
+std::vector<Triangle*> map_;
 std::vector<Point*> points_;
 
+Pool<Point> point_pool_;
+Pool<Edge> edge_pool_;
+Pool<Triangle> triangle_pool_;
+Pool<Node> node_pool_;
+
 // Advancing front
 AdvancingFront* front_;
 // head point used with advancing front
@@ -144,8 +165,6 @@ Point* head_;
 // tail point used with advancing front
 Point* tail_;
 
-Node *af_head_, *af_middle_, *af_tail_;
-
 void InitTriangulation();
 void InitEdges(const std::vector<Point*>& polyline);
 
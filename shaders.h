@@ -1,6 +1,9 @@
 #ifndef __SHADERS_H__
 #define __SHADERS_H__
 #include "cocos2d.h"
+#include "ProgramBinaryCache.h"
+#include <string>
+#include <stdio.h>
 
 #define PHONG_SHADER_KEY "cc3Phong"
 #define PHONG_SHADER_TEXTURE_KEY "cc3PhongTexture"
@@ -8,6 +11,8 @@
 #define PHONG_SHADER_ANIMATED_KEY "cc3PhongAnimated"
 #define PHONG_SHADER_TEXTURE_ANIMATED_KEY "cc3PhongTextureAnimated"
 #define ADVANCED_SHADER_KEY "cc3Advanced"
+#define BILLBOARD_BATCH_SHADER_KEY "cc3BillboardBatch"
+#define IMPOSTOR_SHADER_KEY "cc3Impostor"
 
 using namespace cocos2d;
 #if (CC_TARGET_PLATFORM == CC_PLATFORM_WP8)
@@ -26,7 +31,13 @@ using namespace cocos2d;
 #endif
 #endif
 
+//no precompiled version, WP8 can't build it
+#include "batch-shader.h"
+#include "impostor-shader.h"
+
 #define kCCVertexAttrib_Normals 4
+#define kCCVertexAttrib_Corner 5
+#define kCCVertexAttrib_Links 6
 
 // Material
 
@@ -123,4 +134,204 @@ ccglProgram->updateUniforms();
 #define MESH_INIT_PHONG_TEXTURE_ANIMATED(ccglProgram) INIT_PHONG_TEXTURE_ANIMATED_GLSL(ccglProgram)
 #endif
 
+// Permutations
+//
+// A permutation is a phong program compiled with only the features a model uses.
+// The features are injected as #defines in front of glslPhongPermutationVert/Frag
+// and every permutation is cached in CCShaderCache under its own key.
+
+#define PHONG_SHINE_SPECULAR		(1 << 0)
+#define PHONG_SHINE_LAMBERTIAN		(1 << 1)
+#define PHONG_TEXTURE				(1 << 2)
+#define PHONG_TEXTURE_TO_ALPHA		(1 << 3)
+#define PHONG_ANIMATED_HULL			(1 << 4)
+#define PHONG_SHADOWS				(1 << 5)
+#define PHONG_TEXTURE_ATLAS			(1 << 6)
+#define PHONG_QUANTIZED				(1 << 7)
+
+#define PHONG_LIGHTS_SHIFT 8
+#define PHONG_LIGHTS_MASK (0xF << PHONG_LIGHTS_SHIFT)
+#define PHONG_LIGHTS(count) (((count) << PHONG_LIGHTS_SHIFT) & PHONG_LIGHTS_MASK)
+#define PHONG_LIGHTS_COUNT(features) (((features) & PHONG_LIGHTS_MASK) >> PHONG_LIGHTS_SHIFT)
+
+static inline std::string phongPermutationKey(unsigned int features)
+{
+	char key[32];
+	snprintf(key, sizeof(key), "%s_%04x", PHONG_SHADER_KEY, features);
+
+	return std::string(key);
+}
+
+static inline std::string phongPermutationDefines(unsigned int features)
+{
+	char lights[32];
+	snprintf(lights, sizeof(lights), "#define NUM_LIGHTS %u\n", PHONG_LIGHTS_COUNT(features));
+
+	std::string defines = lights;
+
+	if (features & PHONG_SHINE_SPECULAR)
+		defines += "#define SHINE_SPECULAR\n";
+	else
+	if (features & PHONG_SHINE_LAMBERTIAN)
+		defines += "#define SHINE_LAMBERTIAN\n";
+
+	if (features & PHONG_TEXTURE)
+	{
+		defines += "#define TEXTURED\n";
+
+		if (features & PHONG_TEXTURE_TO_ALPHA)
+			defines += "#define TEXTURE_TO_ALPHA\n";
+
+		if (features & PHONG_TEXTURE_ATLAS)
+			defines += "#define TEXTURE_ATLAS\n";
+	}
+
+	if (features & PHONG_ANIMATED_HULL)
+		defines += "#define ANIMATED_HULL\n";
+
+	if (features & PHONG_SHADOWS)
+		defines += "#define SHADOWS\n";
+
+	if (features & PHONG_QUANTIZED)
+		defines += "#define QUANTIZED\n";
+
+	return defines;
+}
+
+static inline CCGLProgram* createPhongPermutation(unsigned int features)
+{
+	CCGLProgram* program = NULL;
+
+#if (CC_TARGET_PLATFORM == CC_PLATFORM_WP8)
+	program = new CCGLProgram();
+
+	//only the precompiled programs are available, pick the closest one
+	if ((features & PHONG_ANIMATED_HULL) && (features & PHONG_TEXTURE))
+	{
+		INIT_PHONG_TEXTURE_ANIMATED_WP8(program);
+	}
+	else
+	if (features & PHONG_ANIMATED_HULL)
+	{
+		INIT_PHONG_ANIMATED_WP8(program);
+	}
+	else
+	if ((features & PHONG_TEXTURE) && (features & PHONG_TEXTURE_TO_ALPHA))
+	{
+		INIT_PHONG_TEXTURE_TO_ALPHA_WP8(program);
+	}
+	else
+	if (features & PHONG_TEXTURE)
+	{
+		INIT_PHONG_TEXTURE_WP8(program);
+	}
+	else
+	{
+		INIT_PHONG_WP8(program);
+	}
+#else
+	std::string defines = phongPermutationDefines(features);
+	std::string vertex = defines + glslPhongPermutationVert;
+	std::string fragment = defines + glslPhongPermutationFrag;
+
+	cocos3d::ProgramAttributes attributes;
+	attributes[kCCAttributeNamePosition] = kCCVertexAttrib_Position;
+
+	//past the locations cocos tracks, ccGLEnableVertexAttribs calls leave it alone
+	attributes["a_normal"] = kCCVertexAttrib_Normals;
+
+	if (features & PHONG_TEXTURE)
+		attributes[kCCAttributeNameTexCoord] = kCCVertexAttrib_TexCoords;
+
+	if (features & PHONG_ANIMATED_HULL)
+		attributes["a_links"] = kCCVertexAttrib_Links;
+
+	//loaded from the on-disk binary when possible
+	program = cocos3d::ProgramBinaryCache::sharedProgramBinaryCache()->createProgram(phongPermutationKey(features), vertex, fragment, attributes);
+#endif
+
+	return program;
+}
+
+static inline CCGLProgram* phongProgramForFeatures(unsigned int features)
+{
+	std::string key = phongPermutationKey(features);
+
+	CCGLProgram* program = CCShaderCache::sharedShaderCache()->programForKey(key.c_str());
+
+	if (program == NULL)
+	{
+		program = createPhongPermutation(features);
+		CCShaderCache::sharedShaderCache()->addProgram(program, key.c_str());
+		program->release();
+	}
+
+	return program;
+}
+
+// Builds the permutation again and replaces the cached one, after a context loss
+static inline CCGLProgram* reloadPhongProgramForFeatures(unsigned int features)
+{
+	std::string key = phongPermutationKey(features);
+
+	CCGLProgram* program = createPhongPermutation(features);
+	CCShaderCache::sharedShaderCache()->addProgram(program, key.c_str());
+	program->release();
+
+	return program;
+}
+
+// Billboard batch
+
+static inline CCGLProgram* createBillboardBatchProgram()
+{
+	cocos3d::ProgramAttributes attributes;
+	attributes[kCCAttributeNamePosition] = kCCVertexAttrib_Position;
+	attributes[kCCAttributeNameColor] = kCCVertexAttrib_Color;
+	attributes[kCCAttributeNameTexCoord] = kCCVertexAttrib_TexCoords;
+	attributes["a_corner"] = kCCVertexAttrib_Corner;
+
+	return cocos3d::ProgramBinaryCache::sharedProgramBinaryCache()->createProgram(BILLBOARD_BATCH_SHADER_KEY, glslBillboardBatchVert, glslBillboardBatchFrag, attributes);
+}
+
+// reload builds it again and replaces the cached one, after a context loss
+static inline CCGLProgram* billboardBatchProgram(bool reload = false)
+{
+	CCGLProgram* program = CCShaderCache::sharedShaderCache()->programForKey(BILLBOARD_BATCH_SHADER_KEY);
+
+	if (program == NULL || reload)
+	{
+		program = createBillboardBatchProgram();
+		CCShaderCache::sharedShaderCache()->addProgram(program, BILLBOARD_BATCH_SHADER_KEY);
+		program->release();
+	}
+
+	return program;
+}
+
+// Impostor
+
+static inline CCGLProgram* createImpostorProgram()
+{
+	cocos3d::ProgramAttributes attributes;
+	attributes[kCCAttributeNamePosition] = kCCVertexAttrib_Position;
+	attributes[kCCAttributeNameTexCoord] = kCCVertexAttrib_TexCoords;
+
+	return cocos3d::ProgramBinaryCache::sharedProgramBinaryCache()->createProgram(IMPOSTOR_SHADER_KEY, glslImpostorVert, glslImpostorFrag, attributes);
+}
+
+static inline CCGLProgram* impostorProgram(bool reload = false)
+{
+	CCGLProgram* program = CCShaderCache::sharedShaderCache()->programForKey(IMPOSTOR_SHADER_KEY);
+
+	if (program == NULL || reload)
+	{
+		program = createImpostorProgram();
+		CCShaderCache::sharedShaderCache()->addProgram(program, IMPOSTOR_SHADER_KEY);
+		program->release();
+	}
+
+	return program;
+}
+
 #endif
\ No newline at end of file